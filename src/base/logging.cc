@@ -22,20 +22,251 @@
 #include "src/base/logging.h"
 
 #include <stdlib.h>
+#include <sys/syscall.h>
+#include <sys/time.h>
 #include <time.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <thread>
+#include <vector>
 
 std::ofstream Logger::info_log_file_;
 std::ofstream Logger::warn_log_file_;
 std::ofstream Logger::erro_log_file_;
 
+namespace {
+
+// Queued message
+struct LogMessage {
+  LogSeverity severity;
+  std::string text;
+};
+
+// Single-producer single-consumer ring of messages. The
+// producer is the logging thread, and the consumer is
+// whoever holds AsyncLogger::drain_mutex.
+class LogQueue {
+ public:
+  explicit LogQueue(size_t capacity) : slots_(capacity + 1) {}
+
+  bool Push(LogSeverity severity, std::string* text) {
+    size_t tail = tail_.load(std::memory_order_relaxed);
+    size_t next = (tail + 1) % slots_.size();
+    if (next == head_.load(std::memory_order_acquire)) {
+      return false;  // full
+    }
+    slots_[tail].severity = severity;
+    slots_[tail].text.swap(*text);
+    tail_.store(next, std::memory_order_release);
+    return true;
+  }
+
+  bool Pop(LogMessage* msg) {
+    size_t head = head_.load(std::memory_order_relaxed);
+    if (head == tail_.load(std::memory_order_acquire)) {
+      return false;  // empty
+    }
+    msg->severity = slots_[head].severity;
+    msg->text.swap(slots_[head].text);
+    head_.store((head + 1) % slots_.size(), std::memory_order_release);
+    return true;
+  }
+
+  std::atomic<bool> exited{false};  // owner thread will not push
+
+ private:
+  std::vector<LogMessage> slots_;
+  std::atomic<size_t> head_{0};
+  std::atomic<size_t> tail_{0};
+};
+
+// States of asynchronous logging
+struct AsyncLogger {
+  std::atomic<bool> enabled{false};
+  std::atomic<int> producers{0};       // threads in Push()
+  std::atomic<unsigned long long> dropped{0};
+  std::atomic<int> generation{0};      // increased by each start
+  size_t queue_size = 0;
+  LogQueuePolicy policy = kLogDrop;
+  std::mutex control_mutex;            // serialize start and stop
+  std::mutex queues_mutex;             // protect queues
+  std::vector<LogQueue*> queues;
+  std::mutex drain_mutex;              // the consumer of queues
+  std::thread writer;
+};
+
+// Never destructed, since threads may log at exit
+AsyncLogger* GetAsyncLogger() {
+  static AsyncLogger* logger = new AsyncLogger();
+  return logger;
+}
+
+// The queue of current thread
+struct LocalQueue {
+  LogQueue* queue = nullptr;
+  int generation = -1;
+  ~LocalQueue() {
+    if (queue != nullptr) {
+      queue->exited = true;
+    }
+  }
+};
+
+thread_local LocalQueue local_queue;
+
+// Get the queue of current thread for this start
+LogQueue* GetLocalQueue(AsyncLogger* logger) {
+  int generation = logger->generation.load();
+  if (local_queue.queue == nullptr ||
+      local_queue.generation != generation) {
+    if (local_queue.queue != nullptr) {
+      local_queue.queue->exited = true;
+    }
+    local_queue.queue = new LogQueue(logger->queue_size);
+    local_queue.generation = generation;
+    std::lock_guard<std::mutex> lock(logger->queues_mutex);
+    logger->queues.push_back(local_queue.queue);
+  }
+  return local_queue.queue;
+}
+
+// Queue the message of current thread. Return false
+// if asynchronous logging is not enabled.
+bool PushMessage(LogSeverity severity, std::string* text) {
+  AsyncLogger* logger = GetAsyncLogger();
+  logger->producers++;
+  if (!logger->enabled) {
+    logger->producers--;
+    return false;
+  }
+  LogQueue* queue = GetLocalQueue(logger);
+  while (!queue->Push(severity, text)) {
+    if (logger->policy == kLogDrop) {
+      logger->dropped++;
+      break;
+    }
+    std::this_thread::yield();
+  }
+  logger->producers--;
+  return true;
+}
+
+// Serialize the writes to streams
+std::mutex write_mutex;
+
+// Thread id shown in the message head
+long ThreadId() {
+  static thread_local long tid = syscall(SYS_gettid);
+  return tid;
+}
+
+}  // namespace
+
 void InitializeLogger(const std::string& info_log_filename,
                       const std::string& warn_log_filename,
                       const std::string& erro_log_filename) {
+  std::lock_guard<std::mutex> lock(write_mutex);
+  // Reopen the files of the last initialization
+  Logger::info_log_file_.close();
+  Logger::warn_log_file_.close();
+  Logger::erro_log_file_.close();
   Logger::info_log_file_.open(info_log_filename.c_str());
   Logger::warn_log_file_.open(warn_log_filename.c_str());
   Logger::erro_log_file_.open(erro_log_filename.c_str());
 }
 
+// Write the queued messages. Return the number of them.
+static size_t DrainQueues(AsyncLogger* logger) {
+  std::lock_guard<std::mutex> drain_lock(logger->drain_mutex);
+  std::vector<LogQueue*> queues;
+  {
+    std::lock_guard<std::mutex> lock(logger->queues_mutex);
+    queues = logger->queues;
+  }
+  // A queue marked exited has no new message, so it
+  // can be freed after it is drained
+  std::vector<bool> exited(queues.size());
+  for (size_t i = 0; i < queues.size(); ++i) {
+    exited[i] = queues[i]->exited;
+  }
+  size_t count = 0;
+  LogMessage msg;
+  std::lock_guard<std::mutex> write_lock(write_mutex);
+  for (size_t i = 0; i < queues.size(); ++i) {
+    while (queues[i]->Pop(&msg)) {
+      Logger::GetStream(msg.severity) << msg.text;
+      count++;
+    }
+  }
+  if (count > 0) {
+    Logger::GetStream(INFO) << std::flush;
+    Logger::GetStream(WARNING) << std::flush;
+  }
+  std::lock_guard<std::mutex> lock(logger->queues_mutex);
+  std::vector<LogQueue*> alive;
+  for (size_t i = 0; i < logger->queues.size(); ++i) {
+    LogQueue* queue = logger->queues[i];
+    // New queues are appended at the end
+    if (i < exited.size() && exited[i]) {
+      delete queue;
+    } else {
+      alive.push_back(queue);
+    }
+  }
+  logger->queues.swap(alive);
+  return count;
+}
+
+void StartAsyncLogger(size_t queue_size, LogQueuePolicy policy) {
+  if (queue_size == 0) {
+    abort();
+  }
+  AsyncLogger* logger = GetAsyncLogger();
+  std::lock_guard<std::mutex> lock(logger->control_mutex);
+  if (logger->enabled) {
+    return;
+  }
+  logger->queue_size = queue_size;
+  logger->policy = policy;
+  logger->generation++;
+  logger->enabled = true;
+  // The writer keeps draining after stop until no thread is
+  // pushing, since a pusher may wait for space with kLogBlock
+  logger->writer = std::thread([logger]() {
+    while (logger->enabled || logger->producers > 0) {
+      if (DrainQueues(logger) == 0) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+      }
+    }
+  });
+}
+
+void StopAsyncLogger() {
+  AsyncLogger* logger = GetAsyncLogger();
+  std::lock_guard<std::mutex> lock(logger->control_mutex);
+  if (!logger->enabled) {
+    return;
+  }
+  logger->enabled = false;
+  // The writer exits after the threads pushing messages
+  logger->writer.join();
+  DrainQueues(logger);
+}
+
+void FlushAsyncLogger() {
+  AsyncLogger* logger = GetAsyncLogger();
+  if (logger->enabled) {
+    DrainQueues(logger);
+  }
+}
+
+unsigned long long NumDroppedLogs() {
+  return GetAsyncLogger()->dropped;
+}
+
 std::ostream& Logger::GetStream(LogSeverity severity) {
   return (severity == INFO) ?
       (info_log_file_.is_open() ? info_log_file_ : std::cout) :
@@ -44,22 +275,40 @@ std::ostream& Logger::GetStream(LogSeverity severity) {
          (erro_log_file_.is_open() ? erro_log_file_ : std::cerr));
 }
 
+// Write the whole message to its stream
+void Logger::Write(LogSeverity severity, const std::string& message) {
+  std::lock_guard<std::mutex> lock(write_mutex);
+  GetStream(severity) << message << std::flush;
+}
+
 std::ostream& Logger::Start(LogSeverity severity,
                             const std::string& file,
                             int line,
                             const std::string& function) {
-  time_t tm;
-  time(&tm);
-  char time_string[128];
-  ctime_r(&tm, time_string);
-  return GetStream(severity) << time_string
-                             << " " << file << ":" << line
-                             << " (" << function << ") " << std::flush;
+  struct timeval tv;
+  gettimeofday(&tv, nullptr);
+  struct tm tm;
+  localtime_r(&tv.tv_sec, &tm);
+  char time_string[64];
+  strftime(time_string, sizeof(time_string), "%Y-%m-%d %H:%M:%S", &tm);
+  stream_ << time_string << "." << std::setw(6) << std::setfill('0')
+          << tv.tv_usec << std::setfill(' ') << " " << ThreadId()
+          << " " << file << ":" << line << " (" << function << ") ";
+  return stream_;
 }
 
 Logger::~Logger() {
-  GetStream(severity_) << "\n" << std::flush;
+  stream_ << "\n";
+  std::string message = stream_.str();
+  if (severity_ >= ERROR) {
+    // Keep the order with the queued messages
+    FlushAsyncLogger();
+  } else if (PushMessage(severity_, &message)) {
+    return;
+  }
+  Write(severity_, message);
   if (severity_ == FATAL) {
+    StopAsyncLogger();
     info_log_file_.close();
     warn_log_file_.close();
     erro_log_file_.close();
@@ -27,6 +27,7 @@
 #include <fstream>
 #include <iomanip>
 #include <iostream>
+#include <sstream>
 #include <string>
 
 /*!
@@ -54,6 +55,47 @@ void InitializeLogger(const std::string& info_log_filename,
 
 enum LogSeverity { INFO, WARNING, ERROR, FATAL };
 
+/*!
+ * \brief What a thread does when its asynchronous log queue is full
+ */
+enum LogQueuePolicy {
+  kLogDrop,   // drop the message and count it
+  kLogBlock   // wait for the writer thread
+};
+
+/*!
+ * \brief Write the INFO and WARNING messages by a background thread.
+ * Each logging thread appends its messages to its own lock-free queue
+ * of queue_size messages, which is drained by the writer thread, so
+ * the logging threads never wait for I/O unless the queue is full and
+ * the policy is kLogBlock. ERROR and FATAL messages are written at
+ * once after the queued messages. For example:
+ *
+ *   StartAsyncLogger(4096, kLogDrop);
+ *   ... // LOG(INFO) from many threads
+ *   StopAsyncLogger();
+ *
+ * \param queue_size number of messages buffered by each thread
+ * \param policy what to do when the queue is full
+ */
+void StartAsyncLogger(size_t queue_size, LogQueuePolicy policy);
+
+/*!
+ * \brief Write all of the queued messages and stop the writer thread.
+ * Messages are written synchronously after that.
+ */
+void StopAsyncLogger();
+
+/*!
+ * \brief Write all of the queued messages
+ */
+void FlushAsyncLogger();
+
+/*!
+ * \brief Number of messages dropped by kLogDrop
+ */
+unsigned long long NumDroppedLogs();
+
 class Logger {
   friend void InitializeLogger(const std::string& info_log_filename,
                                const std::string& warn_log_filename,
@@ -63,40 +105,39 @@ class Logger {
   ~Logger();
 
   static std::ostream& GetStream(LogSeverity severity);
-  
-  static std::ostream& Start(LogSeverity severity,
-                             const std::string& file,
-                             int line,
-                             const std::string& function);
+
+  std::ostream& Start(LogSeverity severity,
+                      const std::string& file,
+                      int line,
+                      const std::string& function);
 
  private:
+  // Write the whole message to its stream
+  static void Write(LogSeverity severity, const std::string& message);
+
   static std::ofstream info_log_file_;
   static std::ofstream warn_log_file_;
   static std::ofstream erro_log_file_;
   LogSeverity severity_;
+  std::ostringstream stream_;
 };
 
 /*!
  * \brief The basic mechanism of logging.{h,cc} is as follows:
  *  - LOG(severity) defines a Logger instance, which records the severity.
- *  - LOG(severity) then invokes Logger::Start(), which invokes Logger::Stream
- *    to choose an output stream, outputs a message head into the stream and
- *    flush.
- *  - The std::ostream reference returned by LoggerStart() is then passed to
- *    user-specific output operators (<<), which writes the log message body.
- *  - When the Logger instance is destructed, the destructor appends flush.
- *    If severity is FATAL, the destructor causes SEGFAULT and core dump.
+ *  - LOG(severity) then invokes Logger::Start(), which writes a message
+ *    head (time, thread id and position) into the buffer of the Logger.
+ *  - The std::ostream reference returned by Logger::Start() is then
+ *    passed to user-specific output operators (<<), which writes the
+ *    log message body.
+ *  - When the Logger instance is destructed, the destructor writes the
+ *    whole message to the output stream at once (or queues it to the
+ *    writer thread of StartAsyncLogger), so that the messages of
+ *    different threads never interleave. If severity is FATAL, the
+ *    destructor writes all of the queued messages and aborts.
  *
- * It is important to flush in Logger::Start() after outputing message
- * head.  This is because that the time when the destructor is invoked
- * depends on how/where the caller code defines the Logger instance.
- * If the caller code crashes before the Logger instance is properly
- * destructed, the destructor might not have the chance to append its
- * flush flags.  Without flush in Logger::Start(), this may cause the
- * lose of the last few messages.  However, given flush in Start(),
- * program crashing between invocations to Logger::Start() and
- * destructor only causes the lose of the last message body; while the
- * message head will be there.
+ * A program crashing inside a LOG statement loses its message, while
+ * the CHECK macros always finish the message before abort().
  */
 #define LOG(severity)                                                       \
   Logger(severity).Start(severity, __FILE__, __LINE__, __FUNCTION__)
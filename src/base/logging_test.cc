@@ -0,0 +1,111 @@
+//------------------------------------------------------------------------------
+// Copyright (c) 2018 by contributors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//------------------------------------------------------------------------------
+
+
+/*!
+ *  Copyright (c) 2018 by Contributors
+ * \file logging_test.cc
+ * \brief This file tests the asynchronous logging of logging.h.
+ */
+#include "gtest/gtest.h"
+
+#include <fstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "src/base/common.h"
+
+static const char* kInfoLog = "/tmp/logging_test_info.log";
+
+// Count the lines of info log containing tag, and check
+// that every line is complete
+static int CountLines(const std::string& tag) {
+  std::ifstream file(kInfoLog);
+  std::string line;
+  int count = 0;
+  while (std::getline(file, line)) {
+    if (line.find(tag) != std::string::npos) {
+      EXPECT_EQ(line.substr(line.size() - 4), " end");
+      count++;
+    }
+  }
+  return count;
+}
+
+// Each test writes to new log files
+class Logging : public testing::Test {
+ protected:
+  void SetUp() {
+    InitializeLogger(kInfoLog, "/tmp/logging_test_warn.log",
+                     "/tmp/logging_test_erro.log");
+  }
+};
+
+TEST_F(Logging, AsyncBlock) {
+  const int kThreads = 8;
+  const int kMessages = 1000;
+  StartAsyncLogger(16, kLogBlock);
+  std::vector<std::thread> threads;
+  for (int t = 0; t < kThreads; ++t) {
+    threads.push_back(std::thread([t]() {
+      for (int i = 0; i < kMessages; ++i) {
+        LOG(INFO) << "block thread " << t << " msg " << i << " end";
+      }
+    }));
+  }
+  for (size_t i = 0; i < threads.size(); ++i) {
+    threads[i].join();
+  }
+  StopAsyncLogger();
+  EXPECT_EQ(CountLines("block thread"), kThreads * kMessages);
+}
+
+TEST_F(Logging, AsyncDrop) {
+  const int kMessages = 10000;
+  unsigned long long dropped = NumDroppedLogs();
+  StartAsyncLogger(4, kLogDrop);
+  for (int i = 0; i < kMessages; ++i) {
+    LOG(INFO) << "drop msg " << i << " end";
+  }
+  StopAsyncLogger();
+  dropped = NumDroppedLogs() - dropped;
+  EXPECT_EQ(CountLines("drop msg") + dropped, kMessages);
+  // Synchronous after stop
+  LOG(INFO) << "sync msg end";
+  EXPECT_EQ(CountLines("sync msg"), 1);
+}
+
+// Stop while the threads are blocked on full queues
+TEST_F(Logging, StopWhileBlocked) {
+  const int kThreads = 4;
+  const int kMessages = 2000;
+  StartAsyncLogger(2, kLogBlock);
+  std::vector<std::thread> threads;
+  for (int t = 0; t < kThreads; ++t) {
+    threads.push_back(std::thread([t]() {
+      for (int i = 0; i < kMessages; ++i) {
+        LOG(INFO) << "stop thread " << t << " msg " << i << " end";
+      }
+    }));
+  }
+  StopAsyncLogger();
+  for (size_t i = 0; i < threads.size(); ++i) {
+    threads[i].join();
+  }
+  // No message is lost across the stop
+  EXPECT_EQ(CountLines("stop thread"), kThreads * kMessages);
+}
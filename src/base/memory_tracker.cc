@@ -0,0 +1,97 @@
+//------------------------------------------------------------------------------
+// Copyright (c) 2018 by contributors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//------------------------------------------------------------------------------
+
+
+/*!
+ *  Copyright (c) 2018 by Contributors
+ * \file memory_tracker.cc
+ * \brief This file is the implementation of the memory accounting.
+ */
+#include "src/base/memory_tracker.h"
+
+#include "src/base/stringprintf.h"
+
+std::atomic<int64> MemoryTracker::current_[kNumMemoryCategories];
+std::atomic<int64> MemoryTracker::peak_[kNumMemoryCategories];
+std::atomic<int64> MemoryTracker::total_(0);
+std::atomic<int64> MemoryTracker::total_peak_(0);
+
+namespace {
+
+// Raise peak to value
+void UpdatePeak(std::atomic<int64>* peak, int64 value) {
+  int64 old = peak->load(std::memory_order_relaxed);
+  while (value > old &&
+         !peak->compare_exchange_weak(old, value,
+                                      std::memory_order_relaxed)) {
+  }
+}
+
+const char* kCategoryNames[kNumMemoryCategories] = {
+  "dataset", "row_index", "histogram", "tree_node", "network"
+};
+
+}  // namespace
+
+void MemoryTracker::Alloc(MemoryCategory category, size_t bytes) {
+  int64 value = current_[category].fetch_add(
+    bytes, std::memory_order_relaxed) + bytes;
+  UpdatePeak(&peak_[category], value);
+  UpdatePeak(&total_peak_, total_.fetch_add(
+    bytes, std::memory_order_relaxed) + bytes);
+}
+
+void MemoryTracker::Free(MemoryCategory category, size_t bytes) {
+  current_[category].fetch_sub(bytes, std::memory_order_relaxed);
+  total_.fetch_sub(bytes, std::memory_order_relaxed);
+}
+
+int64 MemoryTracker::Current(MemoryCategory category) {
+  return current_[category].load(std::memory_order_relaxed);
+}
+
+int64 MemoryTracker::Peak(MemoryCategory category) {
+  return peak_[category].load(std::memory_order_relaxed);
+}
+
+int64 MemoryTracker::TotalPeak() {
+  return total_peak_.load(std::memory_order_relaxed);
+}
+
+void MemoryTracker::ResetPeak() {
+  for (int i = 0; i < kNumMemoryCategories; ++i) {
+    peak_[i] = current_[i].load();
+  }
+  total_peak_ = total_.load();
+}
+
+const char* MemoryTracker::Name(MemoryCategory category) {
+  return kCategoryNames[category];
+}
+
+std::string MemoryTracker::Report() {
+  std::string str;
+  for (int i = 0; i < kNumMemoryCategories; ++i) {
+    MemoryCategory category = static_cast<MemoryCategory>(i);
+    str += StringPrintf("%s %.1f/%.1f MB, ", Name(category),
+                        Current(category) / 1048576.0,
+                        Peak(category) / 1048576.0);
+  }
+  str += StringPrintf("total %.1f/%.1f MB (current/peak)",
+                      total_.load() / 1048576.0,
+                      TotalPeak() / 1048576.0);
+  return str;
+}
@@ -0,0 +1,148 @@
+//------------------------------------------------------------------------------
+// Copyright (c) 2018 by contributors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//------------------------------------------------------------------------------
+
+
+/*!
+ *  Copyright (c) 2018 by Contributors
+ * \file memory_tracker.h
+ * \brief This file defines the memory accounting by subsystem.
+ */
+#ifndef XFOREST_BASE_MEMORY_TRACKER_H_
+#define XFOREST_BASE_MEMORY_TRACKER_H_
+
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "src/base/common.h"
+
+/*!
+ * \brief Subsystems whose memory is tracked
+ */
+enum MemoryCategory {
+  kMemDataset,    // binned training data
+  kMemRowIndex,   // row and feature samples of trees
+  kMemHistogram,  // histograms of tree nodes
+  kMemTreeNode,   // tree nodes and their training info
+  kMemNetwork,    // buffers of collectives and shared memory
+  kNumMemoryCategories
+};
+
+/*!
+ * \brief Current and peak bytes of each category, e.g.,
+ *
+ *   MemoryTracker::Alloc(kMemHistogram, bytes);
+ *   ...
+ *   MemoryTracker::Free(kMemHistogram, bytes);
+ *   LOG(INFO) << MemoryTracker::Report();
+ *
+ * The counters are updated by atomic operations, so they can be
+ * used by all threads. The containers can be tracked by
+ * TrackedAllocator, e.g., TrackedVector<index_t, kMemRowIndex>.
+ */
+class MemoryTracker {
+ public:
+  /*!
+   * \breif Add bytes to the category, and update the peak
+   */
+  static void Alloc(MemoryCategory category, size_t bytes);
+
+  /*!
+   * \breif Subtract bytes from the category
+   */
+  static void Free(MemoryCategory category, size_t bytes);
+
+  /*!
+   * \breif Current bytes of the category
+   */
+  static int64 Current(MemoryCategory category);
+
+  /*!
+   * \breif Peak bytes of the category since start or ResetPeak()
+   */
+  static int64 Peak(MemoryCategory category);
+
+  /*!
+   * \breif Peak of the sum of all categories
+   */
+  static int64 TotalPeak();
+
+  /*!
+   * \breif Set the peaks to the current bytes
+   */
+  static void ResetPeak();
+
+  /*!
+   * \breif Name of the category, e.g., "histogram"
+   */
+  static const char* Name(MemoryCategory category);
+
+  /*!
+   * \breif Current and peak MB of all categories in a line
+   */
+  static std::string Report();
+
+ private:
+  static std::atomic<int64> current_[kNumMemoryCategories];
+  static std::atomic<int64> peak_[kNumMemoryCategories];
+  static std::atomic<int64> total_;
+  static std::atomic<int64> total_peak_;
+};
+
+/*!
+ * \brief Allocator that adds the memory of a container
+ * to the category in MemoryTracker
+ */
+template <typename T, MemoryCategory C>
+class TrackedAllocator : public std::allocator<T> {
+ public:
+  template <typename U>
+  struct rebind {
+    typedef TrackedAllocator<U, C> other;
+  };
+
+  TrackedAllocator() {}
+  template <typename U>
+  TrackedAllocator(const TrackedAllocator<U, C>&) {}
+
+  T* allocate(size_t n, const void* hint = nullptr) {
+    MemoryTracker::Alloc(C, n * sizeof(T));
+    return std::allocator<T>::allocate(n);
+  }
+  void deallocate(T* p, size_t n) {
+    MemoryTracker::Free(C, n * sizeof(T));
+    std::allocator<T>::deallocate(p, n);
+  }
+};
+
+template <typename T, typename U, MemoryCategory C>
+bool operator==(const TrackedAllocator<T, C>&,
+                const TrackedAllocator<U, C>&) {
+  return true;
+}
+
+template <typename T, typename U, MemoryCategory C>
+bool operator!=(const TrackedAllocator<T, C>&,
+                const TrackedAllocator<U, C>&) {
+  return false;
+}
+
+template <typename T, MemoryCategory C>
+using TrackedVector = std::vector<T, TrackedAllocator<T, C>>;
+
+#endif  // XFOREST_BASE_MEMORY_TRACKER_H_
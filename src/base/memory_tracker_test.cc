@@ -0,0 +1,83 @@
+//------------------------------------------------------------------------------
+// Copyright (c) 2018 by contributors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//------------------------------------------------------------------------------
+
+
+/*!
+ *  Copyright (c) 2018 by Contributors
+ * \file memory_tracker_test.cc
+ * \brief This file tests memory_tracker.h file.
+ */
+#include "gtest/gtest.h"
+
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "src/base/memory_tracker.h"
+
+TEST(MemoryTracker, AllocAndFree) {
+  int64 current = MemoryTracker::Current(kMemHistogram);
+  MemoryTracker::ResetPeak();
+  MemoryTracker::Alloc(kMemHistogram, 1000);
+  MemoryTracker::Alloc(kMemHistogram, 500);
+  MemoryTracker::Free(kMemHistogram, 1000);
+  EXPECT_EQ(MemoryTracker::Current(kMemHistogram), current + 500);
+  EXPECT_EQ(MemoryTracker::Peak(kMemHistogram), current + 1500);
+  EXPECT_GE(MemoryTracker::TotalPeak(), 1500);
+  MemoryTracker::Free(kMemHistogram, 500);
+  EXPECT_EQ(MemoryTracker::Current(kMemHistogram), current);
+  MemoryTracker::ResetPeak();
+  EXPECT_EQ(MemoryTracker::Peak(kMemHistogram), current);
+  std::string report = MemoryTracker::Report();
+  EXPECT_NE(report.find("histogram"), std::string::npos);
+  EXPECT_NE(report.find("network"), std::string::npos);
+}
+
+TEST(MemoryTracker, TrackedVector) {
+  int64 current = MemoryTracker::Current(kMemRowIndex);
+  {
+    TrackedVector<uint32, kMemRowIndex> vec(100);
+    EXPECT_EQ(MemoryTracker::Current(kMemRowIndex),
+              current + 100 * sizeof(uint32));
+    vec.clear();
+    vec.shrink_to_fit();
+    EXPECT_EQ(MemoryTracker::Current(kMemRowIndex), current);
+    vec.assign(10, 1);
+    EXPECT_EQ(MemoryTracker::Current(kMemRowIndex),
+              current + 10 * sizeof(uint32));
+  }
+  EXPECT_EQ(MemoryTracker::Current(kMemRowIndex), current);
+}
+
+TEST(MemoryTracker, Threads) {
+  int64 current = MemoryTracker::Current(kMemNetwork);
+  MemoryTracker::ResetPeak();
+  std::vector<std::thread> threads;
+  for (int t = 0; t < 4; ++t) {
+    threads.push_back(std::thread([]() {
+      for (int i = 0; i < 1000; ++i) {
+        MemoryTracker::Alloc(kMemNetwork, 64);
+        MemoryTracker::Free(kMemNetwork, 64);
+      }
+    }));
+  }
+  for (size_t i = 0; i < threads.size(); ++i) {
+    threads[i].join();
+  }
+  EXPECT_EQ(MemoryTracker::Current(kMemNetwork), current);
+  EXPECT_GE(MemoryTracker::Peak(kMemNetwork), current + 64);
+  EXPECT_LE(MemoryTracker::Peak(kMemNetwork), current + 4 * 64);
+}
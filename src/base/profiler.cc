@@ -0,0 +1,477 @@
+//------------------------------------------------------------------------------
+// Copyright (c) 2018 by contributors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//------------------------------------------------------------------------------
+
+
+/*!
+ *  Copyright (c) 2018 by Contributors
+ * \file profiler.cc
+ * \brief This file is the implementation of the scoped profiler
+ * and trace recorder.
+ */
+#include "src/base/profiler.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#ifdef __linux__
+#include <linux/perf_event.h>
+#endif
+#include <algorithm>
+#include <map>
+#include <memory>
+#include <mutex>
+
+#include "src/base/stringprintf.h"
+
+std::atomic<bool> Profiler::enabled_(false);
+std::atomic<bool> Profiler::tracing_(false);
+std::atomic<bool> Profiler::counters_(false);
+
+// Maximal trace events recorded by a thread
+static const size_t kMaxTraceEvents = 1 << 20;
+
+namespace {
+
+// Zone of a thread. The zones of a thread form a tree,
+// and the children of a zone have different names.
+struct ZoneNode {
+  const char* name;
+  int parent;
+  std::vector<int> children;
+  uint64 count;
+  uint64 total_ns;
+  uint64 counted;
+  uint64 counters[kNumCounters];
+  bool started;                 // counters are read at Enter()
+  uint64 start[kNumCounters];   // counters at Enter()
+};
+
+// Merged stats keyed by path, where '/' is replaced by '\1'
+// so that a zone is ordered right before its children
+typedef std::map<std::string, ProfileStat> StatMap;
+
+// Stats of flushed and exited threads
+struct GlobalStats {
+  std::mutex mutex;
+  StatMap stats;
+};
+
+// Never destructed, since threads may exit after main()
+GlobalStats* GetGlobalStats() {
+  static GlobalStats* global = new GlobalStats();
+  return global;
+}
+
+// Add the zones of a thread to stats
+void MergeZones(const std::vector<ZoneNode>& nodes, int id,
+                const std::string& key, const std::string& path,
+                int depth, StatMap* stats) {
+  const ZoneNode& node = nodes[id];
+  if (id != 0) {
+    ProfileStat& stat = (*stats)[key];
+    stat.path = path;
+    stat.depth = depth;
+    stat.count += node.count;
+    stat.total_ns += node.total_ns;
+    stat.counted += node.counted;
+    for (int i = 0; i < kNumCounters; ++i) {
+      stat.counters[i] += node.counters[i];
+    }
+  }
+  for (size_t i = 0; i < node.children.size(); ++i) {
+    const ZoneNode& child = nodes[node.children[i]];
+    if (id == 0) {
+      MergeZones(nodes, node.children[i], child.name, child.name,
+                 0, stats);
+    } else {
+      MergeZones(nodes, node.children[i], key + '\1' + child.name,
+                 path + '/' + child.name, depth + 1, stats);
+    }
+  }
+}
+
+// Zones of current thread
+struct ThreadZones {
+  std::vector<ZoneNode> nodes;
+  int current = 0;
+
+  ThreadZones() { Clear(); }
+
+  // Merge to the global stats at thread exit
+  ~ThreadZones() { Flush(); }
+
+  void Clear() {
+    nodes.assign(1, ZoneNode{"", -1, {}, 0, 0});
+    current = 0;
+  }
+
+  void Flush() {
+    if (nodes.size() == 1) {
+      return;
+    }
+    GlobalStats* global = GetGlobalStats();
+    std::lock_guard<std::mutex> lock(global->mutex);
+    MergeZones(nodes, 0, "", "", 0, &global->stats);
+    Clear();
+  }
+};
+
+thread_local ThreadZones thread_zones;
+
+// Hardware counters of a thread, which are opened as a group
+// so that they are scheduled and read together
+class PerfCounters {
+ public:
+  PerfCounters() { }
+  ~PerfCounters() { Close(); }
+
+  // Return false if the kernel denies the access
+  bool Open() {
+    if (opened_) {
+      return fd_[0] >= 0;
+    }
+    opened_ = true;
+#ifdef __linux__
+    static const uint64 kConfigs[kNumCounters] = {
+      PERF_COUNT_HW_CPU_CYCLES,
+      PERF_COUNT_HW_INSTRUCTIONS,
+      PERF_COUNT_HW_CACHE_MISSES,
+      PERF_COUNT_HW_BRANCH_MISSES
+    };
+    for (int i = 0; i < kNumCounters; ++i) {
+      struct perf_event_attr attr;
+      memset(&attr, 0, sizeof(attr));
+      attr.type = PERF_TYPE_HARDWARE;
+      attr.size = sizeof(attr);
+      attr.config = kConfigs[i];
+      attr.disabled = (i == 0);
+      attr.exclude_kernel = 1;
+      attr.exclude_hv = 1;
+      attr.read_format = PERF_FORMAT_GROUP;
+      fd_[i] = syscall(SYS_perf_event_open, &attr, 0, -1,
+                       i == 0 ? -1 : fd_[0], 0);
+      if (fd_[i] < 0) {
+        Close();
+        return false;
+      }
+    }
+    ioctl(fd_[0], PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+    return true;
+#else
+    return false;
+#endif
+  }
+
+  // Read the counters, return false if not opened
+  bool Read(uint64* values) {
+    if (fd_[0] < 0) {
+      return false;
+    }
+    uint64 buf[kNumCounters + 1];
+    if (read(fd_[0], buf, sizeof(buf)) != sizeof(buf) ||
+        buf[0] != kNumCounters) {
+      return false;
+    }
+    memcpy(values, buf + 1, sizeof(uint64) * kNumCounters);
+    return true;
+  }
+
+ private:
+  void Close() {
+    for (int i = 0; i < kNumCounters; ++i) {
+      if (fd_[i] >= 0) {
+        close(fd_[i]);
+        fd_[i] = -1;
+      }
+    }
+  }
+
+  bool opened_ = false;
+  int fd_[kNumCounters] = {-1, -1, -1, -1};
+
+  DISALLOW_COPY_AND_ASSIGN(PerfCounters);
+};
+
+thread_local PerfCounters perf_counters;
+
+// Read the counters of current thread if enabled
+bool ReadCounters(uint64* values) {
+  return Profiler::Counters() &&
+    perf_counters.Open() &&
+    perf_counters.Read(values);
+}
+
+// Complete event of trace
+struct TraceEvent {
+  const char* name;
+  std::chrono::steady_clock::time_point begin;
+  std::chrono::steady_clock::time_point end;
+};
+
+// Trace events of a thread. The mutex is only contended
+// by WriteTrace() and StartTrace().
+struct TraceBuffer {
+  std::mutex mutex;
+  long tid = 0;
+  std::string thread_name;
+  std::vector<TraceEvent> events;
+  uint64 dropped = 0;
+};
+
+// Buffers of all threads, which are kept after thread
+// exit until the next StartTrace()
+struct GlobalTrace {
+  std::mutex mutex;
+  std::chrono::steady_clock::time_point start;
+  std::vector<std::shared_ptr<TraceBuffer>> buffers;
+};
+
+// Never destructed, since threads may exit after main()
+GlobalTrace* GetGlobalTrace() {
+  static GlobalTrace* global = new GlobalTrace();
+  return global;
+}
+
+// Trace buffer of current thread
+TraceBuffer* GetTraceBuffer() {
+  static thread_local std::shared_ptr<TraceBuffer> buffer;
+  if (buffer == nullptr) {
+    buffer = std::make_shared<TraceBuffer>();
+    buffer->tid = syscall(SYS_gettid);
+    GlobalTrace* global = GetGlobalTrace();
+    std::lock_guard<std::mutex> lock(global->mutex);
+    global->buffers.push_back(buffer);
+  }
+  return buffer.get();
+}
+
+// Escape the string in JSON
+std::string JSONEscape(const std::string& str) {
+  std::string out;
+  for (size_t i = 0; i < str.size(); ++i) {
+    if (str[i] == '"' || str[i] == '\\') {
+      out += '\\';
+    }
+    out += str[i];
+  }
+  return out;
+}
+
+// Convert stats to vector in path order
+void ToVector(const StatMap& stats, std::vector<ProfileStat>* vec) {
+  vec->clear();
+  for (auto it = stats.begin(); it != stats.end(); ++it) {
+    vec->push_back(it->second);
+  }
+}
+
+}  // namespace
+
+void Profiler::Enter(const char* name) {
+  ThreadZones& zones = thread_zones;
+  int current = zones.current;
+  const std::vector<int>& children = zones.nodes[current].children;
+  for (size_t i = 0; i < children.size(); ++i) {
+    const char* child = zones.nodes[children[i]].name;
+    if (child == name || strcmp(child, name) == 0) {
+      zones.current = children[i];
+      break;
+    }
+  }
+  if (zones.current == current) {
+    int id = zones.nodes.size();
+    zones.nodes.push_back(ZoneNode{name, current, {}, 0, 0});
+    zones.nodes[current].children.push_back(id);
+    zones.current = id;
+  }
+  ZoneNode& node = zones.nodes[zones.current];
+  node.started = ReadCounters(node.start);
+}
+
+void Profiler::Leave(uint64 elapsed_ns) {
+  ThreadZones& zones = thread_zones;
+  ZoneNode& node = zones.nodes[zones.current];
+  uint64 values[kNumCounters];
+  if (node.started && ReadCounters(values)) {
+    node.counted++;
+    for (int i = 0; i < kNumCounters; ++i) {
+      node.counters[i] += values[i] - node.start[i];
+    }
+  }
+  node.started = false;
+  node.count++;
+  node.total_ns += elapsed_ns;
+  zones.current = node.parent;
+}
+
+bool Profiler::SetCounters(bool flag) {
+  // The counters of other threads are opened at their first zone
+  counters_ = flag && perf_counters.Open();
+  return counters_;
+}
+
+void Profiler::FlushThread() {
+  CHECK_EQ(thread_zones.current, 0);
+  thread_zones.Flush();
+}
+
+void Profiler::ThreadStats(std::vector<ProfileStat>* stats) {
+  CHECK_NOTNULL(stats);
+  StatMap map;
+  MergeZones(thread_zones.nodes, 0, "", "", 0, &map);
+  ToVector(map, stats);
+}
+
+void Profiler::Stats(std::vector<ProfileStat>* stats) {
+  CHECK_NOTNULL(stats);
+  GlobalStats* global = GetGlobalStats();
+  std::lock_guard<std::mutex> lock(global->mutex);
+  ToVector(global->stats, stats);
+}
+
+void Profiler::Reset() {
+  GlobalStats* global = GetGlobalStats();
+  std::lock_guard<std::mutex> lock(global->mutex);
+  global->stats.clear();
+}
+
+std::string Profiler::Report(const std::vector<ProfileStat>& stats) {
+  std::map<std::string, uint64> totals;
+  bool counted = false;
+  for (size_t i = 0; i < stats.size(); ++i) {
+    totals[stats[i].path] = stats[i].total_ns;
+    counted = counted || stats[i].counted > 0;
+  }
+  std::string str = StringPrintf("%-40s %10s %12s %8s",
+                                 "zone", "calls", "total(ms)", "%parent");
+  // Cache misses and branch mispredicts are per 1000 instructions
+  if (counted) {
+    str += StringPrintf(" %10s %6s %10s %11s", "Mcycles", "IPC",
+                        "cache-mpki", "branch-mpki");
+  }
+  str += "\n";
+  for (size_t i = 0; i < stats.size(); ++i) {
+    const ProfileStat& stat = stats[i];
+    size_t pos = stat.path.rfind('/');
+    std::string name = std::string(2 * stat.depth, ' ') +
+      (pos == std::string::npos ? stat.path : stat.path.substr(pos + 1));
+    double percent = 100.0;
+    if (pos != std::string::npos) {
+      uint64 parent = totals[stat.path.substr(0, pos)];
+      percent = parent > 0 ? 100.0 * stat.total_ns / parent : 0;
+    }
+    str += StringPrintf("%-40s %10llu %12.3f %8.1f", name.c_str(),
+                        (unsigned long long)stat.count,
+                        stat.total_ns / 1e6, percent);
+    if (stat.counted > 0) {
+      double cycles = stat.counters[kCycles];
+      double kinst = stat.counters[kInstructions] / 1e3;
+      double ipc = cycles > 0 ? kinst * 1e3 / cycles : 0;
+      double cache = kinst > 0 ? stat.counters[kCacheMisses] / kinst : 0;
+      double branch = kinst > 0 ? stat.counters[kBranchMisses] / kinst : 0;
+      str += StringPrintf(" %10.3f %6.2f %10.3f %11.3f",
+                          cycles / 1e6, ipc, cache, branch);
+    }
+    str += "\n";
+  }
+  return str;
+}
+
+void Profiler::StartTrace() {
+  GlobalTrace* global = GetGlobalTrace();
+  {
+    std::lock_guard<std::mutex> lock(global->mutex);
+    // Free the buffers of exited threads
+    std::vector<std::shared_ptr<TraceBuffer>> alive;
+    for (size_t i = 0; i < global->buffers.size(); ++i) {
+      if (global->buffers[i].use_count() > 1) {
+        alive.push_back(global->buffers[i]);
+        std::lock_guard<std::mutex> buffer_lock(global->buffers[i]->mutex);
+        global->buffers[i]->events.clear();
+        global->buffers[i]->dropped = 0;
+      }
+    }
+    global->buffers.swap(alive);
+    global->start = std::chrono::steady_clock::now();
+  }
+  tracing_ = true;
+}
+
+void Profiler::SetThreadName(const std::string& name) {
+  TraceBuffer* buffer = GetTraceBuffer();
+  std::lock_guard<std::mutex> lock(buffer->mutex);
+  buffer->thread_name = name;
+}
+
+void Profiler::AddTraceEvent(const char* name,
+                             std::chrono::steady_clock::time_point begin,
+                             std::chrono::steady_clock::time_point end) {
+  TraceBuffer* buffer = GetTraceBuffer();
+  std::lock_guard<std::mutex> lock(buffer->mutex);
+  if (buffer->events.size() < kMaxTraceEvents) {
+    buffer->events.push_back(TraceEvent{name, begin, end});
+  } else {
+    buffer->dropped++;
+  }
+}
+
+size_t Profiler::WriteTrace(const std::string& filename) {
+  GlobalTrace* global = GetGlobalTrace();
+  std::vector<std::shared_ptr<TraceBuffer>> buffers;
+  std::chrono::steady_clock::time_point start;
+  {
+    std::lock_guard<std::mutex> lock(global->mutex);
+    buffers = global->buffers;
+    start = global->start;
+  }
+  FILE* file = fopen(filename.c_str(), "w");
+  if (file == nullptr) {
+    LOG(FATAL) << "Cannot open file: " << filename;
+  }
+  int pid = getpid();
+  size_t count = 0;
+  fprintf(file, "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [\n");
+  for (size_t i = 0; i < buffers.size(); ++i) {
+    TraceBuffer* buffer = buffers[i].get();
+    std::lock_guard<std::mutex> lock(buffer->mutex);
+    if (!buffer->thread_name.empty()) {
+      fprintf(file, "%s{\"name\": \"thread_name\", \"ph\": \"M\", "
+              "\"pid\": %d, \"tid\": %ld, \"args\": {\"name\": \"%s\"}}",
+              count++ > 0 ? ",\n" : "", pid, buffer->tid,
+              JSONEscape(buffer->thread_name).c_str());
+    }
+    for (size_t j = 0; j < buffer->events.size(); ++j) {
+      const TraceEvent& event = buffer->events[j];
+      double ts = std::chrono::duration<double, std::micro>(
+        event.begin - start).count();
+      double dur = std::chrono::duration<double, std::micro>(
+        event.end - event.begin).count();
+      fprintf(file, "%s{\"name\": \"%s\", \"ph\": \"X\", "
+              "\"ts\": %.3f, \"dur\": %.3f, \"pid\": %d, \"tid\": %ld}",
+              count++ > 0 ? ",\n" : "", event.name, ts, dur,
+              pid, buffer->tid);
+    }
+    if (buffer->dropped > 0) {
+      LOG(WARNING) << "Thread " << buffer->tid << " dropped "
+                   << buffer->dropped << " trace events";
+    }
+  }
+  fprintf(file, "\n]}\n");
+  fclose(file);
+  return count;
+}
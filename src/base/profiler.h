@@ -0,0 +1,240 @@
+//------------------------------------------------------------------------------
+// Copyright (c) 2018 by contributors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//------------------------------------------------------------------------------
+
+
+/*!
+ *  Copyright (c) 2018 by Contributors
+ * \file profiler.h
+ * \brief This file defines the scoped profiler and trace recorder.
+ */
+#ifndef XFOREST_BASE_PROFILER_H_
+#define XFOREST_BASE_PROFILER_H_
+
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <vector>
+
+#include "src/base/common.h"
+
+/*!
+ * \brief Hardware counters recorded by Profiler::SetCounters()
+ */
+enum ProfileCounter {
+  kCycles,
+  kInstructions,
+  kCacheMisses,
+  kBranchMisses,
+  kNumCounters
+};
+
+/*!
+ * \brief Time of a zone, whose path is the names of the
+ * enclosing zones and its own name, e.g., "tree/histogram"
+ */
+struct ProfileStat {
+  std::string path;
+  int depth = 0;        // number of enclosing zones
+  uint64 count = 0;     // number of calls
+  uint64 total_ns = 0;  // total time (nanosecond)
+  uint64 counted = 0;   // number of calls with hardware counters
+  uint64 counters[kNumCounters] = {0};  // sum of hardware counters
+};
+
+/*!
+ * \brief We can profile the code by zones like this:
+ *
+ *   Profiler::SetEnabled(true);
+ *   {
+ *     PROFILE_ZONE("tree");
+ *     for (...) {
+ *       PROFILE_ZONE("histogram");   // "tree/histogram"
+ *       ...
+ *     }
+ *   }
+ *   std::vector<ProfileStat> stats;
+ *   Profiler::Stats(&stats);
+ *   std::cout << Profiler::Report(stats);
+ *
+ * Each thread accumulates the time of its zones without locking,
+ * and the zones of all threads are merged by path when a thread
+ * exits or calls FlushThread(). A disabled zone costs a load of
+ * an atomic flag.
+ *
+ * The zones can also be recorded as a timeline of Chrome trace
+ * events, which can be opened by chrome://tracing or Perfetto:
+ *
+ *   Profiler::StartTrace();
+ *   ...  // PROFILE_ZONE and TRACE_ZONE of all threads
+ *   Profiler::StopTrace();
+ *   Profiler::WriteTrace("/tmp/train.json");
+ *
+ * TRACE_ZONE is only recorded in the trace, which is used for the
+ * short and frequent spans, e.g., tree nodes and network messages.
+ *
+ * With SetCounters(true), the profiled zones also count the CPU
+ * cycles, instructions, cache misses and branch mispredicts of the
+ * thread by perf_event_open(), which are shown in the Report(). The
+ * counters are silently disabled if the kernel denies the access
+ * (e.g., by kernel.perf_event_paranoid).
+ */
+class Profiler {
+ public:
+  /*!
+   * \breif Enable or disable the zones
+   */
+  static void SetEnabled(bool flag) { enabled_ = flag; }
+  static bool Enabled() { return enabled_; }
+
+  /*!
+   * \breif Record the hardware counters in the profiled zones.
+   * Return false if the counters are not available.
+   */
+  static bool SetCounters(bool flag);
+  static bool Counters() { return counters_; }
+
+  /*!
+   * \breif Merge the zones of current thread to the global stats,
+   * and clear them. Must be called out of any zone.
+   */
+  static void FlushThread();
+
+  /*!
+   * \breif Zones of current thread since the last FlushThread()
+   */
+  static void ThreadStats(std::vector<ProfileStat>* stats);
+
+  /*!
+   * \breif Merged zones of the flushed and exited threads
+   */
+  static void Stats(std::vector<ProfileStat>* stats);
+
+  /*!
+   * \breif Clear the global stats
+   */
+  static void Reset();
+
+  /*!
+   * \breif Format the stats as a tree, with the percentage
+   * of the time of the enclosing zone
+   */
+  static std::string Report(const std::vector<ProfileStat>& stats);
+
+  /*!
+   * \breif Clear the recorded trace events, and record the
+   * zones of all threads until StopTrace()
+   */
+  static void StartTrace();
+  static void StopTrace() { tracing_ = false; }
+  static bool Tracing() { return tracing_; }
+
+  /*!
+   * \breif Name current thread in the trace
+   */
+  static void SetThreadName(const std::string& name);
+
+  /*!
+   * \breif Write the recorded events in Chrome trace JSON format.
+   * Return the number of events.
+   */
+  static size_t WriteTrace(const std::string& filename);
+
+  /*!
+   * \breif Used by ProfileZone and TraceZone
+   */
+  static void Enter(const char* name);
+  static void Leave(uint64 elapsed_ns);
+  static void AddTraceEvent(const char* name,
+                            std::chrono::steady_clock::time_point begin,
+                            std::chrono::steady_clock::time_point end);
+
+ private:
+  static std::atomic<bool> enabled_;
+  static std::atomic<bool> tracing_;
+  static std::atomic<bool> counters_;
+};
+
+/*!
+ * \brief Add the time from construction to destruction to the zone
+ */
+class ProfileZone {
+ public:
+  explicit ProfileZone(const char* name)
+    : name_(name),
+      profile_(Profiler::Enabled()),
+      trace_(Profiler::Tracing()) {
+    if (profile_) {
+      Profiler::Enter(name);
+    }
+    if (profile_ || trace_) {
+      begin_ = std::chrono::steady_clock::now();
+    }
+  }
+  ~ProfileZone() {
+    if (profile_ || trace_) {
+      auto end = std::chrono::steady_clock::now();
+      if (profile_) {
+        Profiler::Leave(std::chrono::duration_cast<
+          std::chrono::nanoseconds>(end - begin_).count());
+      }
+      if (trace_) {
+        Profiler::AddTraceEvent(name_, begin_, end);
+      }
+    }
+  }
+
+ private:
+  const char* name_;
+  bool profile_;
+  bool trace_;
+  std::chrono::steady_clock::time_point begin_;
+
+  DISALLOW_COPY_AND_ASSIGN(ProfileZone);
+};
+
+/*!
+ * \brief Record the span from construction to destruction in
+ * the trace. The name must be a string literal.
+ */
+class TraceZone {
+ public:
+  explicit TraceZone(const char* name)
+    : name_(name), trace_(Profiler::Tracing()) {
+    if (trace_) {
+      begin_ = std::chrono::steady_clock::now();
+    }
+  }
+  ~TraceZone() {
+    if (trace_) {
+      Profiler::AddTraceEvent(name_, begin_,
+                              std::chrono::steady_clock::now());
+    }
+  }
+
+ private:
+  const char* name_;
+  bool trace_;
+  std::chrono::steady_clock::time_point begin_;
+
+  DISALLOW_COPY_AND_ASSIGN(TraceZone);
+};
+
+#define PROFILE_ZONE_CONCAT(a, b) a##b
+#define PROFILE_ZONE_NAME(line) PROFILE_ZONE_CONCAT(profile_zone_, line)
+#define PROFILE_ZONE(name) ProfileZone PROFILE_ZONE_NAME(__LINE__)(name)
+#define TRACE_ZONE(name) TraceZone PROFILE_ZONE_NAME(__LINE__)(name)
+
+#endif  // XFOREST_BASE_PROFILER_H_
@@ -0,0 +1,163 @@
+//------------------------------------------------------------------------------
+// Copyright (c) 2018 by contributors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//------------------------------------------------------------------------------
+
+
+/*!
+ *  Copyright (c) 2018 by Contributors
+ * \file profiler_test.cc
+ * \brief This file tests profiler.h file.
+ */
+#include "gtest/gtest.h"
+
+#include <stdio.h>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "src/base/profiler.h"
+
+// Find the stat of path, or nullptr
+static const ProfileStat* Find(const std::vector<ProfileStat>& stats,
+                               const std::string& path) {
+  for (size_t i = 0; i < stats.size(); ++i) {
+    if (stats[i].path == path) {
+      return &stats[i];
+    }
+  }
+  return nullptr;
+}
+
+static void Work() {
+  PROFILE_ZONE("work");
+  for (int i = 0; i < 3; ++i) {
+    PROFILE_ZONE("inner");
+    std::this_thread::sleep_for(std::chrono::microseconds(100));
+  }
+}
+
+TEST(Profiler, Nested) {
+  Profiler::SetEnabled(true);
+  Profiler::Reset();
+  Work();
+  Work();
+  std::vector<ProfileStat> stats;
+  Profiler::ThreadStats(&stats);
+  ASSERT_EQ(stats.size(), 2);
+  EXPECT_EQ(stats[0].path, "work");
+  EXPECT_EQ(stats[0].count, 2);
+  EXPECT_EQ(stats[1].path, "work/inner");
+  EXPECT_EQ(stats[1].depth, 1);
+  EXPECT_EQ(stats[1].count, 6);
+  EXPECT_GE(stats[1].total_ns, 600000);
+  EXPECT_GE(stats[0].total_ns, stats[1].total_ns);
+  // Not merged until flush
+  Profiler::Stats(&stats);
+  EXPECT_TRUE(stats.empty());
+  Profiler::FlushThread();
+  Profiler::ThreadStats(&stats);
+  EXPECT_TRUE(stats.empty());
+  Profiler::Stats(&stats);
+  EXPECT_EQ(stats.size(), 2);
+  printf("%s", Profiler::Report(stats).c_str());
+  Profiler::SetEnabled(false);
+}
+
+TEST(Profiler, Threads) {
+  Profiler::SetEnabled(true);
+  Profiler::Reset();
+  std::vector<std::thread> threads;
+  for (int t = 0; t < 4; ++t) {
+    threads.push_back(std::thread(Work));
+  }
+  for (size_t i = 0; i < threads.size(); ++i) {
+    threads[i].join();
+  }
+  // Disabled zones are not counted
+  Profiler::SetEnabled(false);
+  Work();
+  Profiler::FlushThread();
+  std::vector<ProfileStat> stats;
+  Profiler::Stats(&stats);
+  ASSERT_TRUE(Find(stats, "work") != nullptr);
+  EXPECT_EQ(Find(stats, "work")->count, 4);
+  EXPECT_EQ(Find(stats, "work/inner")->count, 12);
+}
+
+TEST(Profiler, Trace) {
+  const char* kFile = "/tmp/profiler_test_trace.json";
+  Profiler::StartTrace();
+  std::vector<std::thread> threads;
+  for (int t = 0; t < 2; ++t) {
+    threads.push_back(std::thread([t]() {
+      Profiler::SetThreadName("thread " + std::to_string(t));
+      Work();
+      TRACE_ZONE("trace_only");
+    }));
+  }
+  for (size_t i = 0; i < threads.size(); ++i) {
+    threads[i].join();
+  }
+  Profiler::StopTrace();
+  Work();  // not recorded
+  // 2 thread names, and 5 spans of each thread
+  EXPECT_EQ(Profiler::WriteTrace(kFile), 12);
+  std::ifstream file(kFile);
+  std::string json((std::istreambuf_iterator<char>(file)),
+                   std::istreambuf_iterator<char>());
+  EXPECT_EQ(json.find("{\"displayTimeUnit\": \"ms\", \"traceEvents\": ["), 0);
+  EXPECT_NE(json.find("\"name\": \"inner\", \"ph\": \"X\""),
+            std::string::npos);
+  EXPECT_NE(json.find("\"name\": \"trace_only\""), std::string::npos);
+  EXPECT_NE(json.find("\"args\": {\"name\": \"thread 1\"}"),
+            std::string::npos);
+  EXPECT_EQ(json.substr(json.size() - 4), "\n]}\n");
+  remove(kFile);
+}
+
+TEST(Profiler, Counters) {
+  Profiler::SetEnabled(true);
+  Profiler::Reset();
+  bool available = Profiler::SetCounters(true);
+  EXPECT_EQ(Profiler::Counters(), available);
+  uint64 sum = 0;
+  {
+    PROFILE_ZONE("loop");
+    for (int i = 0; i < 1000000; ++i) {
+      sum += i * i;
+    }
+  }
+  EXPECT_GT(sum, 0);
+  std::vector<ProfileStat> stats;
+  Profiler::ThreadStats(&stats);
+  ASSERT_EQ(stats.size(), 1);
+  // Silently disabled if the kernel denies the access
+  std::string report = Profiler::Report(stats);
+  if (available) {
+    EXPECT_EQ(stats[0].counted, 1);
+    EXPECT_GT(stats[0].counters[kInstructions], 0);
+    EXPECT_GT(stats[0].counters[kCycles], 0);
+    EXPECT_NE(report.find("IPC"), std::string::npos);
+  } else {
+    EXPECT_EQ(stats[0].counted, 0);
+    EXPECT_EQ(report.find("IPC"), std::string::npos);
+  }
+  printf("%s", report.c_str());
+  Profiler::FlushThread();
+  Profiler::SetCounters(false);
+  Profiler::SetEnabled(false);
+}
@@ -0,0 +1,62 @@
+//------------------------------------------------------------------------------
+// Copyright (c) 2018 by contributors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//------------------------------------------------------------------------------
+
+
+/*!
+ *  Copyright (c) 2018 by Contributors
+ * \file serialize_util.h
+ * \brief This file contains the helpers to write and read binary
+ * values in a string, used by the model and checkpoint formats.
+ */
+#ifndef XFOREST_BASE_SERIALIZE_UTIL_H_
+#define XFOREST_BASE_SERIALIZE_UTIL_H_
+
+#include <string.h>
+#include <string>
+
+#include "src/base/logging.h"
+
+/*!
+ * \breif Append the binary value to string
+ */
+template <typename T>
+inline void WriteValue(const T& val, std::string* str) {
+  str->append(reinterpret_cast<const char*>(&val), sizeof(T));
+}
+
+/*!
+ * \breif Read the binary value from str[*pos] and advance *pos
+ */
+template <typename T>
+inline T ReadValue(const std::string& str, size_t* pos) {
+  CHECK_LE(*pos + sizeof(T), str.size());
+  T val;
+  memcpy(&val, str.data() + *pos, sizeof(T));
+  *pos += sizeof(T);
+  return val;
+}
+
+/*!
+ * \breif Read len bytes from str[*pos] and advance *pos
+ */
+inline void ReadBytes(const std::string& str, size_t* pos,
+                      char* data, size_t len) {
+  CHECK_LE(*pos + len, str.size());
+  memcpy(data, str.data() + *pos, len);
+  *pos += len;
+}
+
+#endif  // XFOREST_BASE_SERIALIZE_UTIL_H_
@@ -30,8 +30,7 @@ Timer::Timer() {
  */
 void Timer::reset() {
   begin = std::chrono::high_resolution_clock::now();
-  duration =
-     std::chrono::duration_cast<std::chrono::milliseconds>(begin-begin);
+  duration = std::chrono::nanoseconds::zero();
 }
 
 /*!
@@ -45,7 +44,7 @@ void Timer::tic() {
  * \breif Code end
  */
 float Timer::toc() {
-  duration += std::chrono::duration_cast<std::chrono::milliseconds>
+  duration += std::chrono::duration_cast<std::chrono::nanoseconds>
               (std::chrono::high_resolution_clock::now()-begin);
   return get();
 }
@@ -54,5 +53,5 @@ float Timer::toc() {
  * \breif Get the time duration (seconds)
  */
 float Timer::get() {
-  return (float)duration.count() / 1000;
+  return (double)duration.count() / 1e9;
 }
\ No newline at end of file
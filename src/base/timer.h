@@ -67,7 +67,7 @@ class Timer {
 
  protected:
   std::chrono::high_resolution_clock::time_point begin;
-  std::chrono::milliseconds duration;
+  std::chrono::nanoseconds duration;
 
  private:
   DISALLOW_COPY_AND_ASSIGN(Timer);
@@ -0,0 +1,136 @@
+//------------------------------------------------------------------------------
+// Copyright (c) 2018 by contributors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//------------------------------------------------------------------------------
+
+/*
+This file is the implementation of Communicator class.
+*/
+
+#include "src/network/communicator.h"
+
+#include "src/network/epoll_communicator.h"
+#include "src/network/hierarchical_communicator.h"
+#include "src/network/histo_codec.h"
+#include "src/network/shm_communicator.h"
+#include "src/network/socket_communicator.h"
+
+namespace xforest {
+
+//------------------------------------------------------------------------------
+// Class register
+//------------------------------------------------------------------------------
+CLASS_REGISTER_IMPLEMENT_REGISTRY(xforest_communicator_registry, Communicator);
+REGISTER_COMMUNICATOR("socket", SocketCommunicator);
+REGISTER_COMMUNICATOR("epoll", EpollCommunicator);
+REGISTER_COMMUNICATOR("shm", ShmCommunicator);
+REGISTER_COMMUNICATOR("hierarchical", HierarchicalCommunicator);
+
+//------------------------------------------------------------------------------
+// Communicator class
+//------------------------------------------------------------------------------
+
+// Send len bytes by messages of at most kMaxMessageBytes
+void Communicator::SendBytes(int rank, const char* data, size_t len) {
+  for (size_t pos = 0; pos < len; pos += kMaxMessageBytes) {
+    Send(rank, data + pos, std::min(len - pos, kMaxMessageBytes));
+  }
+}
+
+// Recv len bytes by messages of at most kMaxMessageBytes
+void Communicator::RecvBytes(int rank, char* data, size_t len) {
+  for (size_t pos = 0; pos < len; pos += kMaxMessageBytes) {
+    Recv(rank, data + pos, std::min(len - pos, kMaxMessageBytes));
+  }
+}
+
+// Send and receive len bytes by messages of at most kMaxMessageBytes.
+// The two sides may have different lengths, so the shorter one
+// sends (or receives) nothing in the last steps.
+void Communicator::SendRecvBytes(int send_rank, const char* send_data,
+                                 size_t send_len,
+                                 int recv_rank, char* recv_data,
+                                 size_t recv_len) {
+  size_t len = std::max(send_len, recv_len);
+  size_t pos = 0;
+  do {
+    size_t send_size = pos < send_len ? 
+      std::min(send_len - pos, kMaxMessageBytes) : 0;
+    size_t recv_size = pos < recv_len ?
+      std::min(recv_len - pos, kMaxMessageBytes) : 0;
+    SendRecv(send_rank, send_data + pos, send_size,
+             recv_rank, recv_data + pos, recv_size);
+    pos += kMaxMessageBytes;
+  } while (pos < len);
+}
+
+// Send and receive an encoded message
+void Communicator::SendRecvMessage(int send_rank, 
+                                   const std::string& send_msg,
+                                   int recv_rank, 
+                                   std::string* recv_msg) {
+  uint64 send_len = send_msg.size();
+  uint64 recv_len = 0;
+  SendRecv(send_rank, reinterpret_cast<const char*>(&send_len), 
+           sizeof(send_len),
+           recv_rank, reinterpret_cast<char*>(&recv_len), 
+           sizeof(recv_len));
+  recv_msg->resize(recv_len);
+  SendRecvBytes(send_rank, send_msg.data(), send_len,
+                recv_rank, &(*recv_msg)[0], recv_len);
+}
+
+// ReduceScatter with encoded blocks
+void Communicator::EncodedReduceScatter(uint32* data, 
+                                        const std::vector<size_t>& starts) {
+  int size = Size();
+  int next = (rank_ + 1) % size;
+  int prev = (rank_ + size - 1) % size;
+  std::string send_msg;
+  std::string recv_msg;
+  // The same steps as ReduceScatter()
+  for (int s = 0; s < size - 1; ++s) {
+    int send_block = (rank_ - s - 1 + 2 * size) % size;
+    int recv_block = (rank_ - s - 2 + 2 * size) % size;
+    EncodeHisto(data + starts[send_block], 
+                starts[send_block+1] - starts[send_block], &send_msg);
+    SendRecvMessage(next, send_msg, prev, &recv_msg);
+    DecodeHisto(recv_msg.data(), recv_msg.size(), 
+                data + starts[recv_block],
+                starts[recv_block+1] - starts[recv_block], true);
+  }
+}
+
+// RingAllGather with encoded blocks. Each block is encoded 
+// only once by its owner, and then forwarded as it is.
+void Communicator::EncodedAllGather(uint32* data, 
+                                    const std::vector<size_t>& starts) {
+  int size = Size();
+  int next = (rank_ + 1) % size;
+  int prev = (rank_ + size - 1) % size;
+  std::string send_msg;
+  std::string recv_msg;
+  EncodeHisto(data + starts[rank_], starts[rank_+1] - starts[rank_], 
+              &send_msg);
+  for (int s = 0; s < size - 1; ++s) {
+    int recv_block = (rank_ - s - 1 + size) % size;
+    SendRecvMessage(next, send_msg, prev, &recv_msg);
+    DecodeHisto(recv_msg.data(), recv_msg.size(), 
+                data + starts[recv_block],
+                starts[recv_block+1] - starts[recv_block], false);
+    send_msg.swap(recv_msg);
+  }
+}
+
+}  // namespace xforest
@@ -21,19 +21,58 @@ This file defines the Communicator class.
 #ifndef XFOREST_NETWORK_COMMUNICATOR_H_
 #define XFOREST_NETWORK_COMMUNICATOR_H_
 
+#include <string.h>
+#include <algorithm>
+#include <string>
+#include <type_traits>
+#include <vector>
+
 #include "src/base/common.h"
+#include "src/base/class_register.h"
+#include "src/base/memory_tracker.h"
 
 namespace xforest {
 
+// Algorithm of Allreduce
+enum AllreduceAlgo {
+  kAllreduceAuto,  // choose by message size
+  kAllreduceRing,  // bandwidth-optimal ring
+  kAllreduceTree   // latency-optimal binomial tree
+};
+
+// Messages smaller than this use tree Allreduce in kAllreduceAuto
+const size_t kRingAllreduceBytes = 64 * 1024;
+
+// Maximal bytes of a Send/Recv, whose length is int
+const size_t kMaxMessageBytes = kInt32Max;
+
 //------------------------------------------------------------------------------
 // An network basic communication warpper.
 // Will warp low level communication method, e.g., mpi, socket, and so on.
+//
+// The nodes are ranked from 0 (master) to num_workers, and every
+// node can talk to every other node. On top of Send/Recv, the
+// Communicator provides the collective operations, which must be
+// called by all of the nodes in the same order:
+//
+//   comm->Allreduce(histo, len);         // sum histo over all nodes
+//   comm->Broadcast(model, len, 0);      // copy model from rank 0
+//   comm->Gather(local, len, all, 0);    // rank 0 gets all local
+//   comm->AllGather(local, len, all);    // every rank gets all local
+//   comm->ReduceScatter(histo, starts);  // rank r gets the sum of
+//                                        // block r of histo
+//
+// With SetCompression(true), the uint32 data (e.g., histograms) of
+// the ring collectives is sent in the encoding of EncodeHisto().
+// A HierarchicalCommunicator runs Allreduce, ReduceScatter, Broadcast
+// and AllGather within each host first, and only the host leaders
+// talk across hosts.
 //------------------------------------------------------------------------------	
 class Communicator {
  public:
   // ctor and dctor
   Communicator() {}
-  ~Communicator() {}
+  virtual ~Communicator() {}
 
   // Initialize Communicator
   virtual void Initialize(int rank, /* master is rank_0 */
@@ -45,8 +84,463 @@ class Communicator {
 
   // Send data
   virtual void Send(int rank, const char* data, int len) = 0;
+
+  // Send data to send_rank while receiving data from recv_rank,
+  // so that a ring of nodes can exchange data without deadlock.
+  // Every transport implements it by making progress on both
+  // sides at once (polling, epoll or the two shm rings), since
+  // the blocking default ISend() below cannot overlap them.
+  virtual void SendRecv(int send_rank, const char* send_data, int send_len,
+                        int recv_rank, char* recv_data, int recv_len) = 0;
+
+  // Asynchronous Send and Recv return a handle for Wait(),
+  // and data must be valid until Wait() returns. Requests to
+  // the same rank are finished in order. By default they are
+  // blocking, and overrided by event-driven communicators.
+  virtual int ISend(int rank, const char* data, int len) {
+    Send(rank, data, len);
+    return 0;
+  }
+  virtual int IRecv(int rank, char* data, int len) {
+    Recv(rank, data, len);
+    return 0;
+  }
+
+  // Wait the request of handle to finish
+  virtual void Wait(int handle) {}
+
+  // Wait until the data of the finished Send() calls can be
+  // modified. Only the communicators sending without copy (see
+  // SocketCommunicator::SetZeroCopy) need it, and the
+  // collectives call it before they return.
+  virtual void WaitSends() {}
+
+  // Send and Recv len bytes, which can be larger than
+  // kMaxMessageBytes, by messages of at most kMaxMessageBytes
+  void SendBytes(int rank, const char* data, size_t len);
+  void RecvBytes(int rank, char* data, size_t len);
+
+  // Rank of local node
+  int Rank() const { return rank_; }
+
+  // Total number of nodes (master and workers)
+  int Size() const { return num_workers_ + 1; }
+
+  // Encode the uint32 messages of ring collectives, which
+  // must be the same on all nodes
+  void SetCompression(bool flag) { compress_ = flag; }
+
+  // Sum data over all nodes. Every node gets the result.
+  template <typename T>
+  void Allreduce(T* data, size_t count, 
+                 AllreduceAlgo algo = kAllreduceAuto);
+
+  // Copy data of root to all nodes
+  template <typename T>
+  void Broadcast(T* data, size_t count, int root);
+
+  // Gather count elements of each node to recv_data of root,
+  // ordered by rank. recv_data is only used by root.
+  template <typename T>
+  void Gather(const T* send_data, size_t count, T* recv_data, int root);
+
+  // Gather count elements of each node to recv_data of
+  // all nodes, ordered by rank.
+  template <typename T>
+  void AllGather(const T* send_data, size_t count, T* recv_data);
+
+  // Sum data over all nodes, but rank r only gets the result
+  // of block r, which is data[starts[r], starts[r+1]). starts
+  // has Size() + 1 elements. The other blocks are garbage.
+  template <typename T>
+  void ReduceScatter(T* data, const std::vector<size_t>& starts);
+
+ protected:
+  int rank_ = 0;          // rank of local machine
+  int num_workers_ = 0;   // total number of workers 
+  bool compress_ = false; // encode uint32 messages
+
+  // Topology of hierarchical collectives. The ranks of a host
+  // are consecutive, and local rank 0 is the leader of host.
+  bool hierarchical_ = false;       // use hierarchical collectives
+  int local_size_ = 1;              // ranks per host
+  Communicator* local_ = nullptr;   // ranks on the same host, nullptr
+                                    // if the host has only one rank
+  Communicator* leader_ = nullptr;  // leaders of hosts, nullptr on
+                                    // non-leaders or single host
+
+ private:
+  // SendRecv of len bytes by messages of at most kMaxMessageBytes
+  void SendRecvBytes(int send_rank, const char* send_data, size_t send_len,
+                     int recv_rank, char* recv_data, size_t recv_len);
+
+  // Sum data to rank 0 by binomial tree
+  template <typename T>
+  void Reduce(T* data, size_t count);
+
+  // Hierarchical collectives
+  template <typename T>
+  void HierAllreduce(T* data, size_t count, AllreduceAlgo algo);
+  template <typename T>
+  void HierReduceScatter(T* data, const std::vector<size_t>& starts);
+  template <typename T>
+  void HierBroadcast(T* data, size_t count, int root);
+  template <typename T>
+  void HierAllGather(const T* send_data, size_t count, T* recv_data);
+
+  // Send the encoded message to send_rank while receiving
+  // one from recv_rank, whose size is sent first
+  void SendRecvMessage(int send_rank, const std::string& send_msg,
+                       int recv_rank, std::string* recv_msg);
+
+  // ReduceScatter and RingAllGather of uint32 data,
+  // where the blocks are encoded by EncodeHisto()
+  void EncodedReduceScatter(uint32* data, const std::vector<size_t>& starts);
+  void EncodedAllGather(uint32* data, const std::vector<size_t>& starts);
+
+  // Reduce-scatter and then allgather along the ring
+  template <typename T>
+  void RingAllreduce(T* data, size_t count);
+
+  // Rank r owns block r of data. Pass the blocks
+  // along the ring, so that every rank gets all blocks.
+  template <typename T>
+  void RingAllGather(T* data, const std::vector<size_t>& starts);
+
+  // Reduce to rank 0 and then broadcast by binomial tree
+  template <typename T>
+  void TreeAllreduce(T* data, size_t count);
+
+  DISALLOW_COPY_AND_ASSIGN(Communicator);
 };
 
+//------------------------------------------------------------------------------
+// Implementation of the collective operations
+//------------------------------------------------------------------------------
+
+// Start of the i-th of num chunks of count elements
+inline size_t ChunkStart(size_t count, int num, int i) {
+  return count * i / num;
+}
+
+template <typename T>
+void Communicator::Allreduce(T* data, size_t count, AllreduceAlgo algo) {
+  if (Size() == 1 || count == 0) {
+    return;
+  }
+  CHECK_NOTNULL(data);
+  if (hierarchical_) {
+    HierAllreduce(data, count, algo);
+    return;
+  }
+  if (algo == kAllreduceAuto) {
+    algo = count * sizeof(T) < kRingAllreduceBytes || count < Size() ?
+           kAllreduceTree : kAllreduceRing;
+  }
+  if (algo == kAllreduceRing) {
+    RingAllreduce(data, count);
+  } else {
+    TreeAllreduce(data, count);
+  }
+}
+
+template <typename T>
+void Communicator::RingAllreduce(T* data, size_t count) {
+  std::vector<size_t> starts(Size() + 1);
+  for (int i = 0; i <= Size(); ++i) {
+    starts[i] = ChunkStart(count, Size(), i);
+  }
+  ReduceScatter(data, starts);
+  RingAllGather(data, starts);
+}
+
+template <typename T>
+void Communicator::ReduceScatter(T* data, const std::vector<size_t>& starts) {
+  CHECK_NOTNULL(data);
+  int size = Size();
+  CHECK_EQ(starts.size(), size + 1);
+  if (size == 1) {
+    return;
+  }
+  if (hierarchical_) {
+    HierReduceScatter(data, starts);
+    return;
+  }
+  if (compress_ && std::is_same<T, uint32>::value) {
+    EncodedReduceScatter(reinterpret_cast<uint32*>(data), starts);
+    return;
+  }
+  int next = (rank_ + 1) % size;
+  int prev = (rank_ + size - 1) % size;
+  size_t max_len = 0;
+  for (int i = 0; i < size; ++i) {
+    CHECK_LE(starts[i], starts[i+1]);
+    max_len = std::max(max_len, starts[i+1] - starts[i]);
+  }
+  TrackedVector<T, kMemNetwork> buf(max_len);
+  // After step s, rank r holds the sum of block (r - s - 2)
+  // over ranks r - s - 1, ..., r. So rank r gets the complete
+  // block r after the last step (s = size - 2).
+  for (int s = 0; s < size - 1; ++s) {
+    int send_block = (rank_ - s - 1 + 2 * size) % size;
+    int recv_block = (rank_ - s - 2 + 2 * size) % size;
+    size_t send_len = starts[send_block+1] - starts[send_block];
+    size_t recv_len = starts[recv_block+1] - starts[recv_block];
+    SendRecvBytes(next, 
+                  reinterpret_cast<const char*>(data + starts[send_block]),
+                  send_len * sizeof(T),
+                  prev, reinterpret_cast<char*>(buf.data()),
+                  recv_len * sizeof(T));
+    T* dst = data + starts[recv_block];
+    for (size_t i = 0; i < recv_len; ++i) {
+      dst[i] += buf[i];
+    }
+  }
+}
+
+template <typename T>
+void Communicator::RingAllGather(T* data, const std::vector<size_t>& starts) {
+  if (compress_ && std::is_same<T, uint32>::value) {
+    EncodedAllGather(reinterpret_cast<uint32*>(data), starts);
+    return;
+  }
+  int size = Size();
+  int next = (rank_ + 1) % size;
+  int prev = (rank_ + size - 1) % size;
+  for (int s = 0; s < size - 1; ++s) {
+    int send_block = (rank_ - s + size) % size;
+    int recv_block = (rank_ - s - 1 + size) % size;
+    size_t send_len = starts[send_block+1] - starts[send_block];
+    size_t recv_len = starts[recv_block+1] - starts[recv_block];
+    SendRecvBytes(next, 
+                  reinterpret_cast<const char*>(data + starts[send_block]),
+                  send_len * sizeof(T),
+                  prev, reinterpret_cast<char*>(data + starts[recv_block]),
+                  recv_len * sizeof(T));
+  }
+}
+
+template <typename T>
+void Communicator::TreeAllreduce(T* data, size_t count) {
+  Reduce(data, count);
+  Broadcast(data, count, 0);
+}
+
+template <typename T>
+void Communicator::Reduce(T* data, size_t count) {
+  int size = Size();
+  size_t len = count * sizeof(T);
+  TrackedVector<T, kMemNetwork> buf(count);
+  // Binomial tree reduce to rank 0
+  for (int mask = 1; mask < size; mask <<= 1) {
+    if (rank_ & mask) {
+      SendBytes(rank_ - mask, reinterpret_cast<const char*>(data), len);
+      WaitSends();
+      break;
+    }
+    if (rank_ + mask < size) {
+      RecvBytes(rank_ + mask, reinterpret_cast<char*>(buf.data()), len);
+      for (size_t i = 0; i < count; ++i) {
+        data[i] += buf[i];
+      }
+    }
+  }
+}
+
+template <typename T>
+void Communicator::HierAllreduce(T* data, size_t count, 
+                                 AllreduceAlgo algo) {
+  // Reduce to the leader within host, allreduce across hosts
+  // by the leaders, and then broadcast back within host
+  if (local_ != nullptr) {
+    local_->Reduce(data, count);
+  }
+  if (leader_ != nullptr) {
+    leader_->compress_ = compress_;
+    leader_->Allreduce(data, count, algo);
+  }
+  if (local_ != nullptr) {
+    local_->Broadcast(data, count, 0);
+  }
+}
+
+template <typename T>
+void Communicator::HierReduceScatter(T* data, 
+                                     const std::vector<size_t>& starts) {
+  int size = Size();
+  int host = rank_ / local_size_;
+  int num_hosts = (size + local_size_ - 1) / local_size_;
+  int host_begin = host * local_size_;
+  int host_end = std::min(host_begin + local_size_, size);
+  // Reduce to the leader within host, reduce-scatter across hosts
+  // by the leaders, where the block of a host is the blocks of its
+  // ranks, and then the leader sends each local rank its block
+  if (local_ != nullptr) {
+    local_->Reduce(data + starts[0], starts[size] - starts[0]);
+  }
+  if (leader_ != nullptr) {
+    std::vector<size_t> host_starts(num_hosts + 1);
+    for (int h = 0; h <= num_hosts; ++h) {
+      host_starts[h] = starts[std::min(h * local_size_, size)];
+    }
+    leader_->compress_ = compress_;
+    leader_->ReduceScatter(data, host_starts);
+  }
+  if (local_ != nullptr) {
+    if (rank_ == host_begin) {
+      for (int r = host_begin + 1; r < host_end; ++r) {
+        local_->SendBytes(r - host_begin, 
+          reinterpret_cast<const char*>(data + starts[r]),
+          (starts[r+1] - starts[r]) * sizeof(T));
+      }
+      local_->WaitSends();
+    } else {
+      local_->RecvBytes(0, reinterpret_cast<char*>(data + starts[rank_]),
+                        (starts[rank_+1] - starts[rank_]) * sizeof(T));
+    }
+  }
+}
+
+template <typename T>
+void Communicator::HierBroadcast(T* data, size_t count, int root) {
+  int host = rank_ / local_size_;
+  int root_host = root / local_size_;
+  // Root -> leader of root host -> other leaders -> local ranks
+  if (local_ != nullptr && host == root_host) {
+    local_->Broadcast(data, count, root % local_size_);
+  }
+  if (leader_ != nullptr) {
+    leader_->Broadcast(data, count, root_host);
+  }
+  if (local_ != nullptr && host != root_host) {
+    local_->Broadcast(data, count, 0);
+  }
+}
+
+template <typename T>
+void Communicator::HierAllGather(const T* send_data, size_t count, 
+                                 T* recv_data) {
+  // The ranks of a host are consecutive, so the data of
+  // host h is the h-th block of recv_data
+  int host = rank_ / local_size_;
+  int num_hosts = (Size() + local_size_ - 1) / local_size_;
+  T* host_data = recv_data + (size_t)host * local_size_ * count;
+  if (local_ != nullptr) {
+    local_->AllGather(send_data, count, host_data);
+  } else {
+    memcpy(host_data, send_data, count * sizeof(T));
+  }
+  if (leader_ != nullptr) {
+    std::vector<size_t> starts(num_hosts + 1);
+    for (int h = 0; h <= num_hosts; ++h) {
+      starts[h] = std::min(h * local_size_, Size()) * count;
+    }
+    leader_->RingAllGather(recv_data, starts);
+  }
+  if (local_ != nullptr) {
+    local_->Broadcast(recv_data, Size() * count, 0);
+  }
+}
+
+template <typename T>
+void Communicator::Broadcast(T* data, size_t count, int root) {
+  CHECK_NOTNULL(data);
+  CHECK_GE(root, 0);
+  CHECK_LT(root, Size());
+  if (hierarchical_) {
+    HierBroadcast(data, count, root);
+    return;
+  }
+  int size = Size();
+  size_t len = count * sizeof(T);
+  // Binomial tree on the ranks relative to root
+  int vrank = (rank_ - root + size) % size;
+  int mask = 1;
+  while (mask < size) {
+    if (vrank & mask) {
+      RecvBytes((vrank - mask + root) % size,
+                reinterpret_cast<char*>(data), len);
+      break;
+    }
+    mask <<= 1;
+  }
+  mask >>= 1;
+  while (mask > 0) {
+    if (vrank + mask < size) {
+      SendBytes((vrank + mask + root) % size, 
+                reinterpret_cast<const char*>(data), len);
+    }
+    mask >>= 1;
+  }
+  WaitSends();
+}
+
+template <typename T>
+void Communicator::Gather(const T* send_data, size_t count, 
+                          T* recv_data, int root) {
+  CHECK_NOTNULL(send_data);
+  CHECK_GE(root, 0);
+  CHECK_LT(root, Size());
+  size_t len = count * sizeof(T);
+  if (rank_ != root) {
+    SendBytes(root, reinterpret_cast<const char*>(send_data), len);
+    WaitSends();
+    return;
+  }
+  CHECK_NOTNULL(recv_data);
+  // Receive from all nodes at the same time
+  std::vector<int> handles;
+  for (int r = 0; r < Size(); ++r) {
+    char* dst = reinterpret_cast<char*>(recv_data + (size_t)r * count);
+    if (r == root) {
+      memcpy(dst, send_data, len);
+      continue;
+    }
+    // The requests to the same rank are finished in order
+    for (size_t pos = 0; pos < len; pos += kMaxMessageBytes) {
+      handles.push_back(
+        IRecv(r, dst + pos, std::min(len - pos, kMaxMessageBytes)));
+    }
+  }
+  for (size_t i = 0; i < handles.size(); ++i) {
+    Wait(handles[i]);
+  }
+}
+
+template <typename T>
+void Communicator::AllGather(const T* send_data, size_t count, 
+                             T* recv_data) {
+  CHECK_NOTNULL(send_data);
+  CHECK_NOTNULL(recv_data);
+  if (hierarchical_) {
+    HierAllGather(send_data, count, recv_data);
+    return;
+  }
+  memcpy(recv_data + rank_ * count, send_data, count * sizeof(T));
+  std::vector<size_t> starts(Size() + 1);
+  for (int i = 0; i <= Size(); ++i) {
+    starts[i] = i * count;
+  }
+  RingAllGather(recv_data, starts);
+}
+
+//------------------------------------------------------------------------------
+// Class register
+//------------------------------------------------------------------------------
+CLASS_REGISTER_DEFINE_REGISTRY(xforest_communicator_registry, Communicator);
+
+#define REGISTER_COMMUNICATOR(format_name, communicator_name)  \
+  CLASS_REGISTER_OBJECT_CREATOR(                               \
+      xforest_communicator_registry,                           \
+      Communicator,                                            \
+      format_name,                                             \
+      communicator_name)
+
+#define CREATE_COMMUNICATOR(format_name)                       \
+  CLASS_REGISTER_CREATE_OBJECT(                                \
+      xforest_communicator_registry,                           \
+      format_name)
+
 }  // namespace xforest
 
 #endif  // XFOREST_NETWORK_COMMUNICATOR_H_
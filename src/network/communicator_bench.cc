@@ -0,0 +1,235 @@
+//------------------------------------------------------------------------------
+// Copyright (c) 2018 by contributors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//------------------------------------------------------------------------------
+
+
+/*
+This file is the microbenchmark of the communicators. All of
+the nodes run in threads of one process, and talk by loopback
+sockets or shared memory:
+
+  ./communicator_bench [num_workers] [json_file]
+
+It measures the point-to-point latency and bandwidth between
+rank 0 and rank 1, and the throughput of Allreduce (ring and
+tree) and Broadcast over message sizes. The results are printed
+as a table, and written to json_file (communicator_bench.json
+by default) as a JSON array for regression tracking.
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <algorithm>
+#include <chrono>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "src/base/common.h"
+#include "src/base/scoped_ptr.h"
+#include "src/base/stringprintf.h"
+#include "src/network/communicator.h"
+
+namespace xforest {
+
+// Total bytes moved by each measurement
+static const uint64 kBytesPerTest = 64 * 1024 * 1024;
+static const int kMinIters = 5;
+static const int kMaxIters = 1000;
+
+// One line of the results
+struct BenchResult {
+  std::string transport;
+  std::string op;
+  uint64 bytes;       // message size
+  int iters;          // number of runs
+  double usec;        // average time of one run
+  double mbps;        // MB/s of message size / usec
+};
+
+// Transports to benchmark, and their address
+struct Transport {
+  const char* name;
+  const char* addr;
+};
+
+static const Transport kTransports[] = {
+  {"socket", "127.0.0.1:12370"},
+  {"epoll", "127.0.0.1:12371"},
+  {"shm", "communicator_bench"},
+};
+
+// Number of runs of the message size
+static int NumIters(uint64 bytes) {
+  uint64 iters = kBytesPerTest / std::max(bytes, (uint64)1);
+  return std::max(kMinIters, std::min(kMaxIters, (int)iters));
+}
+
+// Current time (usec)
+static double Now() {
+  return std::chrono::duration<double, std::micro>(
+    std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// Wait for all nodes
+static void Barrier(Communicator* comm) {
+  int32 flag = 1;
+  comm->Allreduce(&flag, 1, kAllreduceTree);
+}
+
+// Ping-pong between rank 0 and rank 1. The latency is
+// half of the round trip time.
+static void BenchPingPong(Communicator* comm, uint64 bytes,
+                          std::vector<BenchResult>* results) {
+  int iters = NumIters(bytes);
+  std::vector<char> buf(bytes, 1);
+  Barrier(comm);
+  double start = Now();
+  for (int i = 0; i < iters; ++i) {
+    if (comm->Rank() == 0) {
+      comm->Send(1, buf.data(), bytes);
+      comm->Recv(1, buf.data(), bytes);
+    } else if (comm->Rank() == 1) {
+      comm->Recv(0, buf.data(), bytes);
+      comm->Send(0, buf.data(), bytes);
+    }
+  }
+  double usec = (Now() - start) / iters / 2;
+  Barrier(comm);
+  if (comm->Rank() == 0) {
+    results->push_back(BenchResult{"", "p2p", bytes, iters, usec,
+                                   bytes / usec});
+  }
+}
+
+// Run a collective of real_t data. The time includes a
+// barrier, which is small compared to large messages.
+static void BenchCollective(Communicator* comm, const std::string& op,
+                            uint64 bytes,
+                            std::vector<BenchResult>* results) {
+  int iters = NumIters(bytes);
+  std::vector<real_t> data(bytes / sizeof(real_t), 1.0);
+  Barrier(comm);
+  double start = Now();
+  for (int i = 0; i < iters; ++i) {
+    if (op == "allreduce_ring") {
+      comm->Allreduce(data.data(), data.size(), kAllreduceRing);
+    } else if (op == "allreduce_tree") {
+      comm->Allreduce(data.data(), data.size(), kAllreduceTree);
+    } else {
+      comm->Broadcast(data.data(), data.size(), 0);
+    }
+  }
+  // Wait for the slowest node, e.g., the leaves of Broadcast
+  Barrier(comm);
+  double usec = (Now() - start) / iters;
+  if (comm->Rank() == 0) {
+    results->push_back(BenchResult{"", op, bytes, iters, usec,
+                                   bytes / usec});
+  }
+}
+
+// Run all benchmarks on one node
+static void BenchNode(Communicator* comm,
+                      std::vector<BenchResult>* results) {
+  for (uint64 bytes = 8; bytes <= (8 << 20); bytes *= 8) {
+    BenchPingPong(comm, bytes, results);
+  }
+  const char* ops[] = {"allreduce_ring", "allreduce_tree", "broadcast"};
+  for (int k = 0; k < 3; ++k) {
+    for (uint64 bytes = 1024; bytes <= (16 << 20); bytes *= 16) {
+      BenchCollective(comm, ops[k], bytes, results);
+    }
+  }
+}
+
+// Run the nodes of transport in threads. Return the
+// results of rank 0.
+static void BenchTransport(const Transport& transport, int num_workers,
+                           std::vector<BenchResult>* results) {
+  std::vector<BenchResult> local;
+  std::vector<std::thread> threads;
+  for (int rank = 0; rank <= num_workers; ++rank) {
+    threads.push_back(std::thread([rank, num_workers, &transport,
+                                   &local]() {
+      scoped_ptr<Communicator> comm(CREATE_COMMUNICATOR(transport.name));
+      comm->Initialize(rank, num_workers, transport.addr);
+      std::vector<BenchResult> rank_results;
+      BenchNode(comm.get(), &rank_results);
+      if (rank == 0) {
+        local.swap(rank_results);
+      }
+    }));
+  }
+  for (size_t i = 0; i < threads.size(); ++i) {
+    threads[i].join();
+  }
+  for (size_t i = 0; i < local.size(); ++i) {
+    local[i].transport = transport.name;
+    results->push_back(local[i]);
+  }
+}
+
+// Print the results as a table
+static void PrintTable(const std::vector<BenchResult>& results) {
+  printf("%-10s %-16s %12s %8s %14s %12s\n", "transport", "op",
+         "bytes", "iters", "usec", "MB/s");
+  for (size_t i = 0; i < results.size(); ++i) {
+    const BenchResult& r = results[i];
+    printf("%-10s %-16s %12llu %8d %14.2f %12.2f\n",
+           r.transport.c_str(), r.op.c_str(),
+           (unsigned long long)r.bytes, r.iters, r.usec, r.mbps);
+  }
+}
+
+// Write the results as a JSON array
+static void WriteJSON(const std::vector<BenchResult>& results,
+                      int num_workers, const std::string& filename) {
+  std::string json = "[\n";
+  for (size_t i = 0; i < results.size(); ++i) {
+    const BenchResult& r = results[i];
+    json += StringPrintf("  {\"transport\": \"%s\", \"op\": \"%s\", "
+                         "\"ranks\": %d, \"bytes\": %llu, "
+                         "\"iters\": %d, \"usec\": %.3f, "
+                         "\"mbps\": %.3f}%s\n",
+                         r.transport.c_str(), r.op.c_str(),
+                         num_workers + 1, (unsigned long long)r.bytes,
+                         r.iters, r.usec, r.mbps,
+                         i + 1 < results.size() ? "," : "");
+  }
+  json += "]\n";
+  FILE* file = fopen(filename.c_str(), "w");
+  if (file == nullptr) {
+    LOG(FATAL) << "Cannot open file: " << filename;
+  }
+  fwrite(json.data(), 1, json.size(), file);
+  fclose(file);
+}
+
+}  // namespace xforest
+
+int main(int argc, char* argv[]) {
+  int num_workers = argc > 1 ? atoi(argv[1]) : 3;
+  std::string json_file = argc > 2 ? argv[2] : "communicator_bench.json";
+  CHECK_GT(num_workers, 0);
+  std::vector<xforest::BenchResult> results;
+  for (const xforest::Transport& transport : xforest::kTransports) {
+    xforest::BenchTransport(transport, num_workers, &results);
+  }
+  xforest::PrintTable(results);
+  xforest::WriteJSON(results, num_workers, json_file);
+  printf("Results are written to %s\n", json_file.c_str());
+  return 0;
+}
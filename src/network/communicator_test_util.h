@@ -0,0 +1,152 @@
+//------------------------------------------------------------------------------
+// Copyright (c) 2018 by contributors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//------------------------------------------------------------------------------
+
+/*
+This file provides the checks shared by the tests of all
+Communicator transports.
+*/
+
+#ifndef XFOREST_NETWORK_COMMUNICATOR_TEST_UTIL_H_
+#define XFOREST_NETWORK_COMMUNICATOR_TEST_UTIL_H_
+
+#include <unistd.h>
+#include <algorithm>
+#include <functional>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "src/base/common.h"
+#include "src/base/scoped_ptr.h"
+#include "src/network/communicator.h"
+#include "gtest/gtest.h"
+
+namespace xforest {
+
+typedef std::function<void(Communicator* comm)> CommFunc;
+
+// Run func(comm) on all of the nodes, each in a thread. comm
+// is created by the registry name, and setup(comm) is called
+// before Initialize, e.g., to set the options of the transport.
+inline void RunAll(const std::string& name, int num_workers,
+                   const std::string& addr, CommFunc func,
+                   CommFunc setup = nullptr) {
+  std::vector<std::thread> threads;
+  for (int rank = 0; rank <= num_workers; ++rank) {
+    threads.push_back(std::thread([=]() {
+      if (rank > 0) {
+        sleep(1);  // wait master node
+      }
+      scoped_ptr<Communicator> comm(CREATE_COMMUNICATOR(name));
+      ASSERT_TRUE(comm.get() != nullptr);
+      if (setup) {
+        setup(comm.get());
+      }
+      comm->Initialize(rank, num_workers, addr);
+      EXPECT_EQ(comm->Rank(), rank);
+      EXPECT_EQ(comm->Size(), num_workers + 1);
+      func(comm.get());
+    }));
+  }
+  for (size_t i = 0; i < threads.size(); ++i) {
+    threads[i].join();
+  }
+}
+
+// Check all of the collectives, which every transport must pass
+inline void TestCollective(Communicator* comm) {
+  int rank = comm->Rank();
+  int size = comm->Size();
+  int rank_sum = size * (size - 1) / 2;
+  // Allreduce larger than the buffer of a transport, and
+  // a length not divisible by the world size
+  AllreduceAlgo algos[] = {kAllreduceRing, kAllreduceTree, kAllreduceAuto};
+  for (int a = 0; a < 3; ++a) {
+    std::vector<int> data(300001);
+    for (size_t i = 0; i < data.size(); ++i) {
+      data[i] = i + rank;
+    }
+    comm->Allreduce(data.data(), data.size(), algos[a]);
+    for (size_t i = 0; i < data.size(); ++i) {
+      ASSERT_EQ(data[i], i * size + rank_sum);
+    }
+  }
+  // ReduceScatter of even blocks
+  std::vector<size_t> starts;
+  for (int r = 0; r <= size; ++r) {
+    starts.push_back(r * 3);
+  }
+  std::vector<int> block(3 * size, rank);
+  comm->ReduceScatter(block.data(), starts);
+  for (size_t i = starts[rank]; i < starts[rank+1]; ++i) {
+    EXPECT_EQ(block[i], rank_sum);
+  }
+  // Uneven blocks, where block 2 is empty
+  starts.assign(1, 0);
+  for (int r = 0; r < size; ++r) {
+    starts.push_back(starts.back() + (r == 2 ? 0 : r + 1));
+  }
+  std::vector<uint32> uneven(starts.back(), rank + 1);
+  comm->ReduceScatter(uneven.data(), starts);
+  for (size_t i = starts[rank]; i < starts[rank+1]; ++i) {
+    EXPECT_EQ(uneven[i], rank_sum + size);
+  }
+  // Ring exchange
+  int next = (rank + 1) % size;
+  int prev = (rank + size - 1) % size;
+  std::vector<int> out(300000, rank);
+  std::vector<int> in(out.size(), -1);
+  comm->SendRecv(next, reinterpret_cast<const char*>(out.data()),
+                 out.size() * sizeof(int),
+                 prev, reinterpret_cast<char*>(in.data()),
+                 in.size() * sizeof(int));
+  EXPECT_EQ(in.front(), prev);
+  EXPECT_EQ(in.back(), prev);
+  // Broadcast from each rank
+  for (int root = 0; root < size; ++root) {
+    std::vector<int> buf(100, -1);
+    if (rank == root) {
+      for (size_t i = 0; i < buf.size(); ++i) {
+        buf[i] = i * root;
+      }
+    }
+    comm->Broadcast(buf.data(), buf.size(), root);
+    for (size_t i = 0; i < buf.size(); ++i) {
+      EXPECT_EQ(buf[i], i * root);
+    }
+  }
+  // AllGather and Gather
+  std::vector<int> local = {rank, rank * 10};
+  std::vector<int> all(2 * size, -1);
+  comm->AllGather(local.data(), local.size(), all.data());
+  for (int r = 0; r < size; ++r) {
+    EXPECT_EQ(all[2 * r], r);
+    EXPECT_EQ(all[2 * r + 1], r * 10);
+  }
+  int gather_root = size - 1;
+  std::fill(all.begin(), all.end(), -1);
+  comm->Gather(local.data(), local.size(), all.data(), gather_root);
+  if (rank == gather_root) {
+    for (int r = 0; r < size; ++r) {
+      EXPECT_EQ(all[2 * r], r);
+      EXPECT_EQ(all[2 * r + 1], r * 10);
+    }
+  }
+}
+
+}  // namespace xforest
+
+#endif  // XFOREST_NETWORK_COMMUNICATOR_TEST_UTIL_H_
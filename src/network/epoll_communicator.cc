@@ -0,0 +1,250 @@
+//------------------------------------------------------------------------------
+// Copyright (c) 2018 by contributors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//------------------------------------------------------------------------------
+
+/*
+This file is the implementation of EpollCommunicator class.
+*/
+
+#include "src/network/epoll_communicator.h"
+
+#include <errno.h>
+#include <string.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <unistd.h>
+
+#include "src/base/profiler.h"
+
+namespace xforest {
+
+// Epoll data of the eventfd, which is not a rank
+static const uint32 kWakeUp = 0xffffffff;
+
+// Maximal number of events returned by epoll_wait()
+static const int kMaxEvents = 64;
+
+// dctor
+EpollCommunicator::~EpollCommunicator() {
+  if (loop_.joinable()) {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      stop_ = true;
+    }
+    uint64 one = 1;
+    CHECK_EQ(write(event_fd_, &one, sizeof(one)), sizeof(one));
+    loop_.join();
+  }
+  if (event_fd_ >= 0) {
+    close(event_fd_);
+  }
+  if (epoll_fd_ >= 0) {
+    close(epoll_fd_);
+  }
+}
+
+// Initialize Communicator
+void EpollCommunicator::Initialize(int rank, /* master is rank_0 */
+                                   int num_workers, 
+                                   const std::string& master_addr) {
+  SocketCommunicator::Initialize(rank, num_workers, master_addr);
+  for (size_t r = 0; r < sockets_.size(); ++r) {
+    if (sockets_[r] != nullptr) {
+      CHECK(sockets_[r]->SetBlocking(false));
+    }
+  }
+  epoll_fd_ = epoll_create1(0);
+  if (epoll_fd_ < 0) {
+    LOG(FATAL) << "Failed to create epoll: " << strerror(errno);
+  }
+  event_fd_ = eventfd(0, EFD_NONBLOCK);
+  if (event_fd_ < 0) {
+    LOG(FATAL) << "Failed to create eventfd: " << strerror(errno);
+  }
+  struct epoll_event ev;
+  ev.events = EPOLLIN;
+  ev.data.u32 = kWakeUp;
+  CHECK_EQ(0, epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, event_fd_, &ev));
+  send_queue_.resize(Size());
+  recv_queue_.resize(Size());
+  events_.assign(Size(), 0);
+  loop_ = std::thread(&EpollCommunicator::Loop, this);
+}
+
+// Recv data
+void EpollCommunicator::Recv(int rank, char* data, int len) {
+  TRACE_ZONE("recv");
+  Wait(IRecv(rank, data, len));
+}
+
+// Send data
+void EpollCommunicator::Send(int rank, const char* data, int len) {
+  TRACE_ZONE("send");
+  Wait(ISend(rank, data, len));
+}
+
+// Send and receive at the same time
+void EpollCommunicator::SendRecv(int send_rank, 
+                                 const char* send_data, 
+                                 int send_len,
+                                 int recv_rank, 
+                                 char* recv_data, 
+                                 int recv_len) {
+  TRACE_ZONE("sendrecv");
+  int send_handle = ISend(send_rank, send_data, send_len);
+  int recv_handle = IRecv(recv_rank, recv_data, recv_len);
+  Wait(send_handle);
+  Wait(recv_handle);
+}
+
+// Asynchronous Send
+int EpollCommunicator::ISend(int rank, const char* data, int len) {
+  return Post(rank, const_cast<char*>(data), len, true);
+}
+
+// Asynchronous Recv
+int EpollCommunicator::IRecv(int rank, char* data, int len) {
+  return Post(rank, data, len, false);
+}
+
+// Wait the request of handle to finish
+void EpollCommunicator::Wait(int handle) {
+  std::unique_lock<std::mutex> lock(mutex_);
+  std::map<int, Request>::iterator it = requests_.find(handle);
+  CHECK(it != requests_.end());
+  Request& req = it->second;
+  cond_.wait(lock, [&req]() { return req.done; });
+  requests_.erase(it);
+}
+
+// Add a request to the queue of rank, and return handle
+int EpollCommunicator::Post(int rank, char* data, int len, bool is_send) {
+  CHECK_GE(rank, 0);
+  CHECK_LT(rank, Size());
+  CHECK_NE(rank, rank_);
+  CHECK_GE(len, 0);
+  std::lock_guard<std::mutex> lock(mutex_);
+  int handle = next_handle_++;
+  Request& req = requests_[handle];
+  req.data = data;
+  req.len = len;
+  req.done_bytes = 0;
+  req.done = len == 0;
+  if (!req.done) {
+    std::deque<int>& queue = is_send ? send_queue_[rank] 
+                                     : recv_queue_[rank];
+    queue.push_back(handle);
+    // Try to finish it in place before waking up the loop
+    if (queue.size() == 1) {
+      Progress(rank, is_send);
+    }
+    UpdateEvents(rank);
+  }
+  return handle;
+}
+
+// Transfer data for the requests of rank until EAGAIN
+void EpollCommunicator::Progress(int rank, bool is_send) {
+  std::deque<int>& queue = is_send ? send_queue_[rank] : recv_queue_[rank];
+  TCPSocket* socket = sockets_[rank];
+  while (!queue.empty()) {
+    Request& req = requests_[queue.front()];
+    char* ptr = req.data + req.done_bytes;
+    int max_len = req.len - req.done_bytes;
+    int tmp = is_send ? socket->Send(ptr, max_len, MSG_NOSIGNAL)
+                      : socket->Receive(ptr, max_len);
+    if (tmp < 0) {
+      if (errno == EAGAIN || errno == EWOULDBLOCK) {
+        return;
+      }
+      if (errno == EINTR) {
+        continue;
+      }
+      LOG(FATAL) << "Failed to " << (is_send ? "send" : "receive")
+                 << " data: " << strerror(errno);
+    }
+    if (tmp == 0 && !is_send) {
+      LOG(FATAL) << "Failed to receive data: connection closed";
+    }
+    req.done_bytes += tmp;
+    if (req.done_bytes == req.len) {
+      req.done = true;
+      queue.pop_front();
+      cond_.notify_all();
+    }
+  }
+}
+
+// Watch the socket of rank for the directions having requests
+void EpollCommunicator::UpdateEvents(int rank) {
+  uint32 events = 0;
+  if (!send_queue_[rank].empty()) {
+    events |= EPOLLOUT;
+  }
+  if (!recv_queue_[rank].empty()) {
+    events |= EPOLLIN;
+  }
+  if (events == events_[rank]) {
+    return;
+  }
+  // An idle socket is removed, so that the closing of
+  // peer does not wake up the loop
+  int op = EPOLL_CTL_MOD;
+  if (events_[rank] == 0) {
+    op = EPOLL_CTL_ADD;
+  } else if (events == 0) {
+    op = EPOLL_CTL_DEL;
+  }
+  struct epoll_event ev;
+  ev.events = events;
+  ev.data.u32 = rank;
+  if (epoll_ctl(epoll_fd_, op, sockets_[rank]->Socket(), &ev) != 0) {
+    LOG(FATAL) << "Failed to update epoll: " << strerror(errno);
+  }
+  events_[rank] = events;
+}
+
+// Main loop of the epoll thread
+void EpollCommunicator::Loop() {
+  std::vector<struct epoll_event> events(kMaxEvents);
+  for (;;) {
+    int num = epoll_wait(epoll_fd_, events.data(), kMaxEvents, -1);
+    if (num < 0) {
+      CHECK_EQ(errno, EINTR);
+      continue;
+    }
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (stop_) {
+      return;
+    }
+    for (int i = 0; i < num; ++i) {
+      uint32 rank = events[i].data.u32;
+      if (rank == kWakeUp) {
+        continue;
+      }
+      // Errors are reported by send() or recv()
+      uint32 ev = events[i].events;
+      if (ev & (EPOLLIN | EPOLLERR | EPOLLHUP)) {
+        Progress(rank, false);
+      }
+      if (ev & (EPOLLOUT | EPOLLERR | EPOLLHUP)) {
+        Progress(rank, true);
+      }
+      UpdateEvents(rank);
+    }
+  }
+}
+
+}  // namespace xforest
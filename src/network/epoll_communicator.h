@@ -0,0 +1,117 @@
+//------------------------------------------------------------------------------
+// Copyright (c) 2018 by contributors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//------------------------------------------------------------------------------
+
+/*
+This file defines the EpollCommunicator class.
+*/
+
+#ifndef XFOREST_NETWORK_EPOLL_COMMUNICATOR_H_
+#define XFOREST_NETWORK_EPOLL_COMMUNICATOR_H_
+
+#include <condition_variable>
+#include <deque>
+#include <map>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "src/base/common.h"
+#include "src/network/socket_communicator.h"
+
+namespace xforest {
+
+//------------------------------------------------------------------------------
+// EpollCommunicator is an event-driven SocketCommunicator. After
+// the connections are set up, all sockets are made non-blocking
+// and served by an epoll loop thread, so that:
+//
+//   int h1 = comm.IRecv(1, buf1, len);
+//   int h2 = comm.IRecv(2, buf2, len);
+//   ...   // compute while receiving from both nodes
+//   comm.Wait(h1);
+//   comm.Wait(h2);
+//
+// Each rank has a FIFO queue of send and receive requests, and
+// a socket is only watched for the directions having requests.
+// Send() and Recv() are ISend() and IRecv() followed by Wait().
+//------------------------------------------------------------------------------
+class EpollCommunicator : public SocketCommunicator {
+ public:
+  EpollCommunicator() {}
+  ~EpollCommunicator();
+
+  // Initialize Communicator
+  virtual void Initialize(int rank, /* master is rank_0 */
+                          int num_workers, 
+                          const std::string& master_addr);
+
+  // Recv data
+  virtual void Recv(int rank, char* data, int len);
+
+  // Send data
+  virtual void Send(int rank, const char* data, int len);
+
+  // Send and receive at the same time
+  virtual void SendRecv(int send_rank, const char* send_data, int send_len,
+                        int recv_rank, char* recv_data, int recv_len);
+
+  // Asynchronous Send and Recv
+  virtual int ISend(int rank, const char* data, int len);
+  virtual int IRecv(int rank, char* data, int len);
+
+  // Wait the request of handle to finish
+  virtual void Wait(int handle);
+
+ private:
+  // Send or receive request
+  struct Request {
+    char* data;        // buffer
+    int len;           // buffer size
+    int done_bytes;    // transferred bytes
+    bool done;         // request is finished
+  };
+
+  // Add a request to the queue of rank, and return handle
+  int Post(int rank, char* data, int len, bool is_send);
+
+  // Transfer data for the requests of rank until EAGAIN
+  void Progress(int rank, bool is_send);
+
+  // Watch the socket of rank for the directions having requests
+  void UpdateEvents(int rank);
+
+  // Main loop of the epoll thread
+  void Loop();
+
+  int epoll_fd_ = -1;   // epoll instance
+  int event_fd_ = -1;   // wake up the loop to stop
+  bool stop_ = false;   // stop the loop
+  std::thread loop_;    // epoll thread
+
+  std::mutex mutex_;                // protect the fields below
+  std::condition_variable cond_;    // a request is finished
+  std::map<int, Request> requests_; // unfinished or unwaited requests
+  int next_handle_ = 1;             // handle of the next request
+  std::vector<std::deque<int>> send_queue_;  // send handles of each rank
+  std::vector<std::deque<int>> recv_queue_;  // recv handles of each rank
+  std::vector<uint32> events_;               // watched events of each rank
+
+  DISALLOW_COPY_AND_ASSIGN(EpollCommunicator);
+};
+
+}  // namespace xforest
+
+#endif  // XFOREST_NETWORK_EPOLL_COMMUNICATOR_H_
@@ -0,0 +1,88 @@
+//------------------------------------------------------------------------------
+// Copyright (c) 2018 by contributors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//------------------------------------------------------------------------------
+
+/*
+This file tests the EpollCommunicator class.
+*/
+
+#include "src/network/epoll_communicator.h"
+
+#include <vector>
+
+#include "src/base/common.h"
+#include "src/network/communicator_test_util.h"
+#include "gtest/gtest.h"
+
+namespace xforest {
+
+const int kNumWorker = 3;
+const int kWorldSize = kNumWorker + 1;
+
+static void TestAsync(Communicator* comm) {
+  int rank = comm->Rank();
+  // Large messages to all nodes at the same time, which
+  // fill the socket buffers
+  const int kLen = 1 << 20;
+  std::vector<std::vector<int>> send(kWorldSize);
+  std::vector<std::vector<int>> recv(kWorldSize);
+  std::vector<int> handles;
+  for (int r = 0; r < kWorldSize; ++r) {
+    if (r == rank) {
+      continue;
+    }
+    send[r].assign(kLen, rank * 100 + r);
+    recv[r].assign(kLen, -1);
+    handles.push_back(comm->IRecv(r, 
+      reinterpret_cast<char*>(recv[r].data()), kLen * sizeof(int)));
+    handles.push_back(comm->ISend(r, 
+      reinterpret_cast<char*>(send[r].data()), kLen * sizeof(int)));
+  }
+  for (size_t i = 0; i < handles.size(); ++i) {
+    comm->Wait(handles[i]);
+  }
+  for (int r = 0; r < kWorldSize; ++r) {
+    if (r == rank) {
+      continue;
+    }
+    EXPECT_EQ(recv[r][0], r * 100 + rank);
+    EXPECT_EQ(recv[r][kLen - 1], r * 100 + rank);
+  }
+  // Requests to the same node are finished in order
+  int peer = (rank + 1) % kWorldSize;
+  int from = (rank + kWorldSize - 1) % kWorldSize;
+  int a = rank;
+  int b = rank * 10;
+  int h1 = comm->ISend(peer, reinterpret_cast<char*>(&a), sizeof(a));
+  int h2 = comm->ISend(peer, reinterpret_cast<char*>(&b), sizeof(b));
+  int x = -1;
+  int y = -1;
+  comm->Recv(from, reinterpret_cast<char*>(&x), sizeof(x));
+  comm->Recv(from, reinterpret_cast<char*>(&y), sizeof(y));
+  comm->Wait(h2);
+  comm->Wait(h1);
+  EXPECT_EQ(x, from);
+  EXPECT_EQ(y, from * 10);
+}
+
+TEST(EpollCommunicator, Async) {
+  RunAll("epoll", kNumWorker, "127.0.0.1:12344", TestAsync);
+}
+
+TEST(EpollCommunicator, Collective) {
+  RunAll("epoll", kNumWorker, "127.0.0.1:12345", TestCollective);
+}
+
+}  // namespace xforest
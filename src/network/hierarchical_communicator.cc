@@ -0,0 +1,178 @@
+//------------------------------------------------------------------------------
+// Copyright (c) 2018 by contributors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//------------------------------------------------------------------------------
+
+/*
+This file is the implementation of HierarchicalCommunicator class.
+*/
+
+#include "src/network/hierarchical_communicator.h"
+
+#include <algorithm>
+
+#include "src/base/stringprintf.h"
+#include "src/network/socket_communicator.h"
+
+namespace xforest {
+
+//------------------------------------------------------------------------------
+// GroupCommunicator class
+//------------------------------------------------------------------------------
+
+// ctor
+GroupCommunicator::GroupCommunicator(Communicator* parent,
+                                     const std::vector<int>& ranks)
+  : parent_(parent), ranks_(ranks) {
+  CHECK_NOTNULL(parent);
+  CHECK_GT(ranks.size(), 1);
+  std::vector<int>::const_iterator it = 
+    std::find(ranks.begin(), ranks.end(), parent->Rank());
+  CHECK(it != ranks.end());
+  rank_ = it - ranks.begin();
+  num_workers_ = ranks.size() - 1;
+}
+
+// The group is initialized by the ctor
+void GroupCommunicator::Initialize(int rank, int num_workers,
+                                   const std::string& master_addr) {
+  LOG(FATAL) << "GroupCommunicator is initialized by the ctor";
+}
+
+//------------------------------------------------------------------------------
+// HierarchicalCommunicator class
+//------------------------------------------------------------------------------
+
+// Initialize Communicator
+void HierarchicalCommunicator::Initialize(int rank, /* master is rank_0 */
+                                          int num_workers, 
+                                          const std::string& master_addr) {
+  CHECK_GE(rank, 0);
+  CHECK_GT(num_workers, 0);
+  CHECK_LE(rank, num_workers);
+  rank_ = rank;
+  num_workers_ = num_workers;
+  global_comm_.reset(new SocketCommunicator());
+  global_comm_->Initialize(rank, num_workers, master_addr);
+  int host = rank_ / local_size_;
+  int num_hosts = (Size() + local_size_ - 1) / local_size_;
+  int host_size = std::min(local_size_, Size() - host * local_size_);
+  if (host_size > 1) {
+    local_comm_.reset(CREATE_COMMUNICATOR(local_type_));
+    if (local_comm_.get() == nullptr) {
+      LOG(FATAL) << "Unknown communicator: " << local_type_;
+    }
+    std::string local_addr = StringPrintf("%s_host_%d", 
+                                          master_addr.c_str(), host);
+    local_comm_->Initialize(rank_ % local_size_, host_size - 1, 
+                            local_addr);
+    if (num_hosts > 1) {
+      sender_.reset(new ThreadPool(1));
+    }
+  }
+  if (num_hosts > 1 && rank_ % local_size_ == 0) {
+    // Leaders talk by the global socket mesh
+    std::vector<int> leaders;
+    for (int h = 0; h < num_hosts; ++h) {
+      leaders.push_back(h * local_size_);
+    }
+    leader_comm_.reset(new GroupCommunicator(global_comm_.get(), leaders));
+  }
+  hierarchical_ = true;
+  local_ = local_comm_.get();
+  leader_ = leader_comm_.get();
+  LOG(INFO) << "Rank " << rank_ << " is on host " << host 
+            << " of " << num_hosts << " hosts";
+}
+
+// Recv data
+void HierarchicalCommunicator::Recv(int rank, char* data, int len) {
+  int local_rank = LocalRank(rank);
+  if (local_rank >= 0) {
+    local_comm_->Recv(local_rank, data, len);
+  } else {
+    global_comm_->Recv(rank, data, len);
+  }
+}
+
+// Send data
+void HierarchicalCommunicator::Send(int rank, const char* data, int len) {
+  int local_rank = LocalRank(rank);
+  if (local_rank >= 0) {
+    local_comm_->Send(local_rank, data, len);
+  } else {
+    global_comm_->Send(rank, data, len);
+  }
+}
+
+// Send and receive at the same time
+void HierarchicalCommunicator::SendRecv(int send_rank, 
+                                        const char* send_data, 
+                                        int send_len,
+                                        int recv_rank, 
+                                        char* recv_data, 
+                                        int recv_len) {
+  int local_send = LocalRank(send_rank);
+  int local_recv = LocalRank(recv_rank);
+  if (local_send >= 0 && local_recv >= 0) {
+    local_comm_->SendRecv(local_send, send_data, send_len,
+                          local_recv, recv_data, recv_len);
+  } else if (local_send < 0 && local_recv < 0) {
+    global_comm_->SendRecv(send_rank, send_data, send_len,
+                           recv_rank, recv_data, recv_len);
+  } else {
+    // The two sides are on different communicators, so
+    // the send runs on the sender thread
+    std::future<void> sent = sender_->enqueue([&]() {
+      Send(send_rank, send_data, send_len);
+    });
+    Recv(recv_rank, recv_data, recv_len);
+    sent.get();
+  }
+}
+
+// The lowest bit of handle tells the communicator of request
+int HierarchicalCommunicator::ISend(int rank, const char* data, int len) {
+  int local_rank = LocalRank(rank);
+  if (local_rank >= 0) {
+    return local_comm_->ISend(local_rank, data, len) * 2 + 1;
+  }
+  return global_comm_->ISend(rank, data, len) * 2;
+}
+
+int HierarchicalCommunicator::IRecv(int rank, char* data, int len) {
+  int local_rank = LocalRank(rank);
+  if (local_rank >= 0) {
+    return local_comm_->IRecv(local_rank, data, len) * 2 + 1;
+  }
+  return global_comm_->IRecv(rank, data, len) * 2;
+}
+
+// Wait the request of handle to finish
+void HierarchicalCommunicator::Wait(int handle) {
+  if (handle & 1) {
+    local_comm_->Wait(handle / 2);
+  } else {
+    global_comm_->Wait(handle / 2);
+  }
+}
+
+void HierarchicalCommunicator::WaitSends() {
+  global_comm_->WaitSends();
+  if (local_comm_ != nullptr) {
+    local_comm_->WaitSends();
+  }
+}
+
+}  // namespace xforest
@@ -0,0 +1,161 @@
+//------------------------------------------------------------------------------
+// Copyright (c) 2018 by contributors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//------------------------------------------------------------------------------
+
+/*
+This file defines the HierarchicalCommunicator class.
+*/
+
+#ifndef XFOREST_NETWORK_HIERARCHICAL_COMMUNICATOR_H_
+#define XFOREST_NETWORK_HIERARCHICAL_COMMUNICATOR_H_
+
+#include <string>
+#include <vector>
+
+#include "src/base/common.h"
+#include "src/base/scoped_ptr.h"
+#include "src/base/thread_pool.h"
+#include "src/network/communicator.h"
+
+namespace xforest {
+
+//------------------------------------------------------------------------------
+// GroupCommunicator is a view of a subset of the ranks of its 
+// parent communicator, which is used by the collectives of
+// the group. ranks[i] is the parent rank of group rank i.
+//------------------------------------------------------------------------------
+class GroupCommunicator : public Communicator {
+ public:
+  GroupCommunicator(Communicator* parent, const std::vector<int>& ranks);
+  ~GroupCommunicator() {}
+
+  // The group is initialized by the ctor
+  virtual void Initialize(int rank, int num_workers,
+                          const std::string& master_addr);
+
+  // Recv data
+  virtual void Recv(int rank, char* data, int len) {
+    parent_->Recv(ranks_[rank], data, len);
+  }
+
+  // Send data
+  virtual void Send(int rank, const char* data, int len) {
+    parent_->Send(ranks_[rank], data, len);
+  }
+
+  // Send and receive at the same time
+  virtual void SendRecv(int send_rank, const char* send_data, int send_len,
+                        int recv_rank, char* recv_data, int recv_len) {
+    parent_->SendRecv(ranks_[send_rank], send_data, send_len,
+                      ranks_[recv_rank], recv_data, recv_len);
+  }
+
+  // Wait the sends of parent
+  virtual void WaitSends() {
+    parent_->WaitSends();
+  }
+
+ private:
+  Communicator* parent_;
+  std::vector<int> ranks_;
+
+  DISALLOW_COPY_AND_ASSIGN(GroupCommunicator);
+};
+
+//------------------------------------------------------------------------------
+// HierarchicalCommunicator makes the collectives topology-aware. 
+// The ranks of a host are consecutive, e.g., ranks 0 ~ 7 are on
+// the first host if there are 8 ranks per host:
+//
+//   HierarchicalCommunicator comm;
+//   comm.SetLocalSize(8);
+//   comm.Initialize(rank, num_workers, "10.0.0.1:9000");
+//
+// The ranks of a host talk by the local communicator (shared 
+// memory by default), and the ranks are also connected by a 
+// socket mesh. Allreduce reduces to the leader (local rank 0) of 
+// each host, allreduces across hosts among the leaders only, and
+// broadcasts back within each host, so the cross-host traffic is
+// divided by the ranks per host. Broadcast, AllGather and 
+// ReduceScatter work in the same way, and the point-to-point 
+// messages take the local communicator within a host.
+//------------------------------------------------------------------------------
+class HierarchicalCommunicator : public Communicator {
+ public:
+  HierarchicalCommunicator() {}
+  ~HierarchicalCommunicator() {}
+
+  // Number of ranks per host, before Initialize()
+  void SetLocalSize(int size) {
+    CHECK_GT(size, 0);
+    local_size_ = size;
+  }
+
+  // Registered name of the communicator within a host,
+  // before Initialize(). It is "shm" by default.
+  void SetLocalType(const std::string& type) {
+    local_type_ = type;
+  }
+
+  // Initialize Communicator. The global socket mesh listens 
+  // on master_addr, and master_addr also names the local
+  // communicators of hosts.
+  virtual void Initialize(int rank, /* master is rank_0 */
+                          int num_workers, 
+                          const std::string& master_addr);
+
+  // Recv data
+  virtual void Recv(int rank, char* data, int len);
+
+  // Send data
+  virtual void Send(int rank, const char* data, int len);
+
+  // Send and receive at the same time
+  virtual void SendRecv(int send_rank, const char* send_data, int send_len,
+                        int recv_rank, char* recv_data, int recv_len);
+
+  // Asynchronous Send and Recv
+  virtual int ISend(int rank, const char* data, int len);
+  virtual int IRecv(int rank, char* data, int len);
+
+  // Wait the request of handle to finish
+  virtual void Wait(int handle);
+
+  // Wait the sends of the local and global communicators
+  virtual void WaitSends();
+
+ private:
+  // Local rank of global rank, -1 if it is on another host
+  int LocalRank(int rank) const {
+    if (local_comm_.get() == nullptr ||
+        rank / local_size_ != rank_ / local_size_) {
+      return -1;
+    }
+    return rank % local_size_;
+  }
+
+  std::string local_type_ = "shm";          // type of local_comm_
+  scoped_ptr<Communicator> global_comm_;    // socket mesh of all ranks
+  scoped_ptr<Communicator> local_comm_;     // ranks of the same host
+  scoped_ptr<Communicator> leader_comm_;    // leaders of hosts
+  scoped_ptr<ThreadPool> sender_;           // sends of SendRecv() between
+                                            // local and global ranks
+
+  DISALLOW_COPY_AND_ASSIGN(HierarchicalCommunicator);
+};
+
+}  // namespace xforest
+
+#endif  // XFOREST_NETWORK_HIERARCHICAL_COMMUNICATOR_H_
@@ -0,0 +1,54 @@
+//------------------------------------------------------------------------------
+// Copyright (c) 2018 by contributors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//------------------------------------------------------------------------------
+
+/*
+This file tests the HierarchicalCommunicator class.
+*/
+
+#include "src/network/hierarchical_communicator.h"
+
+#include <string>
+
+#include "src/base/common.h"
+#include "src/network/communicator_test_util.h"
+#include "gtest/gtest.h"
+
+namespace xforest {
+
+const int kNumWorker = 6;
+
+// Run TestCollective on 7 ranks of local_size ranks per host.
+// The last host has less ranks if local_size does not divide 7.
+static void RunHosts(const std::string& addr, int local_size) {
+  RunAll("hierarchical", kNumWorker, addr, TestCollective,
+         [local_size](Communicator* comm) {
+    static_cast<HierarchicalCommunicator*>(comm)->SetLocalSize(local_size);
+  });
+}
+
+TEST(HierarchicalCommunicator, TwoPerHost) {
+  RunHosts("127.0.0.1:12347", 2);
+}
+
+TEST(HierarchicalCommunicator, FourPerHost) {
+  RunHosts("127.0.0.1:12348", 4);
+}
+
+TEST(HierarchicalCommunicator, SingleHost) {
+  RunHosts("127.0.0.1:12349", 8);
+}
+
+}  // namespace xforest
@@ -0,0 +1,243 @@
+//------------------------------------------------------------------------------
+// Copyright (c) 2018 by contributors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//------------------------------------------------------------------------------
+
+/*
+This file is the implementation of the histogram encoding.
+*/
+
+#include "src/network/histo_codec.h"
+
+#include <string.h>
+
+namespace xforest {
+
+// Counters in a block of the fast paths
+static const size_t kBlock = 8;
+
+// Continuation bits of kBlock varint bytes
+static const uint64 kContinuationBits = 0x8080808080808080ULL;
+
+// Bytes of a varint, which has 7 bits in each byte.
+// It is branch-free, so the loops over it are vectorized.
+static inline uint32 VarintSize(uint32 val) {
+  return 1 + (val >= (1u << 7)) + (val >= (1u << 14)) +
+         (val >= (1u << 21)) + (val >= (1u << 28));
+}
+
+// Append a varint to out
+static inline char* PutVarint(uint32 val, char* out) {
+  while (val >= 0x80) {
+    *out++ = static_cast<char>(val | 0x80);
+    val >>= 7;
+  }
+  *out++ = static_cast<char>(val);
+  return out;
+}
+
+// Read a varint from [*ptr, end)
+static inline uint32 GetVarint(const char** ptr, const char* end) {
+  uint32 val = 0;
+  for (int shift = 0; shift < 35; shift += 7) {
+    CHECK_LT(*ptr, end);
+    uint8 byte = static_cast<uint8>(*(*ptr)++);
+    val |= static_cast<uint32>(byte & 0x7f) << shift;
+    if (byte < 0x80) {
+      return val;
+    }
+  }
+  LOG(FATAL) << "Broken varint in histogram message";
+  return 0;
+}
+
+// Bitwise or of a block of counters
+static inline uint32 OrBlock(const uint32* data) {
+  uint32 block[kBlock];
+  memcpy(block, data, sizeof(block));
+  uint32 bits = 0;
+  for (size_t j = 0; j < kBlock; ++j) {
+    bits |= block[j];
+  }
+  return bits;
+}
+
+// Append count varints to out. Most counters are small, so a
+// block of counters less than 128 is packed to one byte each.
+// The block is copied to local arrays, which do not alias, so
+// the compiler vectorizes the fixed-size loops.
+static char* PutVarints(const uint32* data, size_t count, char* out) {
+  size_t i = 0;
+  for (; i + kBlock <= count; i += kBlock) {
+    if (OrBlock(data + i) < 0x80) {
+      uint32 block[kBlock];
+      uint8 bytes[kBlock];
+      memcpy(block, data + i, sizeof(block));
+      for (size_t j = 0; j < kBlock; ++j) {
+        bytes[j] = static_cast<uint8>(block[j]);
+      }
+      memcpy(out, bytes, kBlock);
+      out += kBlock;
+    } else {
+      for (size_t j = 0; j < kBlock; ++j) {
+        out = PutVarint(data[i + j], out);
+      }
+    }
+  }
+  for (; i < count; ++i) {
+    out = PutVarint(data[i], out);
+  }
+  return out;
+}
+
+// Read count varints from [*ptr, end) to data. A block of
+// one-byte varints (no continuation bit in the 8 bytes) is 
+// unpacked by fixed-size loops on local arrays as above.
+static void GetVarints(const char** ptr, const char* end,
+                       uint32* data, size_t count, bool add) {
+  size_t i = 0;
+  while (i < count) {
+    uint64 word = kContinuationBits;
+    if (i + kBlock <= count && end - *ptr >= kBlock) {
+      memcpy(&word, *ptr, sizeof(word));
+    }
+    if ((word & kContinuationBits) == 0) {
+      uint8 bytes[kBlock];
+      uint32 block[kBlock];
+      memcpy(bytes, &word, kBlock);
+      if (add) {
+        memcpy(block, data + i, sizeof(block));
+      } else {
+        memset(block, 0, sizeof(block));
+      }
+      for (size_t j = 0; j < kBlock; ++j) {
+        block[j] += bytes[j];
+      }
+      memcpy(data + i, block, sizeof(block));
+      *ptr += kBlock;
+      i += kBlock;
+    } else {
+      uint32 val = GetVarint(ptr, end);
+      data[i] = add ? data[i] + val : val;
+      ++i;
+    }
+  }
+}
+
+// Encode count counters of data to out
+void EncodeHisto(const uint32* data, size_t count, std::string* out) {
+  CHECK_NOTNULL(out);
+  // Size of each encoding
+  size_t nnz = 0;
+  size_t varint_bytes = 0;
+  for (size_t i = 0; i < count; ++i) {
+    nnz += data[i] != 0;
+    varint_bytes += VarintSize(data[i]);
+  }
+  size_t raw_bytes = count * sizeof(uint32);
+  // Zeros take 1 byte each in varint, and the gaps are
+  // estimated by the average gap of nonzero counters
+  size_t sparse_bytes = varint_bytes - (count - nnz) + 
+    nnz * VarintSize(count / (nnz + 1)) + VarintSize(nnz);
+  HistoCodec codec = kCodecRaw;
+  size_t max_bytes = raw_bytes;
+  if (varint_bytes < max_bytes) {
+    codec = kCodecVarint;
+    max_bytes = varint_bytes;
+  }
+  if (sparse_bytes < max_bytes) {
+    codec = kCodecSparse;
+  }
+  // Upper bound of the message size
+  size_t header = 1 + VarintSize(count);
+  if (codec == kCodecRaw) {
+    out->resize(header + raw_bytes);
+  } else if (codec == kCodecVarint) {
+    out->resize(header + varint_bytes);
+  } else {
+    out->resize(header + VarintSize(nnz) + 
+                nnz * (VarintSize(count) + 5));
+  }
+  char* begin = &(*out)[0];
+  char* ptr = begin;
+  *ptr++ = static_cast<char>(codec);
+  ptr = PutVarint(count, ptr);
+  if (codec == kCodecRaw) {
+    memcpy(ptr, data, raw_bytes);
+    ptr += raw_bytes;
+  } else if (codec == kCodecVarint) {
+    ptr = PutVarints(data, count, ptr);
+  } else {
+    ptr = PutVarint(nnz, ptr);
+    size_t next = 0;  // index after the last nonzero
+    for (size_t i = 0; i < count; ++i) {
+      // Skip a block of zeros by one vectorized test
+      if (i % kBlock == 0 && i + kBlock <= count) {
+        if (OrBlock(data + i) == 0) {
+          i += kBlock - 1;
+          continue;
+        }
+      }
+      if (data[i] != 0) {
+        ptr = PutVarint(i - next, ptr);
+        ptr = PutVarint(data[i], ptr);
+        next = i + 1;
+      }
+    }
+  }
+  out->resize(ptr - begin);
+}
+
+// Decode the message buf of len bytes to data
+void DecodeHisto(const char* buf, size_t len, 
+                 uint32* data, size_t count, bool add) {
+  CHECK_NOTNULL(buf);
+  CHECK_GT(len, 0);
+  const char* end = buf + len;
+  HistoCodec codec = static_cast<HistoCodec>(*buf);
+  const char* ptr = buf + 1;
+  CHECK_EQ(GetVarint(&ptr, end), count);
+  if (codec == kCodecRaw) {
+    CHECK_EQ(end - ptr, count * sizeof(uint32));
+    if (add) {
+      // The payload may be unaligned
+      for (size_t i = 0; i < count; ++i) {
+        uint32 val;
+        memcpy(&val, ptr + i * sizeof(uint32), sizeof(uint32));
+        data[i] += val;
+      }
+    } else {
+      memcpy(data, ptr, count * sizeof(uint32));
+    }
+    ptr = end;
+  } else if (codec == kCodecVarint) {
+    GetVarints(&ptr, end, data, count, add);
+  } else if (codec == kCodecSparse) {
+    if (!add) {
+      memset(data, 0, count * sizeof(uint32));
+    }
+    uint32 nnz = GetVarint(&ptr, end);
+    size_t pos = 0;
+    for (uint32 k = 0; k < nnz; ++k) {
+      pos += GetVarint(&ptr, end);
+      CHECK_LT(pos, count);
+      data[pos++] += GetVarint(&ptr, end);
+    }
+  } else {
+    LOG(FATAL) << "Unknown histogram codec: " << static_cast<int>(codec);
+  }
+  CHECK(ptr == end);
+}
+
+}  // namespace xforest
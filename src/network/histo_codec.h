@@ -0,0 +1,70 @@
+//------------------------------------------------------------------------------
+// Copyright (c) 2018 by contributors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//------------------------------------------------------------------------------
+
+/*
+This file defines the wire encoding of histograms.
+*/
+
+#ifndef XFOREST_NETWORK_HISTO_CODEC_H_
+#define XFOREST_NETWORK_HISTO_CODEC_H_
+
+#include <string>
+
+#include "src/base/common.h"
+
+namespace xforest {
+
+// Encoding of a histogram message
+enum HistoCodec {
+  kCodecRaw = 0,     // 4 bytes for each counter
+  kCodecVarint = 1,  // varint for each counter
+  kCodecSparse = 2   // (index gap, value) varints of nonzero counters
+};
+
+//------------------------------------------------------------------------------
+// Histograms are mostly zeros or small counts, especially deep in
+// a tree. EncodeHisto() chooses the smallest encoding of each
+// message by the number of nonzero counters and their sizes:
+//
+//   std::string buf;
+//   EncodeHisto(histo, len, &buf);
+//   ... // send buf
+//   DecodeHisto(buf.data(), buf.size(), histo, len, true);
+//
+// The message starts with the codec byte and the number of counters.
+// The varint packing and unpacking have a fast path for blocks of
+// 8 counters less than 128, which the compiler vectorizes, and the
+// sparse encoding skips blocks of 8 zeros.
+//------------------------------------------------------------------------------
+
+// Encode count counters of data to out
+void EncodeHisto(const uint32* data, size_t count, std::string* out);
+
+// Decode the message buf of len bytes to count counters of
+// data. The counters are added to data if add is true, 
+// otherwise data is overwritten.
+void DecodeHisto(const char* buf, size_t len, 
+                 uint32* data, size_t count, bool add);
+
+// Codec of an encoded message
+inline HistoCodec GetHistoCodec(const std::string& buf) {
+  CHECK(!buf.empty());
+  return static_cast<HistoCodec>(buf[0]);
+}
+
+}  // namespace xforest
+
+#endif  // XFOREST_NETWORK_HISTO_CODEC_H_
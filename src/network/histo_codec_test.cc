@@ -0,0 +1,88 @@
+//------------------------------------------------------------------------------
+// Copyright (c) 2018 by contributors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//------------------------------------------------------------------------------
+
+/*
+This file tests the histogram encoding.
+*/
+
+#include "src/network/histo_codec.h"
+
+#include <string>
+#include <vector>
+
+#include "src/base/common.h"
+#include "gtest/gtest.h"
+
+namespace xforest {
+
+// Encode and decode data, and return the codec
+static HistoCodec RoundTrip(const std::vector<uint32>& data) {
+  std::string buf;
+  EncodeHisto(data.data(), data.size(), &buf);
+  std::vector<uint32> out(data.size(), 7);
+  DecodeHisto(buf.data(), buf.size(), out.data(), out.size(), false);
+  EXPECT_TRUE(out == data);
+  // Decode and add
+  DecodeHisto(buf.data(), buf.size(), out.data(), out.size(), true);
+  for (size_t i = 0; i < data.size(); ++i) {
+    EXPECT_EQ(out[i], 2 * data[i]);
+  }
+  return GetHistoCodec(buf);
+}
+
+TEST(HistoCodec, Sparse) {
+  std::vector<uint32> data(10000, 0);
+  for (size_t i = 0; i < data.size(); i += 100) {
+    data[i] = i;
+  }
+  data.back() = 0xffffffff / 2;
+  EXPECT_EQ(RoundTrip(data), kCodecSparse);
+}
+
+TEST(HistoCodec, Varint) {
+  std::vector<uint32> data(10000);
+  for (size_t i = 0; i < data.size(); ++i) {
+    data[i] = i % 100 + 1;
+  }
+  EXPECT_EQ(RoundTrip(data), kCodecVarint);
+}
+
+// Blocks of small counters mixed with large ones, and
+// a tail shorter than a block
+TEST(HistoCodec, VarintMixed) {
+  std::vector<uint32> data(10003);
+  for (size_t i = 0; i < data.size(); ++i) {
+    data[i] = i % 37 == 0 ? 100000 + i : i % 100 + 1;
+  }
+  EXPECT_EQ(RoundTrip(data), kCodecVarint);
+}
+
+TEST(HistoCodec, Raw) {
+  std::vector<uint32> data(10000);
+  for (size_t i = 0; i < data.size(); ++i) {
+    data[i] = 0x10000000 + i;
+  }
+  EXPECT_EQ(RoundTrip(data), kCodecRaw);
+}
+
+TEST(HistoCodec, Empty) {
+  std::vector<uint32> data;
+  RoundTrip(data);
+  data.assign(100, 0);
+  EXPECT_EQ(RoundTrip(data), kCodecSparse);
+}
+
+}  // namespace xforest
@@ -0,0 +1,415 @@
+//------------------------------------------------------------------------------
+// Copyright (c) 2018 by contributors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//------------------------------------------------------------------------------
+
+/*
+This file is the implementation of ShmCommunicator class.
+*/
+
+#include "src/network/shm_communicator.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <linux/futex.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+#include <algorithm>
+#include <atomic>
+#include <random>
+
+#include "src/base/memory_tracker.h"
+#include "src/base/profiler.h"
+
+namespace xforest {
+
+// Bytes of the ring buffer of each pair of ranks
+static const uint64 kRingBytes = 256 * 1024;  // 256 KB
+
+// Number of polls before sleeping on futex
+static const int kSpinCount = 1000;
+
+// Seconds for workers waiting the segment of rank 0
+static const int kWaitSeconds = 600;
+
+// Magic number set by rank 0 when the segment is ready
+static const uint32 kShmMagic = 0x78666f72;
+
+// Header of the segment. The generation is a random number of
+// the job, which rank 0 publishes in ready after all ranks attach.
+struct alignas(64) ShmHeader {
+  std::atomic<uint32> magic;     // kShmMagic if initialized
+  std::atomic<int32> attached;   // number of attached ranks
+  int32 size;                    // number of ranks
+  uint64 generation;             // set before magic
+  std::atomic<uint64> ready;     // generation if all attached
+};
+
+// Single producer single consumer ring buffer. The segment
+// is zero-filled, which is a valid initial state.
+struct ShmChannel {
+  // Written by producer
+  alignas(64) std::atomic<uint64> tail;      // bytes written
+  std::atomic<uint32> data_seq;              // futex of new data
+  std::atomic<uint32> data_waiting;          // consumer sleeps
+  // Written by consumer
+  alignas(64) std::atomic<uint64> head;      // bytes read
+  std::atomic<uint32> space_seq;             // futex of free space
+  std::atomic<uint32> space_waiting;         // producer sleeps
+  alignas(64) char data[kRingBytes];
+};
+
+// Sleep until *addr is not val, or timeout (nullptr for ever).
+// The futex is shared by processes, so it is not private.
+static inline void FutexWait(std::atomic<uint32>* addr, uint32 val,
+                             const struct timespec* timeout) {
+  syscall(SYS_futex, reinterpret_cast<uint32*>(addr), 
+          FUTEX_WAIT, val, timeout, nullptr, 0);
+}
+
+// Wake up all sleepers on addr
+static inline void FutexWake(std::atomic<uint32>* addr) {
+  syscall(SYS_futex, reinterpret_cast<uint32*>(addr), 
+          FUTEX_WAKE, INT32_MAX, nullptr, nullptr, 0);
+}
+
+// Bump seq and wake up the sleeper if any
+static inline void Notify(std::atomic<uint32>* seq, 
+                          std::atomic<uint32>* waiting) {
+  seq->fetch_add(1);
+  if (waiting->exchange(0) != 0) {
+    FutexWake(seq);
+  }
+}
+
+// Sleep on seq until ready() is true or timeout
+template <typename Ready>
+static inline void Sleep(std::atomic<uint32>* seq, 
+                         std::atomic<uint32>* waiting,
+                         Ready ready,
+                         const struct timespec* timeout) {
+  uint32 val = seq->load();
+  if (ready()) {
+    return;
+  }
+  waiting->store(1);
+  // Check again, since Notify() may miss the waiting flag
+  if (ready()) {
+    return;
+  }
+  FutexWait(seq, val, timeout);
+}
+
+// Write at most len bytes to the ring, return the written size
+static int Write(ShmChannel* ch, const char* data, int len) {
+  uint64 tail = ch->tail.load(std::memory_order_relaxed);
+  uint64 head = ch->head.load(std::memory_order_acquire);
+  uint64 size = std::min<uint64>(kRingBytes - (tail - head), len);
+  if (size == 0) {
+    return 0;
+  }
+  uint64 pos = tail % kRingBytes;
+  uint64 first = std::min(size, kRingBytes - pos);
+  memcpy(ch->data + pos, data, first);
+  memcpy(ch->data, data + first, size - first);
+  ch->tail.store(tail + size, std::memory_order_release);
+  Notify(&ch->data_seq, &ch->data_waiting);
+  return size;
+}
+
+// Read at most len bytes from the ring, return the read size
+static int Read(ShmChannel* ch, char* data, int len) {
+  uint64 head = ch->head.load(std::memory_order_relaxed);
+  uint64 tail = ch->tail.load(std::memory_order_acquire);
+  uint64 size = std::min<uint64>(tail - head, len);
+  if (size == 0) {
+    return 0;
+  }
+  uint64 pos = head % kRingBytes;
+  uint64 first = std::min(size, kRingBytes - pos);
+  memcpy(data, ch->data + pos, first);
+  memcpy(data + first, ch->data, size - first);
+  ch->head.store(head + size, std::memory_order_release);
+  Notify(&ch->space_seq, &ch->space_waiting);
+  return size;
+}
+
+// Wait new data in the ring
+static void WaitData(ShmChannel* ch, const struct timespec* timeout) {
+  Sleep(&ch->data_seq, &ch->data_waiting, [ch]() {
+    return ch->tail.load() != ch->head.load();
+  }, timeout);
+}
+
+// Wait free space in the ring
+static void WaitSpace(ShmChannel* ch, const struct timespec* timeout) {
+  Sleep(&ch->space_seq, &ch->space_waiting, [ch]() {
+    return ch->tail.load() - ch->head.load() < kRingBytes;
+  }, timeout);
+}
+
+// Name of the shared memory segment of an address
+static std::string ShmName(const std::string& addr) {
+  std::string name = "/xforest_" + addr;
+  for (size_t i = 1; i < name.size(); ++i) {
+    if (name[i] == '/') {
+      name[i] = '_';
+    }
+  }
+  return name;
+}
+
+// Random non-zero generation of a job
+static uint64 NewGeneration() {
+  std::random_device rd;
+  uint64 generation = 0;
+  while (generation == 0) {
+    generation = (static_cast<uint64>(rd()) << 32) | rd();
+  }
+  return generation;
+}
+
+// Open the segment of name if it has the expected size,
+// and get its inode. Return -1 if it is not created yet.
+static int OpenSegment(const std::string& name, size_t size, ino_t* ino) {
+  int fd = shm_open(name.c_str(), O_RDWR, 0600);
+  if (fd < 0) {
+    return -1;
+  }
+  struct stat st;
+  if (fstat(fd, &st) != 0 || st.st_size != static_cast<off_t>(size)) {
+    close(fd);
+    return -1;
+  }
+  *ino = st.st_ino;
+  return fd;
+}
+
+// Whether name still refers to the segment of inode ino
+static bool IsCurrentSegment(const std::string& name, ino_t ino) {
+  int fd = shm_open(name.c_str(), O_RDONLY, 0600);
+  if (fd < 0) {
+    return false;
+  }
+  struct stat st;
+  bool same = fstat(fd, &st) == 0 && st.st_ino == ino;
+  close(fd);
+  return same;
+}
+
+// Map the segment of fd
+static char* MapSegment(int fd, size_t size) {
+  void* ptr = mmap(nullptr, size, PROT_READ | PROT_WRITE, 
+                   MAP_SHARED, fd, 0);
+  close(fd);
+  if (ptr == MAP_FAILED) {
+    LOG(FATAL) << "Failed to map shared memory: " << strerror(errno);
+  }
+  return static_cast<char*>(ptr);
+}
+
+// Attach a worker to the segment and wait rank 0 publishing it
+// ready. Return false if the segment is left by a crashed job:
+// name refers to another segment (rank 0 replaced it), or all
+// ranks of that job have attached already.
+static bool AttachSegment(ShmHeader* header, int size,
+                          const std::string& name, ino_t ino,
+                          time_t deadline) {
+  uint64 generation = 0;
+  for (int i = 0; ; ++i) {
+    if (generation == 0 && header->magic.load() == kShmMagic) {
+      CHECK_EQ(header->size, size);
+      generation = header->generation;
+      if (header->attached.fetch_add(1) >= size) {
+        return false;
+      }
+    }
+    if (generation != 0 && header->ready.load() == generation) {
+      return true;
+    }
+    if (i % 10 == 9 && !IsCurrentSegment(name, ino)) {
+      return false;
+    }
+    if (time(nullptr) > deadline) {
+      LOG(FATAL) << "Timeout waiting shared memory " << name;
+    }
+    usleep(1000);
+  }
+}
+
+// dctor
+ShmCommunicator::~ShmCommunicator() {
+  if (base_ != nullptr) {
+    munmap(base_, size_);
+    MemoryTracker::Free(kMemNetwork, size_);
+  }
+}
+
+// Initialize Communicator
+void ShmCommunicator::Initialize(int rank, /* master is rank_0 */
+                                 int num_workers, 
+                                 const std::string& master_addr) {
+  CHECK_GE(rank, 0);
+  CHECK_GT(num_workers, 0);
+  CHECK_LE(rank, num_workers);
+  CHECK(!master_addr.empty());
+  rank_ = rank;
+  num_workers_ = num_workers;
+  size_ = sizeof(ShmHeader) + 
+          (size_t)Size() * Size() * sizeof(ShmChannel);
+  std::string name = ShmName(master_addr);
+  if (rank_ == 0) {
+    // Remove the segment left by a crashed job
+    shm_unlink(name.c_str());
+    int fd = shm_open(name.c_str(), O_CREAT | O_EXCL | O_RDWR, 0600);
+    if (fd < 0) {
+      LOG(FATAL) << "Failed to create shared memory " << name 
+                 << ": " << strerror(errno);
+    }
+    CHECK_EQ(0, ftruncate(fd, size_));
+    base_ = MapSegment(fd, size_);
+    ShmHeader* header = reinterpret_cast<ShmHeader*>(base_);
+    header->size = Size();
+    header->generation = NewGeneration();
+    header->magic.store(kShmMagic);
+    header->attached.fetch_add(1);
+    // A worker that never starts must not hang rank 0
+    time_t deadline = time(nullptr) + kWaitSeconds;
+    while (header->attached.load() < Size()) {
+      if (time(nullptr) > deadline) {
+        shm_unlink(name.c_str());
+        LOG(FATAL) << "Timeout waiting " << Size() - header->attached.load()
+                   << " ranks to attach " << name;
+      }
+      usleep(1000);
+    }
+    header->ready.store(header->generation);
+    shm_unlink(name.c_str());
+    LOG(INFO) << "All " << Size() << " ranks attach to " << name;
+  } else {
+    // The name may refer to a segment left by a crashed job
+    // until rank 0 replaces it, so the worker re-opens the name
+    // until it attaches to the segment that rank 0 publishes.
+    time_t deadline = time(nullptr) + kWaitSeconds;
+    while (base_ == nullptr) {
+      ino_t ino = 0;
+      int fd = OpenSegment(name, size_, &ino);
+      if (fd >= 0) {
+        base_ = MapSegment(fd, size_);
+        ShmHeader* header = reinterpret_cast<ShmHeader*>(base_);
+        if (!AttachSegment(header, Size(), name, ino, deadline)) {
+          LOG(WARNING) << "Skip stale shared memory " << name;
+          munmap(base_, size_);
+          base_ = nullptr;
+        }
+      } else if (time(nullptr) > deadline) {
+        LOG(FATAL) << "Failed to open shared memory " << name;
+      } else {
+        usleep(10000);
+      }
+    }
+  }
+  MemoryTracker::Alloc(kMemNetwork, size_);
+}
+
+// Ring from rank src to rank dst
+ShmChannel* ShmCommunicator::Channel(int src, int dst) {
+  CHECK_GE(dst, 0);
+  CHECK_LT(dst, Size());
+  CHECK_NE(src, dst);
+  ShmChannel* channels = 
+    reinterpret_cast<ShmChannel*>(base_ + sizeof(ShmHeader));
+  return channels + src * Size() + dst;
+}
+
+// Recv data
+void ShmCommunicator::Recv(int rank, char* data, int len) {
+  TRACE_ZONE("recv");
+  ShmChannel* ch = Channel(rank, rank_);
+  int recieved_bytes = 0;
+  int idle = 0;
+  while (recieved_bytes < len) {
+    int tmp = Read(ch, data + recieved_bytes, len - recieved_bytes);
+    recieved_bytes += tmp;
+    if (tmp == 0 && ++idle >= kSpinCount) {
+      WaitData(ch, nullptr);
+      idle = 0;
+    }
+  }
+}
+
+// Send data
+void ShmCommunicator::Send(int rank, const char* data, int len) {
+  TRACE_ZONE("send");
+  ShmChannel* ch = Channel(rank_, rank);
+  int sent_bytes = 0;
+  int idle = 0;
+  while (sent_bytes < len) {
+    int tmp = Write(ch, data + sent_bytes, len - sent_bytes);
+    sent_bytes += tmp;
+    if (tmp == 0 && ++idle >= kSpinCount) {
+      WaitSpace(ch, nullptr);
+      idle = 0;
+    }
+  }
+}
+
+// Send and receive at the same time by polling both rings
+void ShmCommunicator::SendRecv(int send_rank, 
+                               const char* send_data, 
+                               int send_len,
+                               int recv_rank, 
+                               char* recv_data, 
+                               int recv_len) {
+  TRACE_ZONE("sendrecv");
+  ShmChannel* out = Channel(rank_, send_rank);
+  ShmChannel* in = Channel(recv_rank, rank_);
+  // Only one futex can be waited, so the sleep has a
+  // timeout in case the other ring gets ready first
+  struct timespec timeout;
+  timeout.tv_sec = 0;
+  timeout.tv_nsec = 100 * 1000;  // 100 us
+  int sent_bytes = 0;
+  int recieved_bytes = 0;
+  int idle = 0;
+  while (sent_bytes < send_len || recieved_bytes < recv_len) {
+    int tmp = 0;
+    if (sent_bytes < send_len) {
+      int n = Write(out, send_data + sent_bytes, send_len - sent_bytes);
+      sent_bytes += n;
+      tmp += n;
+    }
+    if (recieved_bytes < recv_len) {
+      int n = Read(in, recv_data + recieved_bytes, 
+                   recv_len - recieved_bytes);
+      recieved_bytes += n;
+      tmp += n;
+    }
+    if (tmp > 0 || ++idle < kSpinCount) {
+      continue;
+    }
+    idle = 0;
+    if (recieved_bytes < recv_len) {
+      WaitData(in, sent_bytes < send_len ? &timeout : nullptr);
+    } else {
+      WaitSpace(out, nullptr);
+    }
+  }
+}
+
+}  // namespace xforest
@@ -0,0 +1,82 @@
+//------------------------------------------------------------------------------
+// Copyright (c) 2018 by contributors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//------------------------------------------------------------------------------
+
+/*
+This file defines the ShmCommunicator class.
+*/
+
+#ifndef XFOREST_NETWORK_SHM_COMMUNICATOR_H_
+#define XFOREST_NETWORK_SHM_COMMUNICATOR_H_
+
+#include <string>
+
+#include "src/base/common.h"
+#include "src/network/communicator.h"
+
+namespace xforest {
+
+struct ShmChannel;
+
+//------------------------------------------------------------------------------
+// ShmCommunicator connects the processes (or threads) on the same
+// host by POSIX shared memory, which has the same interface as
+// SocketCommunicator:
+//
+//   ShmCommunicator comm;
+//   comm.Initialize(rank, num_workers, "train_job_1");
+//
+// The address names the shared memory segment. It has a single
+// producer single consumer ring buffer for each ordered pair of
+// ranks, and a reader (writer) spins for a while and then sleeps 
+// on a futex when its ring is empty (full). Rank 0 creates the 
+// segment and removes its name after all ranks attach to it, 
+// so the memory is freed when the last rank exits. A worker
+// skips the segment left by a crashed job, since rank 0 never
+// publishes that one ready for the workers of the new job.
+//------------------------------------------------------------------------------
+class ShmCommunicator : public Communicator {
+ public:
+  ShmCommunicator() {}
+  ~ShmCommunicator();
+
+  // Initialize Communicator
+  virtual void Initialize(int rank, /* master is rank_0 */
+                          int num_workers, 
+                          const std::string& master_addr);
+
+  // Recv data
+  virtual void Recv(int rank, char* data, int len);
+
+  // Send data
+  virtual void Send(int rank, const char* data, int len);
+
+  // Send and receive at the same time by polling both rings
+  virtual void SendRecv(int send_rank, const char* send_data, int send_len,
+                        int recv_rank, char* recv_data, int recv_len);
+
+ private:
+  // Ring from rank src to rank dst
+  ShmChannel* Channel(int src, int dst);
+
+  char* base_ = nullptr;  // mapped segment
+  size_t size_ = 0;       // segment size
+
+  DISALLOW_COPY_AND_ASSIGN(ShmCommunicator);
+};
+
+}  // namespace xforest
+
+#endif  // XFOREST_NETWORK_SHM_COMMUNICATOR_H_
@@ -0,0 +1,96 @@
+//------------------------------------------------------------------------------
+// Copyright (c) 2018 by contributors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//------------------------------------------------------------------------------
+
+/*
+This file tests the ShmCommunicator class.
+*/
+
+#include "src/network/shm_communicator.h"
+
+#include <signal.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <thread>
+#include <vector>
+
+#include "src/base/common.h"
+#include "src/network/communicator_test_util.h"
+#include "gtest/gtest.h"
+
+namespace xforest {
+
+TEST(ShmCommunicator, Collective) {
+  RunAll("shm", 3, "shm_communicator_test", TestCollective);
+}
+
+TEST(ShmCommunicator, MultiProcess) {
+  int pid = fork();
+  ASSERT_GE(pid, 0);
+  int rank = pid == 0 ? 1 : 0;
+  std::vector<uint32> data(1000000, rank + 1);
+  {
+    ShmCommunicator comm;
+    comm.Initialize(rank, 1, "shm_communicator_test_fork");
+    comm.Allreduce(data.data(), data.size());
+  }
+  bool ok = true;
+  for (size_t i = 0; i < data.size(); ++i) {
+    ok = ok && data[i] == 3;
+  }
+  if (pid == 0) {
+    _exit(ok ? 0 : 1);
+  }
+  EXPECT_TRUE(ok);
+  int status = 0;
+  waitpid(pid, &status, 0);
+  EXPECT_TRUE(WIFEXITED(status));
+  EXPECT_EQ(WEXITSTATUS(status), 0);
+}
+
+// A worker starting before rank 0 must not attach to the
+// segment left by a crashed job of the same address
+TEST(ShmCommunicator, StaleSegment) {
+  const std::string addr = "shm_communicator_test_stale";
+  int pid = fork();
+  ASSERT_GE(pid, 0);
+  if (pid == 0) {
+    // Rank 0 waits the worker until it is killed
+    ShmCommunicator comm;
+    comm.Initialize(0, 1, addr);
+    _exit(0);
+  }
+  usleep(200 * 1000);
+  kill(pid, SIGKILL);
+  waitpid(pid, nullptr, 0);
+  std::vector<uint32> data0(1000, 1);
+  std::vector<uint32> data1(1000, 2);
+  std::thread worker([&]() {
+    ShmCommunicator comm;
+    comm.Initialize(1, 1, addr);
+    comm.Allreduce(data1.data(), data1.size());
+  });
+  usleep(200 * 1000);
+  {
+    ShmCommunicator comm;
+    comm.Initialize(0, 1, addr);
+    comm.Allreduce(data0.data(), data0.size());
+  }
+  worker.join();
+  EXPECT_EQ(data0[999], 3);
+  EXPECT_EQ(data1[999], 3);
+}
+
+}  // namespace xforest
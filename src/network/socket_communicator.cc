@@ -18,94 +18,349 @@
 This file is the implementation of SocketCommunicator class.
 */
 
+#include "src/network/socket_communicator.h"
+
+#include <arpa/inet.h>
+#include <errno.h>
+#include <poll.h>
+#include <string.h>
+#include <algorithm>
+#include <chrono>
 #include <thread>
 
-#include "src/network/socket_communicator.h"
+#include "src/base/profiler.h"
 #include "src/base/split_string.h"
 
 namespace xforest {
 
+// Message sent by a worker when it connects to the master
+struct Handshake {
+  int32 rank;   // rank of worker
+  int32 port;   // listening port of worker
+};
+
+// Address of a worker in the peer table sent by the master
+struct PeerAddr {
+  char ip[INET_ADDRSTRLEN];
+  int32 port;
+};
+
+// Receive len bytes from socket
+static void RecvAll(TCPSocket* socket, char* data, int len) {
+  if (!socket->ReceiveAll(data, len)) {
+    LOG(FATAL) << "Failed to receive data from socket fd: " 
+               << socket->Socket();
+  }
+}
+
+// Send len bytes to socket
+static void SendAll(TCPSocket* socket, const char* data, int len) {
+  if (!socket->SendAll(data, len)) {
+    LOG(FATAL) << "Failed to send data to socket fd: " 
+               << socket->Socket();
+  }
+}
+
+// Send a framed rendezvous message to socket
+static void SendMsg(TCPSocket* socket, const char* data, int len) {
+  if (!socket->SendMessage(data, len)) {
+    LOG(FATAL) << "Failed to send message to socket fd: "
+               << socket->Socket();
+  }
+}
+
+// Receive a framed rendezvous message of exactly len bytes.
+// A different size means the peer runs with other options,
+// e.g. a different num_workers.
+static void RecvMsg(TCPSocket* socket, char* data, int len) {
+  std::string msg;
+  if (!socket->ReceiveMessage(&msg)) {
+    LOG(FATAL) << "Failed to receive message from socket fd: "
+               << socket->Socket();
+  }
+  if (msg.size() != static_cast<size_t>(len)) {
+    LOG(FATAL) << "Unexpected message size " << msg.size()
+               << " (expected " << len << ") from socket fd: "
+               << socket->Socket() << ", is num_workers the same?";
+  }
+  memcpy(data, msg.data(), len);
+}
+
+// dctor
+SocketCommunicator::~SocketCommunicator() {
+  for (size_t i = 0; i < sockets_.size(); ++i) {
+    delete sockets_[i];
+  }
+}
+
 // Initialize Communicator
 void SocketCommunicator::Initialize(int rank, /* master is rank_0 */
                                     int num_workers, 
                                     const std::string& master_addr) {
   CHECK_GE(rank, 0);
   CHECK_GT(num_workers, 0);
+  CHECK_LE(rank, num_workers);
   rank_ = rank;
   num_workers_ = num_workers;
   is_master_ = rank_ == 0 ? true : false;
   master_addr_ = master_addr;
+  sockets_.assign(num_workers_ + 1, nullptr);
   if (is_master_) {
     InitMaster();
   } else {
     InitWorker();
   }
+  for (int r = 0; r <= num_workers_; ++r) {
+    if (r == rank_) {
+      continue;
+    }
+    // Small messages are sent at once
+    CHECK(sockets_[r]->SetNoDelay(true));
+    if (zero_copy_ && !sockets_[r]->SetZeroCopy(true)) {
+      LOG(WARNING) << "MSG_ZEROCOPY is not supported, use copying send";
+    }
+  }
+}
+
+// Create a socket with the buffer size. Accepted
+// sockets inherit it from the listening socket.
+TCPSocket* SocketCommunicator::NewSocket() {
+  TCPSocket* socket = new TCPSocket();
+  CHECK(socket->SetBufferSize(buffer_size_, buffer_size_));
+  return socket;
+}
+
+// Connect to ip:port, and retry with exponential backoff
+// until timeout, since the server may not start yet
+TCPSocket* SocketCommunicator::Connect(const char* ip, int port) {
+  const int kMinBackoff = 10;     // millsec
+  const int kMaxBackoff = 1000;   // millsec
+  auto deadline = std::chrono::steady_clock::now() +
+                  std::chrono::seconds(timeout_);
+  int backoff = kMinBackoff;
+  for (;;) {
+    TCPSocket* socket = NewSocket();
+    if (socket->Connect(ip, port, false)) {
+      return socket;
+    }
+    delete socket;
+    if (std::chrono::steady_clock::now() >= deadline) {
+      LOG(FATAL) << "Failed to connect to " << ip << ":" << port
+                 << " in " << timeout_ << " seconds";
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(backoff));
+    backoff = std::min(backoff * 2, kMaxBackoff);
+  }
+  return nullptr;
+}
+
+// Accept a connection on server_ and clear the inherited
+// startup timeout. Return nullptr on timeout.
+TCPSocket* SocketCommunicator::Accept(std::string* ip) {
+  TCPSocket* socket = new TCPSocket();
+  uint16 port;
+  if (!server_->Accept(socket, ip, &port)) {
+    delete socket;
+    return nullptr;
+  }
+  CHECK(socket->SetTimeout(0));
+  return socket;
+}
+
+// Fatal with the ranks in [begin, end) not connected yet
+void SocketCommunicator::MissingPeers(int begin, int end) {
+  std::string missing;
+  for (int r = begin; r < end; ++r) {
+    if (sockets_[r] == nullptr) {
+      missing += " " + std::to_string(r);
+    }
+  }
+  LOG(FATAL) << "Node " << rank_ << " timeout (" << timeout_
+             << "s) waiting for ranks:" << missing;
 }
 
 // Initialize master node
 void SocketCommunicator::InitMaster() {
-  // server socket + worker socket
-  sockets_.resize(num_workers_ + 1);
   std::vector<std::string> ip_and_port;
   SplitStringUsing(master_addr_, ":", &ip_and_port);
   CHECK_EQ(2, ip_and_port.size());
-  sockets_[0] = new TCPSocket();
-  TCPSocket* server = sockets_[0]; // server socket
-  server->SetTimeout(kTimeOut * 60 * 1000); // millsec
+  server_.reset(NewSocket());
+  CHECK(server_->SetTimeout(timeout_ * 1000)); // millsec
   // Bind socket
-  CHECK(server->Bind(ip_and_port[0].c_str(),
-                  atoi(ip_and_port[1].c_str())));
+  CHECK(server_->Bind(ip_and_port[0].c_str(),
+                      atoi(ip_and_port[1].c_str())));
   // Listen socket
-  CHECK(server->Listen(1024));
+  CHECK(server_->Listen(1024));
   LOG(INFO) << "Wait worker connect ...";
-  // Accept all workers
+  // Accept all workers. Workers may connect in any
+  // order, so each of them tells its rank first.
+  std::vector<PeerAddr> peers(num_workers_ + 1);
+  memset(peers.data(), 0, peers.size() * sizeof(PeerAddr));
   std::string accept_ip;
-  uint16 accept_port;
   for (int i = 1; i <= num_workers_; ++i) {
-    sockets_[i] = new TCPSocket();
-    CHECK(server->Accept(sockets_[i], &accept_ip, &accept_port));
+    TCPSocket* socket = Accept(&accept_ip);
+    if (socket == nullptr) {
+      MissingPeers(1, num_workers_ + 1);
+    }
+    Handshake hs;
+    RecvMsg(socket, reinterpret_cast<char*>(&hs), sizeof(hs));
+    CHECK_GT(hs.rank, 0);
+    CHECK_LE(hs.rank, num_workers_);
+    if (sockets_[hs.rank] != nullptr) {
+      LOG(FATAL) << "Duplicate worker rank: " << hs.rank;
+    }
+    sockets_[hs.rank] = socket;
+    CHECK_LT(accept_ip.size(), INET_ADDRSTRLEN);
+    strcpy(peers[hs.rank].ip, accept_ip.c_str());
+    peers[hs.rank].port = hs.port;
     LOG(INFO) << "master " << ip_and_port[0] << ":" << ip_and_port[1]
-              << " accepts worker " << accept_ip << ":" << accept_port;
+              << " accepts worker " << hs.rank << " "
+              << accept_ip << ":" << hs.port;
+  }
+  server_.reset();
+  // Send the peer table to all workers
+  for (int i = 1; i <= num_workers_; ++i) {
+    SendMsg(sockets_[i], reinterpret_cast<const char*>(peers.data()),
+            peers.size() * sizeof(PeerAddr));
   }
 }
 
 // Initialize worker node
 void SocketCommunicator::InitWorker() {
-  // Only a client socket
-  sockets_.resize(1);
   std::vector<std::string> ip_and_port;
   SplitStringUsing(master_addr_, ":", &ip_and_port);
   CHECK_EQ(2, ip_and_port.size());
-  sockets_[0] = new TCPSocket();
-  TCPSocket* client = sockets_[0];
-  client->Connect(ip_and_port[0].c_str(), 
-  	         atoi(ip_and_port[1].c_str()));
-  LOG(INFO) << "Connect to master node " 
+  // Listen on a free port for the workers of higher rank
+  server_.reset(NewSocket());
+  CHECK(server_->SetTimeout(timeout_ * 1000)); // millsec
+  CHECK(server_->Bind("0.0.0.0", 0));
+  CHECK(server_->Listen(num_workers_));
+  Handshake hs;
+  hs.rank = rank_;
+  hs.port = server_->LocalPort();
+  CHECK_GT(hs.port, 0);
+  // Connect to master, which may not start yet
+  sockets_[0] = Connect(ip_and_port[0].c_str(),
+                        atoi(ip_and_port[1].c_str()));
+  LOG(INFO) << "Connect to master node "
             << ip_and_port[0] << ":" << ip_and_port[1];
+  SendMsg(sockets_[0], reinterpret_cast<const char*>(&hs), sizeof(hs));
+  std::vector<PeerAddr> peers(num_workers_ + 1);
+  RecvMsg(sockets_[0], reinterpret_cast<char*>(peers.data()),
+          peers.size() * sizeof(PeerAddr));
+  // Accept the workers of higher rank in a thread, while
+  // connecting to the workers of lower rank. Each thread
+  // only sets its own slots of sockets_.
+  std::thread acceptor([this]() {
+    std::string accept_ip;
+    for (int i = rank_ + 1; i <= num_workers_; ++i) {
+      TCPSocket* socket = Accept(&accept_ip);
+      if (socket == nullptr) {
+        MissingPeers(rank_ + 1, num_workers_ + 1);
+      }
+      int32 peer_rank = 0;
+      RecvMsg(socket, reinterpret_cast<char*>(&peer_rank),
+              sizeof(peer_rank));
+      CHECK_GT(peer_rank, rank_);
+      CHECK_LE(peer_rank, num_workers_);
+      CHECK(sockets_[peer_rank] == nullptr);
+      sockets_[peer_rank] = socket;
+    }
+  });
+  for (int r = 1; r < rank_; ++r) {
+    sockets_[r] = Connect(peers[r].ip, peers[r].port);
+    int32 my_rank = rank_;
+    SendMsg(sockets_[r], reinterpret_cast<const char*>(&my_rank),
+            sizeof(my_rank));
+  }
+  acceptor.join();
+  server_.reset();
+  LOG(INFO) << "Worker " << rank_ << " connects to all peers";
 }
 
 // Recv data
 void SocketCommunicator::Recv(int rank, char* data, int len) {
-  TCPSocket* socket = sockets_[rank];
-  int recieved_bytes = 0;
-  while (recieved_bytes < len) {
-    int max_len = len - recieved_bytes;
-    int tmp = socket->Receive(data+recieved_bytes, max_len);
-    CHECK_GE(tmp, 0);
-    recieved_bytes += tmp;
-  }
+  TRACE_ZONE("recv");
+  CHECK_NE(rank, rank_);
+  RecvAll(sockets_[rank], data, len);
 }
 
 // Send data
 void SocketCommunicator::Send(int rank, const char* data, int len) {
-  TCPSocket* socket = sockets_[rank];
+  TRACE_ZONE("send");
+  CHECK_NE(rank, rank_);
+  SendAll(sockets_[rank], data, len);
+}
+
+// Wait the zero-copy sends of all sockets
+void SocketCommunicator::WaitSends() {
+  if (!zero_copy_) {
+    return;
+  }
+  for (size_t r = 0; r < sockets_.size(); ++r) {
+    if (sockets_[r] != nullptr && !sockets_[r]->WaitZeroCopy()) {
+      LOG(FATAL) << "Failed to wait zero-copy sends to rank " << r;
+    }
+  }
+}
+
+// Send and receive at the same time by polling both sockets
+void SocketCommunicator::SendRecv(int send_rank, 
+                                  const char* send_data, 
+                                  int send_len,
+                                  int recv_rank, 
+                                  char* recv_data, 
+                                  int recv_len) {
+  TRACE_ZONE("sendrecv");
+  CHECK_NE(send_rank, rank_);
+  CHECK_NE(recv_rank, rank_);
+  TCPSocket* send_socket = sockets_[send_rank];
+  TCPSocket* recv_socket = sockets_[recv_rank];
   int sent_bytes = 0;
-  while (sent_bytes < len) {
-    int max_len = len - sent_bytes;
-    int tmp = socket->Send(data+sent_bytes, max_len);
-    CHECK_GE(tmp, 0);
-    sent_bytes += tmp;
+  int recieved_bytes = 0;
+  while (sent_bytes < send_len || recieved_bytes < recv_len) {
+    struct pollfd fds[2];
+    int num_fds = 0;
+    if (sent_bytes < send_len) {
+      fds[num_fds].fd = send_socket->Socket();
+      fds[num_fds].events = POLLOUT;
+      num_fds++;
+    }
+    if (recieved_bytes < recv_len) {
+      fds[num_fds].fd = recv_socket->Socket();
+      fds[num_fds].events = POLLIN;
+      num_fds++;
+    }
+    if (poll(fds, num_fds, -1) < 0) {
+      CHECK_EQ(errno, EINTR);
+      continue;
+    }
+    for (int i = 0; i < num_fds; ++i) {
+      if (fds[i].revents == 0) {
+        continue;
+      }
+      if (fds[i].events == POLLOUT) {
+        int tmp = send_socket->Send(send_data + sent_bytes,
+                                    send_len - sent_bytes,
+                                    MSG_DONTWAIT | MSG_NOSIGNAL);
+        if (tmp < 0 && errno != EAGAIN && errno != EWOULDBLOCK) {
+          LOG(FATAL) << "Failed to send data: " << strerror(errno);
+        }
+        sent_bytes += std::max(tmp, 0);
+      } else {
+        int tmp = recv_socket->Receive(recv_data + recieved_bytes,
+                                       recv_len - recieved_bytes,
+                                       MSG_DONTWAIT);
+        if (tmp == 0) {
+          LOG(FATAL) << "Failed to receive data: connection closed";
+        }
+        if (tmp < 0 && errno != EAGAIN && errno != EWOULDBLOCK) {
+          LOG(FATAL) << "Failed to receive data: " << strerror(errno);
+        }
+        recieved_bytes += std::max(tmp, 0);
+      }
+    }
   }
 }
 
-}  // namespace xforest
\ No newline at end of file
+}  // namespace xforest
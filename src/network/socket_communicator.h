@@ -30,36 +30,91 @@ This file defines the SocketCommunicator class.
 
 namespace xforest {
 
+// Timeout (minutes) for the nodes waiting each other at startup
+const int kTimeOut = 60;
+
 //------------------------------------------------------------------------------
-// Socket warpper for Communicator
+// Socket warpper for Communicator. The nodes are fully connected
+// by a rendezvous at the master: each worker connects to the master
+// (retrying with backoff, so workers can start before the master),
+// reports its rank and listening port, and receives the addresses
+// of all workers. Then it accepts the workers of higher rank in a
+// thread while connecting to the ones of lower rank.
+// sockets_[r] is the connection to the node of rank r.
 //------------------------------------------------------------------------------	
 class SocketCommunicator : public Communicator {
  public:
   SocketCommunicator() {}
-  ~SocketCommunicator() {}
+  ~SocketCommunicator();
 
   // Initialize Communicator
   virtual void Initialize(int rank, /* master is rank_0 */
                           int num_workers, 
                           const std::string& master_addr);
 
+  // Size of socket send and receive buffers, which must
+  // be set before Initialize(). 0 means kernel default.
+  void SetBufferSize(int size) {
+    CHECK_GE(size, 0);
+    buffer_size_ = size;
+  }
+
+  // Send large messages with MSG_ZEROCOPY if supported,
+  // which must be set before Initialize(). Send() returns
+  // before the kernel releases the data, so the data must
+  // not be modified until WaitSends().
+  void SetZeroCopy(bool flag) {
+    zero_copy_ = flag;
+  }
+
+  // Seconds to wait for the other nodes at startup,
+  // which must be set before Initialize()
+  void SetTimeout(int seconds) {
+    CHECK_GT(seconds, 0);
+    timeout_ = seconds;
+  }
+
   // Recv data
   virtual void Recv(int rank, char* data, int len);
 
   // Send data
   virtual void Send(int rank, const char* data, int len);
 
+  // Send and receive at the same time by polling both sockets
+  virtual void SendRecv(int send_rank, const char* send_data, int send_len,
+                        int recv_rank, char* recv_data, int recv_len);
+
+  // Wait the zero-copy sends of all sockets
+  virtual void WaitSends();
+
+ protected:
+  std::vector<TCPSocket*> sockets_;  // sockets indexed by rank
+
  private:
   void InitMaster();  // Initialize master node
   void InitWorker();  // Initialize worker node
+  TCPSocket* NewSocket();  // Create socket with buffer size
+
+  // Connect to ip:port, and retry with exponential backoff
+  // until timeout, since the server may not start yet
+  TCPSocket* Connect(const char* ip, int port);
+
+  // Accept a connection on server_ and clear the inherited
+  // startup timeout. Return nullptr on timeout.
+  TCPSocket* Accept(std::string* ip);
+
+  // Fatal with the ranks in [begin, end) not connected yet
+  void MissingPeers(int begin, int end);
+
+  int timeout_ = kTimeOut * 60;  // Startup timeout (seconds)
+
+  int buffer_size_ = 0;      // Socket buffer size
+  bool zero_copy_ = false;   // Use MSG_ZEROCOPY
 
-  int rank_;          // rank of local machine
-  int num_workers_;   // total number of workers 
   bool is_master_;    // Node is master node
-  bool is_init_;      // Communicator is intialized
   std::string master_addr_; // Address of master node
 
-  std::vector<TCPSocket*> sockets_;  // sockets
+  scoped_ptr<TCPSocket> server_;     // listening socket
 
   DISALLOW_COPY_AND_ASSIGN(SocketCommunicator);
 };
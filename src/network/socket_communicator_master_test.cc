@@ -28,7 +28,7 @@ const int kNumWorker = 2;
 TEST(SocketCommunicator, MasterSide) {
   xforest::SocketCommunicator master;
   master.Initialize(0, kNumWorker, "127.0.0.1:12334");
-  char* buffer = new char[5];
+  char buffer[6] = {0};
   int count = 0;
   for (;;) {
   	for (int rank = 1; rank <= kNumWorker; ++rank) {
@@ -0,0 +1,133 @@
+//------------------------------------------------------------------------------
+// Copyright (c) 2018 by contributors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//------------------------------------------------------------------------------
+
+/*
+This file tests the collective operations of SocketCommunicator.
+*/
+
+#include "src/network/socket_communicator.h"
+
+#include <unistd.h>
+#include <thread>
+#include <vector>
+
+#include "src/base/common.h"
+#include "src/network/communicator_test_util.h"
+#include "gtest/gtest.h"
+
+namespace xforest {
+
+const int kNumWorker = 3;
+const int kWorldSize = kNumWorker + 1;
+
+// Large buffers are sent by zero-copy if supported
+static void SetupSocket(Communicator* comm) {
+  SocketCommunicator* socket = static_cast<SocketCommunicator*>(comm);
+  socket->SetBufferSize(1 << 20);
+  socket->SetZeroCopy(true);
+}
+
+// Sum of 0 ... n
+static int SumTo(int n) {
+  return n * (n + 1) / 2;
+}
+
+static void TestAllreduce(Communicator* comm) {
+  int rank = comm->Rank();
+  // Ring and tree, and a length not divisible by the world size
+  AllreduceAlgo algos[] = {kAllreduceRing, kAllreduceTree, kAllreduceAuto};
+  for (int a = 0; a < 3; ++a) {
+    std::vector<int> data(1001);
+    for (size_t i = 0; i < data.size(); ++i) {
+      data[i] = i + rank;
+    }
+    comm->Allreduce(data.data(), data.size(), algos[a]);
+    for (size_t i = 0; i < data.size(); ++i) {
+      EXPECT_EQ(data[i], i * kWorldSize + SumTo(kNumWorker));
+    }
+    std::vector<real_t> fdata(3, 0.5 * rank);
+    comm->Allreduce(fdata.data(), fdata.size(), algos[a]);
+    for (size_t i = 0; i < fdata.size(); ++i) {
+      EXPECT_FLOAT_EQ(fdata[i], 0.5 * SumTo(kNumWorker));
+    }
+  }
+  // Large buffer uses ring in kAllreduceAuto
+  std::vector<real_t> big(100000, 1.0);
+  comm->Allreduce(big.data(), big.size());
+  for (size_t i = 0; i < big.size(); ++i) {
+    EXPECT_FLOAT_EQ(big[i], kWorldSize);
+  }
+}
+
+static void TestCompression(Communicator* comm) {
+  int rank = comm->Rank();
+  comm->SetCompression(true);
+  // Sparse, small and large counters
+  std::vector<uint32> data(100003, 0);
+  for (size_t i = 0; i < data.size(); i += 97) {
+    data[i] = rank + 1;
+  }
+  data[5] = 1000000 * (rank + 1);
+  comm->Allreduce(data.data(), data.size(), kAllreduceRing);
+  for (size_t i = 0; i < data.size(); ++i) {
+    uint32 expect = i % 97 == 0 ? SumTo(kWorldSize) : 0;
+    if (i == 5) {
+      expect = 1000000 * SumTo(kWorldSize);
+    }
+    EXPECT_EQ(data[i], expect);
+  }
+  // Other types are not encoded
+  std::vector<real_t> fdata(100000, 1.0);
+  comm->Allreduce(fdata.data(), fdata.size(), kAllreduceRing);
+  EXPECT_FLOAT_EQ(fdata[99999], kWorldSize);
+  comm->SetCompression(false);
+}
+
+// Workers start before the master, and retry to connect
+TEST(SocketCommunicator, LateMaster) {
+  std::vector<std::thread> threads;
+  for (int rank = kNumWorker; rank >= 0; --rank) {
+    threads.push_back(std::thread([rank]() {
+      if (rank == 0) {
+        sleep(1);  // workers are waiting
+      }
+      SocketCommunicator comm;
+      comm.SetTimeout(30);
+      comm.Initialize(rank, kNumWorker, "127.0.0.1:12361");
+      TestAllreduce(&comm);
+    }));
+  }
+  for (size_t i = 0; i < threads.size(); ++i) {
+    threads[i].join();
+  }
+}
+
+TEST(SocketCommunicator, Allreduce) {
+  RunAll("socket", kNumWorker, "127.0.0.1:12340", TestAllreduce,
+         SetupSocket);
+}
+
+TEST(SocketCommunicator, Collective) {
+  RunAll("socket", kNumWorker, "127.0.0.1:12341", TestCollective,
+         SetupSocket);
+}
+
+TEST(SocketCommunicator, Compression) {
+  RunAll("socket", kNumWorker, "127.0.0.1:12346", TestCompression,
+         SetupSocket);
+}
+
+}  // namespace xforest
@@ -21,10 +21,16 @@ This file is the implementation of TCPSocket class.
 #include "src/network/tcp_socket.h"
 
 #include <arpa/inet.h>
+#include <errno.h>
 #include <fcntl.h>
+#include <linux/errqueue.h>
 #include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
 #include <pthread.h>
+#include <string.h>
 #include <sys/socket.h>
+#include <sys/time.h>
 #include <unistd.h>
 
 namespace xforest {
@@ -32,6 +38,13 @@ namespace xforest {
 typedef struct sockaddr_in SAI;
 typedef struct sockaddr SA;
 
+// Smaller buffers are copied, since pinning pages and
+// waiting for the notification cost more than copying
+static const size_t kZeroCopyBytes = 64 * 1024;  // 64 KB
+// Maximal zero-copy sends in flight on a socket, whose
+// completions are reaped lazily by the later sends
+static const uint32 kZeroCopyWindow = 64;
+
 // ctor
 TCPSocket::TCPSocket() {
   // init socket
@@ -53,7 +66,7 @@ TCPSocket::~TCPSocket() {
   Close();
 }
 
-bool TCPSocket::Connect(const char * ip, uint16 port) {
+bool TCPSocket::Connect(const char * ip, uint16 port, bool log_error) {
   SAI sa_server;
   sa_server.sin_family      = AF_INET;
   sa_server.sin_port        = htons(port);
@@ -64,7 +77,9 @@ bool TCPSocket::Connect(const char * ip, uint16 port) {
     return true;
   }
 
-  LOG(ERROR) << "Failed connect to " << ip << ":" << port;
+  if (log_error) {
+    LOG(ERROR) << "Failed connect to " << ip << ":" << port;
+  }
   return false;
 }
 
@@ -103,7 +118,7 @@ bool TCPSocket::Accept(TCPSocket * socket, std::string * ip, uint16 * port) {
 
   sock_client = accept(socket_, reinterpret_cast<SA*>(&sa_client), &len);
   if (sock_client < 0) {
-    LOG(ERROR) << "Failed accept connection on " << ip << ":" << port;
+    LOG(ERROR) << "Failed accept connection: " << strerror(errno);
     return false;
   }
 
@@ -115,6 +130,7 @@ bool TCPSocket::Accept(TCPSocket * socket, std::string * ip, uint16 * port) {
   CHECK_NOTNULL(ip_client);
   ip->assign(ip_client);
   *port = ntohs(sa_client.sin_port);
+  socket->Close();
   socket->socket_ = sock_client;
 
   return true;
@@ -129,9 +145,9 @@ bool TCPSocket::SetBlocking(bool flag) {
   }
 
   if (flag) {
-    opts |= O_NONBLOCK;
-  } else {
     opts &= ~O_NONBLOCK;
+  } else {
+    opts |= O_NONBLOCK;
   }
 
   if (fcntl(socket_, F_SETFL, opts) < 0) {
@@ -142,9 +158,54 @@ bool TCPSocket::SetBlocking(bool flag) {
   return true;
 }
 
-void TCPSocket::SetTimeout(int timeout) {
-  setsockopt(socket_, SOL_SOCKET, SO_RCVTIMEO, 
-    reinterpret_cast<char*>(&timeout), sizeof(timeout));
+bool TCPSocket::SetTimeout(int timeout_ms) {
+  struct timeval tv;
+  tv.tv_sec = timeout_ms / 1000;
+  tv.tv_usec = (timeout_ms % 1000) * 1000;
+  if (setsockopt(socket_, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv)) < 0) {
+    LOG(ERROR) << "Failed to set timeout: " << strerror(errno);
+    return false;
+  }
+  return true;
+}
+
+bool TCPSocket::SetNoDelay(bool flag) {
+  int on = flag ? 1 : 0;
+  if (setsockopt(socket_, IPPROTO_TCP, TCP_NODELAY, &on, sizeof(on)) < 0) {
+    LOG(ERROR) << "Failed to set TCP_NODELAY: " << strerror(errno);
+    return false;
+  }
+  return true;
+}
+
+bool TCPSocket::SetBufferSize(int send_size, int recv_size) {
+  if (send_size > 0 &&
+      setsockopt(socket_, SOL_SOCKET, SO_SNDBUF, 
+                 &send_size, sizeof(send_size)) < 0) {
+    LOG(ERROR) << "Failed to set SO_SNDBUF: " << strerror(errno);
+    return false;
+  }
+  if (recv_size > 0 &&
+      setsockopt(socket_, SOL_SOCKET, SO_RCVBUF, 
+                 &recv_size, sizeof(recv_size)) < 0) {
+    LOG(ERROR) << "Failed to set SO_RCVBUF: " << strerror(errno);
+    return false;
+  }
+  return true;
+}
+
+bool TCPSocket::SetZeroCopy(bool flag) {
+#if defined(SO_ZEROCOPY) && defined(MSG_ZEROCOPY)
+  int on = flag ? 1 : 0;
+  if (setsockopt(socket_, SOL_SOCKET, SO_ZEROCOPY, &on, sizeof(on)) < 0) {
+    LOG(ERROR) << "Failed to set SO_ZEROCOPY: " << strerror(errno);
+    return false;
+  }
+  zero_copy_ = flag;
+  return true;
+#else
+  return !flag;
+#endif
 }
 
 bool TCPSocket::ShutDown(int ways) {
@@ -153,21 +214,173 @@ bool TCPSocket::ShutDown(int ways) {
 
 void TCPSocket::Close() {
   if (socket_ >= 0) {
+    WaitZeroCopy();
     CHECK_EQ(0, close(socket_));
     socket_ = -1;
   }
 }
 
-int TCPSocket::Send(const char * data, int len_data) {
-  return send(socket_, data, len_data, 0);
+int TCPSocket::Send(const char * data, int len_data, int flags) {
+  return send(socket_, data, len_data, flags);
 }
 
-int TCPSocket::Receive(char * buffer, int size_buffer) {
-  return recv(socket_, buffer, size_buffer, 0);
+int TCPSocket::Receive(char * buffer, int size_buffer, int flags) {
+  return recv(socket_, buffer, size_buffer, flags);
+}
+
+bool TCPSocket::SendAll(const char * data, int len_data) {
+  struct iovec iov;
+  iov.iov_base = const_cast<char*>(data);
+  iov.iov_len = len_data;
+  return SendIov(&iov, 1);
+}
+
+bool TCPSocket::ReceiveAll(char * buffer, int len_buffer) {
+  int recieved_bytes = 0;
+  while (recieved_bytes < len_buffer) {
+    int tmp = recv(socket_, buffer + recieved_bytes, 
+                   len_buffer - recieved_bytes, 0);
+    if (tmp < 0 && errno == EINTR) {
+      continue;
+    }
+    if (tmp <= 0) {
+      LOG(ERROR) << "Failed to receive data: " 
+                 << (tmp == 0 ? "connection closed" : strerror(errno));
+      return false;
+    }
+    recieved_bytes += tmp;
+  }
+  return true;
+}
+
+bool TCPSocket::SendMessage(const char * data, int len_data) {
+  CHECK_GE(len_data, 0);
+  uint32 header = len_data;
+  struct iovec iov[2];
+  iov[0].iov_base = &header;
+  iov[0].iov_len = sizeof(header);
+  iov[1].iov_base = const_cast<char*>(data);
+  iov[1].iov_len = len_data;
+  return SendIov(iov, 2);
+}
+
+bool TCPSocket::ReceiveMessage(std::string * msg) {
+  CHECK_NOTNULL(msg);
+  uint32 header = 0;
+  if (!ReceiveAll(reinterpret_cast<char*>(&header), sizeof(header))) {
+    return false;
+  }
+  msg->resize(header);
+  return header == 0 || ReceiveAll(&(*msg)[0], header);
+}
+
+bool TCPSocket::SendIov(struct iovec * iov, int iov_len) {
+  size_t total = 0;
+  for (int i = 0; i < iov_len; ++i) {
+    total += iov[i].iov_len;
+  }
+  int flags = MSG_NOSIGNAL;
+#ifdef MSG_ZEROCOPY
+  if (zero_copy_ && total >= kZeroCopyBytes) {
+    flags |= MSG_ZEROCOPY;
+  }
+#endif
+  struct msghdr msg;
+  memset(&msg, 0, sizeof(msg));
+  msg.msg_iov = iov;
+  msg.msg_iovlen = iov_len;
+  while (total > 0) {
+    ssize_t tmp = sendmsg(socket_, &msg, flags);
+    if (tmp < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+#ifdef MSG_ZEROCOPY
+      // Out of the memory to pin pages, copy the rest
+      if (errno == ENOBUFS && (flags & MSG_ZEROCOPY)) {
+        flags &= ~MSG_ZEROCOPY;
+        continue;
+      }
+#endif
+      LOG(ERROR) << "Failed to send data: " << strerror(errno);
+      return false;
+    }
+#ifdef MSG_ZEROCOPY
+    if (flags & MSG_ZEROCOPY) {
+      zc_sent_++;
+    }
+#endif
+    total -= tmp;
+    // Skip the sent bytes
+    while (msg.msg_iovlen > 0 && 
+           (size_t)tmp >= msg.msg_iov->iov_len) {
+      tmp -= msg.msg_iov->iov_len;
+      msg.msg_iov++;
+      msg.msg_iovlen--;
+    }
+    if (tmp > 0) {
+      msg.msg_iov->iov_base = 
+        reinterpret_cast<char*>(msg.msg_iov->iov_base) + tmp;
+      msg.msg_iov->iov_len -= tmp;
+    }
+  }
+  // Do not wait the ACK of peer, which releases the pages
+  return ReapZeroCopy(0, false) && ReapZeroCopy(kZeroCopyWindow, true);
+}
+
+bool TCPSocket::WaitZeroCopy() {
+  return ReapZeroCopy(0, true);
+}
+
+bool TCPSocket::ReapZeroCopy(uint32 max_pending, bool block) {
+#ifdef SO_EE_ORIGIN_ZEROCOPY
+  while (zc_sent_ - zc_done_ > max_pending) {
+    char control[128];
+    struct msghdr msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_control = control;
+    msg.msg_controllen = sizeof(control);
+    if (recvmsg(socket_, &msg, MSG_ERRQUEUE | MSG_DONTWAIT) < 0) {
+      if (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR) {
+        if (!block) {
+          return true;
+        }
+        // POLLERR is reported when the error queue is not empty
+        struct pollfd pfd;
+        pfd.fd = socket_;
+        pfd.events = 0;
+        poll(&pfd, 1, -1);
+        continue;
+      }
+      LOG(ERROR) << "Failed to wait zero-copy send: " << strerror(errno);
+      return false;
+    }
+    for (struct cmsghdr* cm = CMSG_FIRSTHDR(&msg); cm != nullptr;
+         cm = CMSG_NXTHDR(&msg, cm)) {
+      struct sock_extended_err* err = 
+        reinterpret_cast<struct sock_extended_err*>(CMSG_DATA(cm));
+      if (err->ee_origin == SO_EE_ORIGIN_ZEROCOPY) {
+        // Sends [ee_info, ee_data] are released
+        zc_done_ = err->ee_data + 1;
+      }
+    }
+  }
+#endif
+  return true;
 }
 
 int TCPSocket::Socket() const {
   return socket_;
 }
 
+uint16 TCPSocket::LocalPort() const {
+  SAI sa_local;
+  socklen_t len = sizeof(sa_local);
+  if (getsockname(socket_, reinterpret_cast<SA*>(&sa_local), &len) < 0) {
+    LOG(ERROR) << "Failed to get local address of socket fd: " << socket_;
+    return 0;
+  }
+  return ntohs(sa_local.sin_port);
+}
+
 }  // namespace xforest
\ No newline at end of file
@@ -22,6 +22,7 @@ This file defines the TCPSocket class.
 #define XFOREST_NETWORK_TCPSOCKET_H_
 
 #include <sys/socket.h>
+#include <sys/uio.h>
 #include <string>
 
 #include "src/base/common.h"
@@ -43,8 +44,9 @@ class TCPSocket {
 
   // Return value of following functions:
   //  true for success and false for failure
-  // connect to a given server address
-  bool Connect(const char * ip, uint16 port);
+  // connect to a given server address. The failure is
+  // not logged if log_error is false (e.g., for retrying).
+  bool Connect(const char * ip, uint16 port, bool log_error = true);
 
   // bind on the given IP ans PORT
   bool Bind(const char * ip, uint16 port);
@@ -59,12 +61,35 @@ class TCPSocket {
               std::string * ip_client,
               uint16 * port_client);
 
-  // SetBlocking() is needed refering to this example of epoll:
+  // SetBlocking(false) makes the socket non-blocking, which is
+  // needed refering to this example of epoll:
   // http://www.kernel.org/doc/man-pages/online/pages/man4/epoll.4.html
   bool SetBlocking(bool flag);
 
-  // Set timeout for socket
-  void SetTimeout(int timeout);
+  // Set timeout (milliseconds) of receive and accept.
+  // 0 means waiting forever.
+  bool SetTimeout(int timeout_ms);
+
+  // Disable Nagle's algorithm, so that small messages (e.g.,
+  // split decisions) are sent at once rather than delayed
+  // waiting for the ACK of the previous segment.
+  bool SetNoDelay(bool flag);
+
+  // Set the size of kernel send and receive buffers, which
+  // should be called before Connect() or Listen(). 0 keeps
+  // the default size, which is tuned by the kernel.
+  bool SetBufferSize(int send_size, int recv_size);
+
+  // Send large buffers with MSG_ZEROCOPY (Linux 4.14+), which
+  // pins the user pages instead of copying them to the kernel.
+  // The sends return before the kernel releases the pages, so
+  // the sent buffers must not be modified until WaitZeroCopy().
+  // Return false if it is not supported.
+  bool SetZeroCopy(bool flag);
+
+  // Wait the kernel to release the pages of zero-copy sends,
+  // so that the caller can reuse the buffers. Close() calls it.
+  bool WaitZeroCopy();
 
   // Shut down one or both halves of the connection.
   // If ways is SHUT_RD, further receives are disallowed.
@@ -72,21 +97,48 @@ class TCPSocket {
   // If ways is SHUT_RDWR, further sends and receives are disallowed.
   bool ShutDown(int ways);
 
-  // close socket
+  // close socket, after the zero-copy sends are released
   void Close();
 
   // send/receive data:
   // return number of bytes read or written if OK, -1 on error
   // caller is responsible for checking that all data has been sent/received,
-  // if not, extra send/receive should be invoked
-  int Send(const char * data, int len_data);
-  int Receive(char * buffer, int size_buffer);
+  // if not, extra send/receive should be invoked.
+  // flags are passed to send()/recv(), e.g., MSG_DONTWAIT.
+  int Send(const char * data, int len_data, int flags = 0);
+  int Receive(char * buffer, int size_buffer, int flags = 0);
+
+  // Send or receive all of the data on blocking socket.
+  // Return false on error or closed connection.
+  bool SendAll(const char * data, int len_data);
+  bool ReceiveAll(char * buffer, int len_buffer);
+
+  // Framed message: a uint32 length header followed by the
+  // payload. The header and payload are sent by one sendmsg()
+  // without copying them into a single buffer.
+  // Return false on error or closed connection.
+  bool SendMessage(const char * data, int len_data);
+  bool ReceiveMessage(std::string * msg);
 
   // return socket's file descriptor
   int Socket() const;
 
+  // return the local port of a bound socket, 0 on error
+  uint16 LocalPort() const;
+
  private:
   SOCKET socket_;
+  bool zero_copy_ = false;  // Send large buffers with MSG_ZEROCOPY
+  uint32 zc_sent_ = 0;      // Number of zero-copy sendmsg() calls
+  uint32 zc_done_ = 0;      // Number of released zero-copy sends
+
+  // Send all the buffers of iov, which is modified
+  bool SendIov(struct iovec * iov, int iov_len);
+
+  // Reap the released zero-copy sends until at most max_pending
+  // sends are in flight. Without block, only reap the released
+  // ones and return.
+  bool ReapZeroCopy(uint32 max_pending, bool block);
 
   DISALLOW_COPY_AND_ASSIGN(TCPSocket);
 };
@@ -23,6 +23,7 @@ This file tests the TCPSocket class.
 #include <string.h>
 #include <unistd.h>
 #include <string>
+#include <thread>
 
 #include "src/base/common.h"
 #include "gtest/gtest.h"
@@ -143,4 +144,43 @@ TEST(TCPSocket, SendRecieve) {
     }
   }
   wait(0);
-}
\ No newline at end of file
+}
+
+TEST(TCPSocket, Message) {
+  TCPSocket server;
+  ASSERT_TRUE(server.SetTimeout(60 * 1000));
+  ASSERT_TRUE(server.SetBufferSize(1 << 20, 1 << 20));
+  ASSERT_TRUE(server.Bind("127.0.0.1", 11224));
+  ASSERT_TRUE(server.Listen(3));
+  string big(kDataLength, 'y');
+  std::thread client_thread([&big]() {
+    TCPSocket client;
+    ASSERT_TRUE(client.Connect("127.0.0.1", 11224));
+    ASSERT_TRUE(client.SetNoDelay(true));
+    // Zero-copy is optional, the data is the same
+    client.SetZeroCopy(true);
+    ASSERT_TRUE(client.SendMessage("0123456789", 10));
+    ASSERT_TRUE(client.SendMessage(nullptr, 0));
+    ASSERT_TRUE(client.SendMessage(big.data(), big.size()));
+    ASSERT_TRUE(client.SendAll("abc", 3));
+    // big must stay alive until the kernel releases it
+    EXPECT_TRUE(client.WaitZeroCopy());
+  });
+  TCPSocket conn;
+  string cl_ip;
+  uint16 cl_port;
+  ASSERT_TRUE(server.Accept(&conn, &cl_ip, &cl_port));
+  string msg;
+  ASSERT_TRUE(conn.ReceiveMessage(&msg));
+  EXPECT_EQ(msg, string("0123456789"));
+  ASSERT_TRUE(conn.ReceiveMessage(&msg));
+  EXPECT_TRUE(msg.empty());
+  ASSERT_TRUE(conn.ReceiveMessage(&msg));
+  EXPECT_TRUE(msg == big);
+  char buf[3];
+  ASSERT_TRUE(conn.ReceiveAll(buf, 3));
+  EXPECT_EQ(string(buf, 3), string("abc"));
+  client_thread.join();
+  // Connection is closed by client
+  EXPECT_FALSE(conn.ReceiveMessage(&msg));
+}
@@ -0,0 +1,195 @@
+//------------------------------------------------------------------------------
+// Copyright (c) 2018 by contributors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//------------------------------------------------------------------------------
+
+/*
+This file is the implementation of AsyncFile class.
+*/
+
+#include "src/reader/async_file.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "src/base/profiler.h"
+
+#ifdef XFOREST_USE_IO_URING
+#include <liburing.h>
+#endif
+
+namespace xforest {
+
+// Read len bytes at offset until the end of file
+static int64 PreadFull(int fd, char* buf, uint64 len, uint64 offset) {
+  TRACE_ZONE("pread");
+  uint64 read_bytes = 0;
+  while (read_bytes < len) {
+    ssize_t ret = pread(fd, buf + read_bytes,
+                        len - read_bytes,
+                        offset + read_bytes);
+    if (ret < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      return -errno;
+    }
+    if (ret == 0) {  // End of file
+      break;
+    }
+    read_bytes += ret;
+  }
+  return read_bytes;
+}
+
+// dctor
+AsyncFile::~AsyncFile() {
+  Close();
+}
+
+// Open file with at most queue_depth outstanding reads
+void AsyncFile::Open(const std::string& filename, int queue_depth) {
+  CHECK_GT(queue_depth, 0);
+  CHECK_EQ(fd_, -1);
+  fd_ = open(filename.c_str(), O_RDONLY);
+  if (fd_ < 0) {
+    LOG(FATAL) << "Cannot open file: " << filename;
+  }
+  queue_depth_ = queue_depth;
+  if (!InitRing()) {
+    pool_.reset(new ThreadPool(queue_depth_));
+  }
+}
+
+// Initialize io_uring. Return false if it is not supported.
+bool AsyncFile::InitRing() {
+#ifdef XFOREST_USE_IO_URING
+  struct io_uring* ring = new struct io_uring;
+  int ret = io_uring_queue_init(queue_depth_, ring, 0);
+  if (ret < 0) {
+    LOG(WARNING) << "io_uring is not available (" << strerror(-ret)
+                 << "), fall back to pread.";
+    delete ring;
+    return false;
+  }
+  ring_ = ring;
+  return true;
+#else
+  return false;
+#endif
+}
+
+// Wait for one completion of io_uring
+void AsyncFile::ReapRing() {
+#ifdef XFOREST_USE_IO_URING
+  struct io_uring* ring = static_cast<struct io_uring*>(ring_);
+  struct io_uring_cqe* cqe = nullptr;
+  int ret = io_uring_wait_cqe(ring, &cqe);
+  if (ret < 0) {
+    LOG(FATAL) << "io_uring_wait_cqe() failed: " << strerror(-ret);
+  }
+  int id = static_cast<int>(
+      reinterpret_cast<intptr_t>(io_uring_cqe_get_data(cqe)));
+  Request& request = requests_[id];
+  request.done = true;
+  request.result = cqe->res;
+  io_uring_cqe_seen(ring, cqe);
+#endif
+}
+
+// Submit a read of len bytes at offset to buf
+int AsyncFile::Submit(char* buf, uint64 len, uint64 offset) {
+  CHECK_NOTNULL(buf);
+  CHECK_NE(fd_, -1);
+  int id = next_id_++;
+  Request& request = requests_[id];
+  request.buf = buf;
+  request.len = len;
+  request.offset = offset;
+#ifdef XFOREST_USE_IO_URING
+  if (ring_ != nullptr) {
+    struct io_uring* ring = static_cast<struct io_uring*>(ring_);
+    struct io_uring_sqe* sqe = io_uring_get_sqe(ring);
+    while (sqe == nullptr) {  // Submission queue is full
+      ReapRing();
+      sqe = io_uring_get_sqe(ring);
+    }
+    io_uring_prep_read(sqe, fd_, buf, len, offset);
+    io_uring_sqe_set_data(sqe, reinterpret_cast<void*>(
+        static_cast<intptr_t>(id)));
+    CHECK_GE(io_uring_submit(ring), 0);
+    return id;
+  }
+#endif
+  request.future = pool_->enqueue(PreadFull, fd_, buf, len, offset);
+  return id;
+}
+
+// Wait for the request and return the read bytes
+uint64 AsyncFile::Wait(int id) {
+  auto it = requests_.find(id);
+  CHECK(it != requests_.end());
+  Request& request = it->second;
+  if (ring_ != nullptr) {
+    while (!request.done) {
+      ReapRing();
+    }
+  } else {
+    request.result = request.future.get();
+  }
+  if (request.result < 0) {
+    LOG(FATAL) << "Failed to read file: " << strerror(-request.result);
+  }
+  // io_uring may return a short read before the end of file
+  uint64 read_bytes = request.result;
+  if (read_bytes > 0 && read_bytes < request.len) {
+    int64 ret = PreadFull(fd_, request.buf + read_bytes,
+                          request.len - read_bytes,
+                          request.offset + read_bytes);
+    CHECK_GE(ret, 0);
+    read_bytes += ret;
+  }
+  requests_.erase(it);
+  return read_bytes;
+}
+
+// Wait all requests and close file
+void AsyncFile::Close() {
+  if (fd_ < 0) {
+    return;
+  }
+  while (!requests_.empty()) {
+    Wait(requests_.begin()->first);
+  }
+#ifdef XFOREST_USE_IO_URING
+  if (ring_ != nullptr) {
+    struct io_uring* ring = static_cast<struct io_uring*>(ring_);
+    io_uring_queue_exit(ring);
+    delete ring;
+    ring_ = nullptr;
+  }
+#endif
+  pool_.reset();
+  CHECK_EQ(0, close(fd_));
+  fd_ = -1;
+}
+
+// Name of the backend
+std::string AsyncFile::Backend() const {
+  return ring_ != nullptr ? "io_uring" : "pread";
+}
+
+}  // namespace xforest
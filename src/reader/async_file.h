@@ -0,0 +1,103 @@
+//------------------------------------------------------------------------------
+// Copyright (c) 2018 by contributors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//------------------------------------------------------------------------------
+
+/*
+This file defines the AsyncFile class, which issues many
+outstanding reads on one file.
+*/
+
+#ifndef XFOREST_READER_ASYNC_FILE_H_
+#define XFOREST_READER_ASYNC_FILE_H_
+
+#include <future>
+#include <string>
+#include <unordered_map>
+
+#include "src/base/common.h"
+#include "src/base/scoped_ptr.h"
+#include "src/base/thread_pool.h"
+
+namespace xforest {
+
+//------------------------------------------------------------------------------
+// AsyncFile reads a file asynchronously. It uses io_uring if
+// xForest is built with liburing (XFOREST_USE_IO_URING) and the
+// kernel supports it. Otherwise, it falls back to a thread pool
+// that issues pread() calls. We can use it like this:
+//
+//   AsyncFile file;
+//   file.Open("train.csv", 8);
+//   int id_1 = file.Submit(buf_1, len, 0);
+//   int id_2 = file.Submit(buf_2, len, len);
+//   uint64 size_1 = file.Wait(id_1);
+//   uint64 size_2 = file.Wait(id_2);
+//
+// The buffer of a request cannot be used until Wait() returns.
+//------------------------------------------------------------------------------
+class AsyncFile {
+ public:
+  // ctor and dctor
+  AsyncFile() {}
+  ~AsyncFile();
+
+  // Open file with at most queue_depth outstanding reads
+  void Open(const std::string& filename, int queue_depth);
+
+  // Submit a read of len bytes at offset to buf.
+  // Return the request id.
+  int Submit(char* buf, uint64 len, uint64 offset);
+
+  // Wait for the request and return the read bytes,
+  // which is less than len only at the end of file.
+  uint64 Wait(int id);
+
+  // Wait all requests and close file
+  void Close();
+
+  // Name of the backend: "io_uring" or "pread"
+  std::string Backend() const;
+
+ protected:
+  // One read request
+  struct Request {
+    char* buf = nullptr;
+    uint64 len = 0;
+    uint64 offset = 0;
+    bool done = false;
+    int64 result = 0;
+    std::future<int64> future;
+  };
+
+  int fd_ = -1;                  // file descriptor
+  int queue_depth_ = 0;          // maximal outstanding reads
+  int next_id_ = 0;              // id of next request
+  void* ring_ = nullptr;         // io_uring context (nullptr for pread)
+  scoped_ptr<ThreadPool> pool_;  // thread pool of pread backend
+  std::unordered_map<int, Request> requests_;  // outstanding requests
+
+ private:
+  // Initialize io_uring. Return false if it is not supported.
+  bool InitRing();
+
+  // Wait for one completion of io_uring
+  void ReapRing();
+
+  DISALLOW_COPY_AND_ASSIGN(AsyncFile);
+};
+
+}  // namespace xforest
+
+#endif  // XFOREST_READER_ASYNC_FILE_H_
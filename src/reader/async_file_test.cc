@@ -0,0 +1,65 @@
+//------------------------------------------------------------------------------
+// Copyright (c) 2018 by contributors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//------------------------------------------------------------------------------
+
+/*
+This file tests the AsyncFile class.
+*/
+
+#include "src/reader/async_file.h"
+
+#include <string>
+#include <vector>
+
+#include "src/base/common.h"
+#include "src/base/file_util.h"
+#include "gtest/gtest.h"
+
+using xforest::AsyncFile;
+
+const uint64 kFileSize = 1000003;
+const uint64 kChunk = 4096;
+
+TEST(AsyncFile, ReadFile) {
+  std::string filename = "/tmp/async_file_test";
+  std::vector<char> data(kFileSize);
+  for (uint64 i = 0; i < kFileSize; ++i) {
+    data[i] = static_cast<char>(i % 251);
+  }
+  FILE* file = OpenFileOrDie(filename.c_str(), "w");
+  WriteDataToDisk(file, data.data(), data.size());
+  Close(file);
+  AsyncFile async_file;
+  async_file.Open(filename, 16);
+  std::cout << "Backend: " << async_file.Backend() << std::endl;
+  // Submit all reads first, and then wait in reverse order
+  uint64 num_chunks = (kFileSize + kChunk - 1) / kChunk + 1;
+  std::vector<char> buf(num_chunks * kChunk);
+  std::vector<int> ids;
+  for (uint64 i = 0; i < num_chunks; ++i) {
+    ids.push_back(async_file.Submit(buf.data() + i * kChunk,
+                                    kChunk, i * kChunk));
+  }
+  uint64 total = 0;
+  for (uint64 i = num_chunks; i > 0; --i) {
+    total += async_file.Wait(ids[i-1]);
+  }
+  EXPECT_EQ(total, kFileSize);
+  for (uint64 i = 0; i < kFileSize; ++i) {
+    ASSERT_EQ(buf[i], data[i]);
+  }
+  async_file.Close();
+  RemoveFile(filename.c_str());
+}
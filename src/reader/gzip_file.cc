@@ -0,0 +1,316 @@
+//------------------------------------------------------------------------------
+// Copyright (c) 2018 by contributors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//------------------------------------------------------------------------------
+
+/*
+This file is the implementation of GzipFile class.
+*/
+
+#include "src/reader/gzip_file.h"
+
+#include <fcntl.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <algorithm>
+
+#include "src/base/profiler.h"
+
+#ifdef XFOREST_USE_ZLIB
+#include <zlib.h>
+#endif
+
+namespace xforest {
+
+// Compressed bytes read by one decompression task
+static const uint64 kTaskSize = 4 * 1024 * 1024;  // 4 MB
+
+// Compressed bytes read by the zlib stream at a time
+static const uint64 kStreamBufferSize = 1024 * 1024;  // 1 MB
+
+// Size of gzip member header without extra field
+static const uint64 kHeaderSize = 12;
+
+// Size of gzip member trailer (CRC32 and ISIZE)
+static const uint64 kTrailerSize = 8;
+
+// Check whether the file is a gzip file by its name
+bool IsGzipFile(const std::string& filename) {
+  return filename.size() > 3 &&
+         filename.compare(filename.size() - 3, 3, ".gz") == 0;
+}
+
+// Read a little-endian integer
+static inline uint32 ReadLE(const unsigned char* p, int bytes) {
+  uint32 val = 0;
+  for (int i = bytes - 1; i >= 0; --i) {
+    val = (val << 8) | p[i];
+  }
+  return val;
+}
+
+// Return the total size of the BGZF member at p, or 0 if
+// the header (avail bytes) is not a complete BGZF header.
+static uint64 BGZFMemberSize(const unsigned char* p, uint64 avail) {
+  if (avail < kHeaderSize ||
+      p[0] != 0x1f || p[1] != 0x8b || p[2] != 8 || !(p[3] & 4)) {
+    return 0;
+  }
+  uint64 xlen = ReadLE(p + 10, 2);
+  if (avail < kHeaderSize + xlen) {
+    return 0;
+  }
+  // Find the 'BC' subfield which records the member size
+  uint64 pos = kHeaderSize;
+  while (pos + 4 <= kHeaderSize + xlen) {
+    uint64 slen = ReadLE(p + pos + 2, 2);
+    if (p[pos] == 'B' && p[pos+1] == 'C' && slen == 2) {
+      return ReadLE(p + pos + 4, 2) + 1;
+    }
+    pos += 4 + slen;
+  }
+  return 0;
+}
+
+#ifdef XFOREST_USE_ZLIB
+// Decompress a series of complete BGZF members
+static std::vector<char> InflateMembers(const std::vector<char>& data) {
+  TRACE_ZONE("inflate");
+  std::vector<char> out;
+  z_stream zs;
+  memset(&zs, 0, sizeof(zs));
+  CHECK_EQ(Z_OK, inflateInit2(&zs, -MAX_WBITS));
+  uint64 pos = 0;
+  while (pos < data.size()) {
+    const unsigned char* p =
+      reinterpret_cast<const unsigned char*>(data.data()) + pos;
+    uint64 size = BGZFMemberSize(p, data.size() - pos);
+    uint64 xlen = ReadLE(p + 10, 2);
+    uint32 crc = ReadLE(p + size - kTrailerSize, 4);
+    uint32 isize = ReadLE(p + size - 4, 4);
+    uint64 out_pos = out.size();
+    out.resize(out_pos + isize);
+    if (isize > 0) {
+      CHECK_EQ(Z_OK, inflateReset(&zs));
+      zs.next_in = const_cast<Bytef*>(p + kHeaderSize + xlen);
+      zs.avail_in = size - kHeaderSize - xlen - kTrailerSize;
+      zs.next_out = reinterpret_cast<Bytef*>(out.data() + out_pos);
+      zs.avail_out = isize;
+      if (inflate(&zs, Z_FINISH) != Z_STREAM_END || zs.avail_out != 0) {
+        LOG(FATAL) << "Failed to decompress BGZF member.";
+      }
+      uLong check = crc32(0L, reinterpret_cast<Bytef*>(out.data() + out_pos),
+                          isize);
+      if (check != crc) {
+        LOG(FATAL) << "CRC error in BGZF member.";
+      }
+    }
+    pos += size;
+  }
+  inflateEnd(&zs);
+  return out;
+}
+#endif
+
+// dctor
+GzipFile::~GzipFile() {
+  Close();
+}
+
+// Open gzip file with num_threads decompression threads
+void GzipFile::Open(const std::string& filename, int num_threads) {
+#ifdef XFOREST_USE_ZLIB
+  CHECK_GT(num_threads, 0);
+  CHECK_EQ(fd_, -1);
+  fd_ = open(filename.c_str(), O_RDONLY);
+  if (fd_ < 0) {
+    LOG(FATAL) << "Cannot open file: " << filename;
+  }
+  struct stat st;
+  CHECK_EQ(0, fstat(fd_, &st));
+  file_size_ = st.st_size;
+  eof_ = false;
+  // Check the header of the first member
+  unsigned char header[64];
+  ssize_t len = pread(fd_, header, sizeof(header), 0);
+  CHECK_GE(len, 0);
+  bgzf_ = BGZFMemberSize(header, len) > 0;
+  if (bgzf_) {
+    scan_offset_ = 0;
+    max_tasks_ = 2 * num_threads;
+    pool_.reset(new ThreadPool(num_threads));
+    out_.clear();
+    out_pos_ = 0;
+  } else {
+    z_stream* zs = new z_stream;
+    memset(zs, 0, sizeof(z_stream));
+    // 32 means detecting gzip header automatically
+    CHECK_EQ(Z_OK, inflateInit2(zs, MAX_WBITS + 32));
+    stream_ = zs;
+    in_.resize(kStreamBufferSize);
+    member_end_ = false;
+  }
+#else
+  LOG(FATAL) << "Cannot read " << filename
+             << ": xForest is built without zlib.";
+#endif
+}
+
+// Read at most len bytes of decompressed data to buf
+uint64 GzipFile::Read(char* buf, uint64 len) {
+  CHECK_NOTNULL(buf);
+  CHECK_NE(fd_, -1);
+  return bgzf_ ? ReadBGZF(buf, len) : ReadStream(buf, len);
+}
+
+// Reach the end of file
+bool GzipFile::Eof() const {
+  if (bgzf_) {
+    return out_pos_ == out_.size() &&
+           tasks_.empty() &&
+           scan_offset_ >= file_size_;
+  }
+  return eof_;
+}
+
+// Read and submit BGZF members until the queue is full
+void GzipFile::SubmitTasks() {
+#ifdef XFOREST_USE_ZLIB
+  while (tasks_.size() < max_tasks_ && scan_offset_ < file_size_) {
+    uint64 avail = std::min(kTaskSize, file_size_ - scan_offset_);
+    std::vector<char> data(avail);
+    CHECK_EQ(avail, pread(fd_, data.data(), avail, scan_offset_));
+    // Only keep complete members
+    const unsigned char* p =
+      reinterpret_cast<const unsigned char*>(data.data());
+    uint64 pos = 0;
+    for (;;) {
+      uint64 size = BGZFMemberSize(p + pos, avail - pos);
+      if (size == 0 || pos + size > avail) {
+        break;
+      }
+      pos += size;
+    }
+    uint64 end = pos;
+    // Skip the zero padding after a member, like gzip does
+    while (pos < avail && p[pos] == 0) {
+      pos++;
+    }
+    if (pos == 0) {
+      LOG(FATAL) << "Broken BGZF member at offset " << scan_offset_;
+    }
+    scan_offset_ += pos;
+    if (end > 0) {
+      data.resize(end);
+      tasks_.push_back(pool_->enqueue(InflateMembers, std::move(data)));
+    }
+  }
+#endif
+}
+
+// Read from BGZF file
+uint64 GzipFile::ReadBGZF(char* buf, uint64 len) {
+  uint64 read_len = 0;
+  while (read_len < len) {
+    if (out_pos_ == out_.size()) {
+      // Current block is consumed, wait for the next block
+      SubmitTasks();
+      if (tasks_.empty()) {
+        break;
+      }
+      out_ = tasks_.front().get();
+      tasks_.pop_front();
+      out_pos_ = 0;
+      SubmitTasks();
+      continue;
+    }
+    uint64 size = std::min(len - read_len, out_.size() - out_pos_);
+    memcpy(buf + read_len, out_.data() + out_pos_, size);
+    out_pos_ += size;
+    read_len += size;
+  }
+  return read_len;
+}
+
+// Read from a single zlib stream
+uint64 GzipFile::ReadStream(char* buf, uint64 len) {
+#ifdef XFOREST_USE_ZLIB
+  z_stream* zs = static_cast<z_stream*>(stream_);
+  zs->next_out = reinterpret_cast<Bytef*>(buf);
+  zs->avail_out = len;
+  while (zs->avail_out > 0 && !eof_) {
+    if (zs->avail_in == 0) {
+      ssize_t size = read(fd_, in_.data(), in_.size());
+      CHECK_GE(size, 0);
+      if (size == 0) {
+        if (!member_end_) {
+          LOG(FATAL) << "Unexpected end of gzip file.";
+        }
+        eof_ = true;
+        break;
+      }
+      zs->next_in = reinterpret_cast<Bytef*>(in_.data());
+      zs->avail_in = size;
+    }
+    if (member_end_) {
+      // Skip the zero padding after a member, like gzip does
+      while (zs->avail_in > 0 && *zs->next_in == 0) {
+        zs->next_in++;
+        zs->avail_in--;
+      }
+      if (zs->avail_in == 0) {
+        continue;
+      }
+    }
+    int ret = inflate(zs, Z_NO_FLUSH);
+    if (ret == Z_STREAM_END) {
+      // The file may have more members
+      member_end_ = true;
+      CHECK_EQ(Z_OK, inflateReset(zs));
+    } else if (ret == Z_OK) {
+      member_end_ = false;
+    } else if (ret != Z_BUF_ERROR) {
+      LOG(FATAL) << "Failed to decompress gzip file: " << ret;
+    }
+  }
+  return len - zs->avail_out;
+#else
+  return 0;
+#endif
+}
+
+// Close file
+void GzipFile::Close() {
+  if (fd_ < 0) {
+    return;
+  }
+  // Finish the running tasks before closing file
+  pool_.reset();
+  tasks_.clear();
+  out_.clear();
+  out_pos_ = 0;
+#ifdef XFOREST_USE_ZLIB
+  if (stream_ != nullptr) {
+    z_stream* zs = static_cast<z_stream*>(stream_);
+    inflateEnd(zs);
+    delete zs;
+    stream_ = nullptr;
+  }
+#endif
+  CHECK_EQ(0, close(fd_));
+  fd_ = -1;
+}
+
+}  // namespace xforest
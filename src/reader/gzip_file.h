@@ -0,0 +1,112 @@
+//------------------------------------------------------------------------------
+// Copyright (c) 2018 by contributors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//------------------------------------------------------------------------------
+
+/*
+This file defines the GzipFile class, which reads the
+decompressed data of a gzip file.
+*/
+
+#ifndef XFOREST_READER_GZIP_FILE_H_
+#define XFOREST_READER_GZIP_FILE_H_
+
+#include <deque>
+#include <future>
+#include <string>
+#include <vector>
+
+#include "src/base/common.h"
+#include "src/base/scoped_ptr.h"
+#include "src/base/thread_pool.h"
+
+namespace xforest {
+
+// Check whether the file is a gzip file by its name
+bool IsGzipFile(const std::string& filename);
+
+//------------------------------------------------------------------------------
+// GzipFile reads a gzip file (which requires zlib) like this:
+//
+//   GzipFile file;
+//   file.Open("train.csv.gz", 4);
+//   while (!file.Eof()) {
+//     uint64 len = file.Read(buf, buf_size);
+//     ... // use decompressed data
+//   }
+//
+// If the file is in BGZF format (a series of gzip members, each
+// records its compressed size in the header), the members are
+// read ahead and decompressed in parallel by a thread pool. Any
+// other gzip file (including multi-member ones) is decompressed
+// by a single zlib stream.
+//------------------------------------------------------------------------------
+class GzipFile {
+ public:
+  // ctor and dctor
+  GzipFile() {}
+  ~GzipFile();
+
+  // Open gzip file with num_threads decompression threads
+  void Open(const std::string& filename, int num_threads);
+
+  // Read at most len bytes of decompressed data to buf.
+  // Return the read size, which is less than len only
+  // at the end of file.
+  uint64 Read(char* buf, uint64 len);
+
+  // Reach the end of file
+  bool Eof() const;
+
+  // Close file
+  void Close();
+
+  // File is in BGZF format
+  bool IsBGZF() const { return bgzf_; }
+
+ protected:
+  int fd_ = -1;                // file descriptor
+  uint64 file_size_ = 0;       // compressed file size
+  bool bgzf_ = false;          // file is in BGZF format
+  bool eof_ = false;           // reach the end of file
+
+  // For BGZF: decompressed blocks in file order
+  int max_tasks_ = 0;                             // tasks in flight
+  uint64 scan_offset_ = 0;                        // next member
+  scoped_ptr<ThreadPool> pool_;                   // decompress threads
+  std::deque<std::future<std::vector<char>>> tasks_;  // blocks
+  std::vector<char> out_;                         // current block
+  uint64 out_pos_ = 0;                            // consumed bytes
+
+  // For other gzip: single zlib stream
+  void* stream_ = nullptr;     // z_stream
+  bool member_end_ = false;    // at the end of a member
+  std::vector<char> in_;       // compressed input buffer
+
+ private:
+  // Read and submit BGZF members until the queue is full
+  void SubmitTasks();
+
+  // Read from BGZF file
+  uint64 ReadBGZF(char* buf, uint64 len);
+
+  // Read from a single zlib stream
+  uint64 ReadStream(char* buf, uint64 len);
+
+  DISALLOW_COPY_AND_ASSIGN(GzipFile);
+};
+
+}  // namespace xforest
+
+#endif  // XFOREST_READER_GZIP_FILE_H_
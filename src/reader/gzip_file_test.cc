@@ -0,0 +1,214 @@
+//------------------------------------------------------------------------------
+// Copyright (c) 2018 by contributors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//------------------------------------------------------------------------------
+
+/*
+This file tests the GzipFile class.
+*/
+
+#include "src/reader/gzip_file.h"
+
+#include <string.h>
+#include <string>
+#include <vector>
+
+#include "src/base/common.h"
+#include "src/base/file_util.h"
+#include "src/base/stringprintf.h"
+#include "src/reader/reader.h"
+#include "gtest/gtest.h"
+
+#ifdef XFOREST_USE_ZLIB
+#include <zlib.h>
+#endif
+
+using xforest::GzipFile;
+using xforest::Reader;
+using xforest::DMatrix;
+
+#ifdef XFOREST_USE_ZLIB
+
+const int kNumLines = 20000;
+
+// Generate CSV data. The label of line i is i.
+static std::string GenData() {
+  std::string data;
+  for (int i = 0; i < kNumLines; ++i) {
+    data += StringPrintf("%d,%d,%d.25\n", i, i % 13, i % 5);
+  }
+  return data;
+}
+
+// Write data as a multi-member gzip file
+static void WriteGzip(const std::string& filename,
+                      const std::string& data) {
+  size_t half = data.size() / 2;
+  gzFile file = gzopen(filename.c_str(), "wb");
+  gzwrite(file, data.data(), half);
+  gzclose(file);
+  file = gzopen(filename.c_str(), "ab");
+  gzwrite(file, data.data() + half, data.size() - half);
+  gzclose(file);
+}
+
+// Write data as a BGZF file with small members
+static void WriteBGZF(const std::string& filename,
+                      const std::string& data) {
+  const size_t kMemberSize = 1000;
+  FILE* file = OpenFileOrDie(filename.c_str(), "w");
+  std::vector<unsigned char> out(2 * kMemberSize + 64);
+  for (size_t pos = 0; pos <= data.size(); pos += kMemberSize) {
+    // The last member is an empty EOF marker
+    size_t len = std::min(kMemberSize, data.size() - pos);
+    const Bytef* in = reinterpret_cast<const Bytef*>(data.data() + pos);
+    z_stream zs;
+    memset(&zs, 0, sizeof(zs));
+    deflateInit2(&zs, 6, Z_DEFLATED, -MAX_WBITS, 8, Z_DEFAULT_STRATEGY);
+    zs.next_in = const_cast<Bytef*>(in);
+    zs.avail_in = len;
+    zs.next_out = out.data() + 18;
+    zs.avail_out = out.size() - 26;
+    ASSERT_EQ(Z_STREAM_END, deflate(&zs, Z_FINISH));
+    size_t csize = zs.total_out;
+    deflateEnd(&zs);
+    size_t bsize = 18 + csize + 8;
+    unsigned char header[18] = {0x1f, 0x8b, 8, 4, 0, 0, 0, 0, 0, 0xff,
+                                6, 0, 'B', 'C', 2, 0, 0, 0};
+    header[16] = (bsize - 1) & 0xff;
+    header[17] = (bsize - 1) >> 8;
+    memcpy(out.data(), header, 18);
+    uint32 crc = crc32(0L, in, len);
+    for (int i = 0; i < 4; ++i) {
+      out[18 + csize + i] = (crc >> (8 * i)) & 0xff;
+      out[22 + csize + i] = (len >> (8 * i)) & 0xff;
+    }
+    WriteDataToDisk(file, reinterpret_cast<char*>(out.data()), bsize);
+  }
+  Close(file);
+}
+
+// Append n zero bytes to file, which some tools pad after
+// the last gzip member
+static void AppendZeros(const std::string& filename, size_t n) {
+  FILE* file = OpenFileOrDie(filename.c_str(), "a");
+  std::string zeros(n, 0);
+  WriteDataToDisk(file, zeros.data(), zeros.size());
+  Close(file);
+}
+
+// Read all data from GzipFile with a small buffer
+static std::string ReadAll(GzipFile* file) {
+  std::string result;
+  char buf[777];
+  while (!file->Eof()) {
+    uint64 len = file->Read(buf, sizeof(buf));
+    result.append(buf, len);
+  }
+  return result;
+}
+
+TEST(GzipFile, MultiMember) {
+  std::string filename = "/tmp/gzip_file_test.csv.gz";
+  std::string data = GenData();
+  WriteGzip(filename, data);
+  GzipFile file;
+  file.Open(filename, 2);
+  EXPECT_FALSE(file.IsBGZF());
+  EXPECT_EQ(ReadAll(&file), data);
+  file.Close();
+  RemoveFile(filename.c_str());
+}
+
+TEST(GzipFile, BGZF) {
+  std::string filename = "/tmp/gzip_file_test.csv.gz";
+  std::string data = GenData();
+  WriteBGZF(filename, data);
+  GzipFile file;
+  file.Open(filename, 4);
+  EXPECT_TRUE(file.IsBGZF());
+  EXPECT_EQ(ReadAll(&file), data);
+  file.Close();
+  RemoveFile(filename.c_str());
+}
+
+TEST(GzipFile, ZeroPadding) {
+  std::string filename = "/tmp/gzip_file_test.csv.gz";
+  std::string data = GenData();
+  // Larger than the read buffers, so that padding spans them
+  const size_t kPadding = 5 << 20;
+  for (int bgzf = 0; bgzf < 2; ++bgzf) {
+    if (bgzf) {
+      WriteBGZF(filename, data);
+    } else {
+      WriteGzip(filename, data);
+    }
+    AppendZeros(filename, kPadding);
+    GzipFile file;
+    file.Open(filename, 2);
+    EXPECT_EQ(file.IsBGZF(), bgzf == 1);
+    EXPECT_EQ(ReadAll(&file), data);
+    file.Close();
+  }
+  RemoveFile(filename.c_str());
+}
+
+TEST(GzipFile, Reader) {
+  std::vector<std::string> file_list;
+  file_list.push_back("/tmp/gzip_file_test_0.csv.gz");
+  file_list.push_back("/tmp/gzip_file_test_1.csv.gz");
+  std::string data = GenData();
+  WriteGzip(file_list[0], data);
+  WriteBGZF(file_list[1], data);
+  // 3 shards and 2 files: each file is read by one shard
+  std::vector<int> count(kNumLines, 0);
+  for (int shard = 0; shard < 3; ++shard) {
+    Reader reader;
+    reader.SetBlockSize(4096);
+    reader.SetShard(shard, 3);
+    reader.Initialize(file_list, "csv");
+    DMatrix* matrix = nullptr;
+    while (reader.Samples(&matrix) > 0) {
+      for (index_t i = 0; i < matrix->row_length; ++i) {
+        int label = static_cast<int>(matrix->Y[i]);
+        count[label]++;
+        EXPECT_FLOAT_EQ(matrix->Row(i)[0], label % 13);
+        EXPECT_FLOAT_EQ(matrix->Row(i)[1], (label % 5) + 0.25);
+      }
+    }
+  }
+  for (int i = 0; i < kNumLines; ++i) {
+    EXPECT_EQ(count[i], 2);
+  }
+  for (size_t i = 0; i < file_list.size(); ++i) {
+    RemoveFile(file_list[i].c_str());
+  }
+}
+
+#else  // XFOREST_USE_ZLIB
+
+// Without zlib, opening a gzip file fails with a clear message
+// instead of reading the compressed bytes as text.
+TEST(GzipFile, WithoutZlib) {
+  std::string filename = "/tmp/gzip_file_test_nozlib.csv.gz";
+  FILE* file = OpenFileOrDie(filename.c_str(), "w");
+  const char header[] = {'\x1f', '\x8b', 8, 0};
+  WriteDataToDisk(file, header, sizeof(header));
+  Close(file);
+  GzipFile gzip;
+  EXPECT_DEATH(gzip.Open(filename, 1), "built without zlib");
+  RemoveFile(filename.c_str());
+}
+
+#endif  // XFOREST_USE_ZLIB
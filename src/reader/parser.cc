@@ -0,0 +1,153 @@
+//------------------------------------------------------------------------------
+// Copyright (c) 2018 by contributors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//------------------------------------------------------------------------------
+
+/*
+This file is the implementation of Parser class.
+*/
+
+#include "src/reader/parser.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <algorithm>
+
+namespace xforest {
+
+//------------------------------------------------------------------------------
+// Class register
+//------------------------------------------------------------------------------
+CLASS_REGISTER_IMPLEMENT_REGISTRY(xforest_parser_registry, Parser);
+REGISTER_PARSER("csv", CSVParser);
+
+//------------------------------------------------------------------------------
+// Parser class
+//------------------------------------------------------------------------------
+
+// Get the length of the line start from buf[pos]
+uint64 Parser::GetLine(const char* buf, uint64 pos,
+                       uint64 size, uint64* next) {
+  uint64 end = pos;
+  while (end < size && buf[end] != '\n') {
+    end++;
+  }
+  *next = end + 1;
+  // Handle the format in DOS and windows
+  if (end > pos && buf[end-1] == '\r') {
+    end--;
+  }
+  return end - pos;
+}
+
+// Only parse the given feature columns
+void Parser::SetProjection(const std::vector<index_t>& cols) {
+  projection_.assign(cols.begin(), cols.end());
+  std::sort(projection_.begin(), projection_.end());
+  projection_.erase(std::unique(projection_.begin(), projection_.end()),
+                    projection_.end());
+}
+
+//------------------------------------------------------------------------------
+// CSVParser class
+//------------------------------------------------------------------------------
+
+// Count the number of features in one line
+static index_t CountFeature(const char* line, uint64 len) {
+  index_t count = 0;
+  for (uint64 i = 0; i < len; ++i) {
+    if (line[i] == ',') {
+      count++;
+    }
+  }
+  return count;
+}
+
+// Parse a block of data to DMatrix (append)
+void CSVParser::Parse(const char* buf, uint64 size, DMatrix* matrix) {
+  CHECK_NOTNULL(buf);
+  CHECK_NOTNULL(matrix);
+  uint64 pos = 0;
+  uint64 next = 0;
+  char* end = nullptr;
+  while (pos < size) {
+    uint64 len = GetLine(buf, pos, size, &next);
+    const char* line = buf + pos;
+    pos = next;
+    if (len == 0) {  // Skip empty line
+      continue;
+    }
+    if (matrix->num_feat == 0) {
+      matrix->num_feat = CountFeature(line, len);
+      CHECK_GT(matrix->num_feat, 0);
+    }
+    // Parse label
+    matrix->Y.push_back(strtof(line, &end));
+    // Parse features
+    if (projection_.empty()) {
+      for (index_t i = 0; i < matrix->num_feat; ++i) {
+        CHECK_EQ(*end, ',');
+        matrix->X.push_back(strtof(end+1, &end));
+      }
+      CHECK_EQ(end, line+len);
+    } else {
+      CHECK_LT(projection_.back(), matrix->num_feat);
+      matrix->X.resize(matrix->X.size() + matrix->num_feat, 0);
+      ParseProjection(end, line+len, matrix->Row(matrix->row_length));
+    }
+    matrix->row_length++;
+  }
+}
+
+// Parse the projected features of one line
+void CSVParser::ParseProjection(const char* ptr,
+                                const char* line_end,
+                                real_t* row) {
+  index_t field = 0;
+  for (size_t k = 0; k < projection_.size(); ++k) {
+    index_t target = projection_[k];
+    // Skip the unused fields by scanning delimiters
+    while (field < target && ptr < line_end) {
+      ptr = static_cast<const char*>(
+        memchr(ptr + 1, ',', line_end - ptr - 1));
+      if (ptr == nullptr) {
+        ptr = line_end;
+        break;
+      }
+      field++;
+    }
+    // The line is shorter than the projection
+    if (ptr >= line_end || *ptr != ',') {
+      LOG(FATAL) << "Cannot find feature " << target
+                 << " in line. Please check the data.";
+    }
+    // An empty field is 0. Otherwise strtof() skips the
+    // '\n' of an empty last field into the next line.
+    ptr++;
+    if (ptr == line_end || *ptr == ',') {
+      row[target] = 0;
+    } else {
+      char* end = nullptr;
+      row[target] = strtof(ptr, &end);
+      if (end > line_end || (end < line_end && *end != ',')) {
+        LOG(FATAL) << "Cannot parse feature " << target
+                   << " in line. Please check the data.";
+      }
+      ptr = end;
+    }
+    field = target + 1;
+  }
+}
+
+}  // namespace xforest
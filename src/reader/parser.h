@@ -0,0 +1,135 @@
+//------------------------------------------------------------------------------
+// Copyright (c) 2018 by contributors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//------------------------------------------------------------------------------
+
+/*
+This file defines the Parser class, which parses a block of
+text data to the DMatrix.
+*/
+
+#ifndef XFOREST_READER_PARSER_H_
+#define XFOREST_READER_PARSER_H_
+
+#include <string>
+#include <vector>
+
+#include "src/base/common.h"
+#include "src/base/class_register.h"
+
+namespace xforest {
+
+//------------------------------------------------------------------------------
+// DMatrix is a dense row-major data matrix. Each row has
+// num_feat feature values in X and one label in Y.
+//------------------------------------------------------------------------------
+struct DMatrix {
+  // Clear all data but keep the memory
+  inline void Reset() {
+    row_length = 0;
+    X.clear();
+    Y.clear();
+  }
+  // Get the feature pointer of row i
+  inline real_t* Row(index_t i) {
+    return X.data() + (uint64)i * num_feat;
+  }
+  // Number of rows
+  index_t row_length = 0;
+  // Number of features of each row
+  index_t num_feat = 0;
+  // Feature values
+  std::vector<real_t> X;
+  // Labels
+  std::vector<real_t> Y;
+};
+
+//------------------------------------------------------------------------------
+// Parser is an abstract class, which will be implemented by
+// real parser, such as CSVParser. The input buffer of Parse()
+// always contains complete lines.
+//------------------------------------------------------------------------------
+class Parser {
+ public:
+  // ctor and dctor
+  Parser() {}
+  virtual ~Parser() {}
+
+  // Parse a block of data to DMatrix (append)
+  virtual void Parse(const char* buf, uint64 size, DMatrix* matrix) = 0;
+
+  // Only parse the given feature columns. The other fields are
+  // skipped without conversion and set to 0 in DMatrix, so that
+  // the feature ids of DMatrix are the same as the input data.
+  // An empty projection means parsing all of the columns.
+  void SetProjection(const std::vector<index_t>& cols);
+
+ protected:
+  // Feature columns to parse (sorted)
+  std::vector<index_t> projection_;
+
+  // Get the length of the line start from buf[pos].
+  // The '\n' and '\r' at the end of line are not included.
+  uint64 GetLine(const char* buf, uint64 pos, uint64 size, uint64* next);
+
+ private:
+  DISALLOW_COPY_AND_ASSIGN(Parser);
+};
+
+//------------------------------------------------------------------------------
+// CSVParser parses the comma-separated format:
+//
+//   label,feat_1,feat_2,...,feat_n
+//
+// The label is always the first column.
+//------------------------------------------------------------------------------
+class CSVParser : public Parser {
+ public:
+  // ctor and dctor
+  CSVParser() {}
+  ~CSVParser() {}
+
+  // Parse a block of data to DMatrix (append)
+  void Parse(const char* buf, uint64 size, DMatrix* matrix);
+
+ private:
+  // Parse the projected features of one line. ptr
+  // points to the ',' before the first feature.
+  void ParseProjection(const char* ptr,
+                       const char* line_end,
+                       real_t* row);
+
+  DISALLOW_COPY_AND_ASSIGN(CSVParser);
+};
+
+//------------------------------------------------------------------------------
+// Class register
+//------------------------------------------------------------------------------
+CLASS_REGISTER_DEFINE_REGISTRY(xforest_parser_registry, Parser);
+
+#define REGISTER_PARSER(format_name, parser_name)           \
+  CLASS_REGISTER_OBJECT_CREATOR(                            \
+      xforest_parser_registry,                              \
+      Parser,                                               \
+      format_name,                                          \
+      parser_name)
+
+#define CREATE_PARSER(format_name)                          \
+  CLASS_REGISTER_CREATE_OBJECT(                             \
+      xforest_parser_registry,                              \
+      format_name)
+
+}  // namespace xforest
+
+#endif  // XFOREST_READER_PARSER_H_
@@ -0,0 +1,114 @@
+//------------------------------------------------------------------------------
+// Copyright (c) 2018 by contributors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//------------------------------------------------------------------------------
+
+/*
+This file tests the Parser class.
+*/
+
+#include "src/reader/parser.h"
+
+#include <string>
+#include <vector>
+
+#include "src/base/common.h"
+#include "src/base/scoped_ptr.h"
+#include "gtest/gtest.h"
+
+namespace xforest {
+
+TEST(CSVParser, Parse) {
+  std::string data("1,0.5,2,3\n0,1.5,-2,4\r\n\n1,2.5,0,5");
+  scoped_ptr<Parser> parser(CREATE_PARSER("csv"));
+  ASSERT_TRUE(parser.get() != nullptr);
+  DMatrix matrix;
+  parser->Parse(data.c_str(), data.size(), &matrix);
+  EXPECT_EQ(matrix.row_length, 3);
+  EXPECT_EQ(matrix.num_feat, 3);
+  EXPECT_EQ(matrix.Y[0], 1);
+  EXPECT_EQ(matrix.Y[1], 0);
+  EXPECT_EQ(matrix.Y[2], 1);
+  EXPECT_FLOAT_EQ(matrix.Row(0)[0], 0.5);
+  EXPECT_FLOAT_EQ(matrix.Row(1)[1], -2);
+  EXPECT_FLOAT_EQ(matrix.Row(1)[2], 4);
+  EXPECT_FLOAT_EQ(matrix.Row(2)[0], 2.5);
+  EXPECT_FLOAT_EQ(matrix.Row(2)[2], 5);
+}
+
+TEST(CSVParser, Projection) {
+  std::string data("1,0.5,2,3,7\n0,1.5,-2,4,8\n");
+  scoped_ptr<Parser> parser(CREATE_PARSER("csv"));
+  std::vector<index_t> cols;
+  cols.push_back(3);
+  cols.push_back(1);
+  parser->SetProjection(cols);
+  DMatrix matrix;
+  parser->Parse(data.c_str(), data.size(), &matrix);
+  EXPECT_EQ(matrix.row_length, 2);
+  EXPECT_EQ(matrix.num_feat, 4);
+  EXPECT_EQ(matrix.Y[1], 0);
+  EXPECT_FLOAT_EQ(matrix.Row(0)[0], 0);
+  EXPECT_FLOAT_EQ(matrix.Row(0)[1], 2);
+  EXPECT_FLOAT_EQ(matrix.Row(0)[2], 0);
+  EXPECT_FLOAT_EQ(matrix.Row(0)[3], 7);
+  EXPECT_FLOAT_EQ(matrix.Row(1)[1], -2);
+  EXPECT_FLOAT_EQ(matrix.Row(1)[3], 8);
+}
+
+// A row shorter than the projection is a fatal error
+TEST(CSVParser, ProjectionShortRow) {
+  std::string data("1,0.5,2,3,7\n0,1.5\n");
+  std::vector<index_t> skip_cols(1, 3);
+  std::vector<index_t> next_cols;
+  next_cols.push_back(0);
+  next_cols.push_back(1);
+  for (int i = 0; i < 2; ++i) {
+    scoped_ptr<Parser> parser(CREATE_PARSER("csv"));
+    parser->SetProjection(i == 0 ? skip_cols : next_cols);
+    DMatrix matrix;
+    EXPECT_DEATH(parser->Parse(data.c_str(), data.size(), &matrix),
+                 "Cannot find feature");
+  }
+}
+
+// An empty field is 0, and does not read the next line
+TEST(CSVParser, ProjectionEmptyField) {
+  std::string data("1,0.5,\n5,,9\n");
+  std::vector<index_t> cols;
+  cols.push_back(0);
+  cols.push_back(1);
+  scoped_ptr<Parser> parser(CREATE_PARSER("csv"));
+  parser->SetProjection(cols);
+  DMatrix matrix;
+  parser->Parse(data.c_str(), data.size(), &matrix);
+  EXPECT_EQ(matrix.row_length, 2);
+  EXPECT_FLOAT_EQ(matrix.Row(0)[0], 0.5);
+  EXPECT_FLOAT_EQ(matrix.Row(0)[1], 0);
+  EXPECT_EQ(matrix.Y[1], 5);
+  EXPECT_FLOAT_EQ(matrix.Row(1)[0], 0);
+  EXPECT_FLOAT_EQ(matrix.Row(1)[1], 9);
+  // A field that is not a number is a fatal error
+  std::string bad("1,0.5,x2\n");
+  DMatrix bad_matrix;
+  EXPECT_DEATH(parser->Parse(bad.c_str(), bad.size(), &bad_matrix),
+               "Cannot parse feature");
+}
+
+TEST(CSVParser, UnknowFormat) {
+  Parser* parser = CREATE_PARSER("unknow");
+  EXPECT_TRUE(parser == nullptr);
+}
+
+}  // namespace xforest
@@ -0,0 +1,314 @@
+//------------------------------------------------------------------------------
+// Copyright (c) 2018 by contributors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//------------------------------------------------------------------------------
+
+/*
+This file is the implementation of Reader class.
+*/
+
+#include "src/reader/reader.h"
+
+#include <string.h>
+#include <algorithm>
+
+#include "src/base/file_util.h"
+#include "src/base/profiler.h"
+
+namespace xforest {
+
+// Size of buffer used to find the record boundary
+static const uint64 kSeekBufferSize = 64 * 1024;  // 64 KB
+
+// dctor
+Reader::~Reader() {
+  CloseSpan();
+}
+
+// Read only the shard_id-th shard of num_shards shards
+void Reader::SetShard(int shard_id, int num_shards) {
+  CHECK_GT(num_shards, 0);
+  CHECK_GE(shard_id, 0);
+  CHECK_LT(shard_id, num_shards);
+  CHECK(spans_.empty());
+  shard_id_ = shard_id;
+  num_shards_ = num_shards;
+}
+
+// Set the size of one data block
+void Reader::SetBlockSize(uint64 block_size) {
+  CHECK_GT(block_size, 0);
+  CHECK(spans_.empty());
+  block_size_ = block_size;
+}
+
+// Set the size and the number of outstanding asynchronous reads
+void Reader::SetReadAhead(uint64 chunk_size, int queue_depth) {
+  CHECK_GT(chunk_size, 0);
+  CHECK_GT(queue_depth, 0);
+  CHECK(spans_.empty());
+  chunk_size_ = chunk_size;
+  queue_depth_ = queue_depth;
+}
+
+// Set the number of threads to decompress a gzip file
+void Reader::SetGzipThreads(int num_threads) {
+  CHECK_GT(num_threads, 0);
+  gzip_threads_ = num_threads;
+}
+
+// Only parse the given feature columns
+void Reader::SetProjection(const std::vector<index_t>& cols) {
+  projection_.assign(cols.begin(), cols.end());
+  if (parser_.get() != nullptr) {
+    parser_->SetProjection(projection_);
+  }
+}
+
+// Initialize Reader with one file
+void Reader::Initialize(const std::string& filename,
+                        const std::string& format) {
+  std::vector<std::string> file_list(1, filename);
+  Initialize(file_list, format);
+}
+
+// Initialize Reader with a list of files
+void Reader::Initialize(const std::vector<std::string>& file_list,
+                        const std::string& format) {
+  CHECK(!file_list.empty());
+  parser_.reset(CREATE_PARSER(format.c_str()));
+  if (parser_.get() == nullptr) {
+    LOG(FATAL) << "Unknow data format: " << format;
+  }
+  parser_->SetProjection(projection_);
+  // The extra byte is used by the terminating '\0'
+  block_.reset(new char[block_size_ + 1]);
+  chunk_mem_.resize(chunk_size_ * queue_depth_);
+  BuildSpans(file_list);
+  Reset();
+  LOG(INFO) << "Reader shard " << shard_id_ << "/" << num_shards_
+            << " reads " << spans_.size() << " span(s), "
+            << PrintSize(ShardSize());
+}
+
+// Build the spans of the current shard
+void Reader::BuildSpans(const std::vector<std::string>& file_list) {
+  spans_.clear();
+  size_t num_files = file_list.size();
+  if (num_files >= num_shards_) {
+    // Assign whole files to shards
+    for (size_t i = shard_id_; i < num_files; i += num_shards_) {
+      FILE* file = OpenFileOrDie(file_list[i].c_str(), "r");
+      Span span;
+      span.filename = file_list[i];
+      span.begin = 0;
+      span.end = GetFileSize(file);
+      span.gzip = IsGzipFile(file_list[i]);
+      Close(file);
+      spans_.push_back(span);
+    }
+  } else {
+    // Cut every file into byte ranges
+    for (size_t i = 0; i < num_files; ++i) {
+      FILE* file = OpenFileOrDie(file_list[i].c_str(), "r");
+      uint64 file_size = GetFileSize(file);
+      if (IsGzipFile(file_list[i])) {
+        // Compressed file cannot be cut
+        if (i % num_shards_ == shard_id_) {
+          Span span;
+          span.filename = file_list[i];
+          span.end = file_size;
+          span.gzip = true;
+          spans_.push_back(span);
+        }
+        Close(file);
+        continue;
+      }
+      uint64 begin = file_size * shard_id_ / num_shards_;
+      uint64 end = file_size * (shard_id_ + 1) / num_shards_;
+      Span span;
+      span.filename = file_list[i];
+      span.begin = FindRecordStart(file, begin, file_size);
+      span.end = FindRecordStart(file, end, file_size);
+      Close(file);
+      if (span.begin < span.end) {
+        spans_.push_back(span);
+      }
+    }
+  }
+}
+
+// Find the first record start position >= offset.
+// A record starts at the head of file or after a '\n'.
+uint64 Reader::FindRecordStart(FILE* file, uint64 offset,
+                               uint64 file_size) {
+  if (offset == 0 || offset >= file_size) {
+    return std::min(offset, file_size);
+  }
+  CHECK_EQ(0, fseeko(file, offset - 1, SEEK_SET));
+  scoped_array<char> buf(new char[kSeekBufferSize]);
+  uint64 pos = offset - 1;
+  while (pos < file_size) {
+    uint64 read_len = ReadDataFromDisk(file, buf.get(), kSeekBufferSize);
+    CHECK_GT(read_len, 0);
+    char* ptr = static_cast<char*>(memchr(buf.get(), '\n', read_len));
+    if (ptr != nullptr) {
+      return pos + (ptr - buf.get()) + 1;
+    }
+    pos += read_len;
+  }
+  return file_size;
+}
+
+// Open the file of current span
+void Reader::OpenSpan() {
+  const Span& span = spans_[span_idx_];
+  if (span.gzip) {
+    gzip_.reset(new GzipFile());
+    gzip_->Open(span.filename, gzip_threads_);
+    return;
+  }
+  file_.reset(new AsyncFile());
+  file_->Open(span.filename, queue_depth_);
+  submit_pos_ = span_pos_;
+  free_bufs_.clear();
+  for (int i = 0; i < queue_depth_; ++i) {
+    free_bufs_.push_back(chunk_mem_.data() + i * chunk_size_);
+  }
+  SubmitChunks();
+}
+
+// Close the file of current span
+void Reader::CloseSpan() {
+  if (file_.get() != nullptr) {
+    // Wait all outstanding reads before releasing buffers
+    file_->Close();
+    file_.reset();
+    chunks_.clear();
+  }
+  gzip_.reset();
+}
+
+// Submit reads until the queue is full
+void Reader::SubmitChunks() {
+  const Span& span = spans_[span_idx_];
+  uint64 span_size = span.end - span.begin;
+  while (!free_bufs_.empty() && submit_pos_ < span_size) {
+    Chunk chunk;
+    chunk.buf = free_bufs_.back();
+    free_bufs_.pop_back();
+    chunk.len = std::min(chunk_size_, span_size - submit_pos_);
+    chunk.id = file_->Submit(chunk.buf, chunk.len,
+                             span.begin + submit_pos_);
+    submit_pos_ += chunk.len;
+    chunks_.push_back(chunk);
+  }
+}
+
+// Read next piece of data of current span to buf
+uint64 Reader::ReadSpan(char* buf, uint64 len, bool* span_end) {
+  const Span& span = spans_[span_idx_];
+  uint64 span_size = span.end - span.begin;
+  if (file_.get() == nullptr && gzip_.get() == nullptr) {
+    OpenSpan();
+  }
+  if (span.gzip) {
+    TRACE_ZONE("gzip_read");
+    uint64 read_len = gzip_->Read(buf, len);
+    *span_end = gzip_->Eof();
+    return read_len;
+  }
+  uint64 read_len = 0;
+  while (read_len < len && span_pos_ < span_size) {
+    Chunk& chunk = chunks_.front();
+    if (!chunk.ready) {
+      TRACE_ZONE("io_wait");
+      CHECK_EQ(chunk.len, file_->Wait(chunk.id));
+      chunk.ready = true;
+    }
+    uint64 size = std::min(len - read_len, chunk.len - chunk.pos);
+    memcpy(buf + read_len, chunk.buf + chunk.pos, size);
+    chunk.pos += size;
+    read_len += size;
+    span_pos_ += size;
+    if (chunk.pos == chunk.len) {
+      free_bufs_.push_back(chunk.buf);
+      chunks_.pop_front();
+      SubmitChunks();
+    }
+  }
+  *span_end = (span_pos_ == span_size);
+  return read_len;
+}
+
+// Read a block of samples to matrix
+index_t Reader::Samples(DMatrix** matrix) {
+  TRACE_ZONE("read_block");
+  CHECK_NOTNULL(matrix);
+  matrix_.Reset();
+  char* buf = block_.get();
+  while (matrix_.row_length == 0 && span_idx_ < spans_.size()) {
+    bool span_end = false;
+    uint64 size = remain_ + ReadSpan(buf + remain_,
+                                     block_size_ - remain_,
+                                     &span_end);
+    // Only parse complete lines. The last line of a span
+    // is always complete even without '\n'.
+    uint64 end = size;
+    if (!span_end) {
+      while (end > 0 && buf[end-1] != '\n') {
+        end--;
+      }
+      if (end == 0) {
+        LOG(FATAL) << "Encountered a line longer than the block size: "
+                   << block_size_;
+      }
+    }
+    if (end == size) {
+      buf[size] = '\0';
+    }
+    {
+      TRACE_ZONE("parse");
+      parser_->Parse(buf, end, &matrix_);
+    }
+    remain_ = size - end;
+    memmove(buf, buf + end, remain_);
+    if (span_end) {
+      CloseSpan();
+      span_idx_++;
+      span_pos_ = 0;
+    }
+  }
+  *matrix = &matrix_;
+  return matrix_.row_length;
+}
+
+// Return to the beginning of data
+void Reader::Reset() {
+  CloseSpan();
+  span_idx_ = 0;
+  span_pos_ = 0;
+  remain_ = 0;
+}
+
+// Total bytes of data read by current shard
+uint64 Reader::ShardSize() const {
+  uint64 size = 0;
+  for (size_t i = 0; i < spans_.size(); ++i) {
+    size += spans_[i].end - spans_[i].begin;
+  }
+  return size;
+}
+
+}  // namespace xforest
@@ -0,0 +1,189 @@
+//------------------------------------------------------------------------------
+// Copyright (c) 2018 by contributors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//------------------------------------------------------------------------------
+
+/*
+This file defines the Reader class, which reads data from disk
+file block by block and parses it to the DMatrix.
+*/
+
+#ifndef XFOREST_READER_READER_H_
+#define XFOREST_READER_READER_H_
+
+#include <deque>
+#include <string>
+#include <vector>
+
+#include "src/base/common.h"
+#include "src/base/scoped_ptr.h"
+#include "src/reader/async_file.h"
+#include "src/reader/gzip_file.h"
+#include "src/reader/parser.h"
+
+namespace xforest {
+
+// Default size of one data block (byte)
+const uint64 kDefaultBlockSize = 64 * 1024 * 1024;  // 64 MB
+
+// Default size of one asynchronous read (byte)
+const uint64 kDefaultChunkSize = 4 * 1024 * 1024;  // 4 MB
+
+// Default number of outstanding reads
+const int kDefaultQueueDepth = 8;
+
+// Default number of threads to decompress a gzip file
+const int kDefaultGzipThreads = 4;
+
+//------------------------------------------------------------------------------
+// Reader reads text data from one file or a list of files.
+// We can use it like this:
+//
+//   Reader reader;
+//   reader.Initialize("train.csv", "csv");
+//   DMatrix* matrix = nullptr;
+//   while (reader.Samples(&matrix) > 0) {
+//     ... // use matrix
+//   }
+//
+// In distributed training, every process can read only its own
+// shard of the input by calling SetShard() before Initialize():
+//
+//   reader.SetShard(shard_id, num_shards);
+//
+// If the number of files is not less than num_shards, the files
+// are assigned to shards round-robin. Otherwise, every file is
+// cut into num_shards byte ranges and each range is aligned to
+// the record boundary: a line belongs to the shard whose range
+// contains its first byte. Thus the union of all shards is exactly
+// the input data, and no process needs to ship data to others.
+//
+// The data of a span is read ahead by AsyncFile, which keeps
+// queue_depth reads of chunk_size bytes in flight, so that the
+// disk is busy while the parser is running.
+//
+// A file ending with ".gz" is decompressed on the fly (see
+// GzipFile). Compressed files are never cut into byte ranges:
+// they are always assigned to shards as whole files.
+//------------------------------------------------------------------------------
+class Reader {
+ public:
+  // ctor and dctor
+  Reader() {}
+  ~Reader();
+
+  // Read only the shard_id-th shard of num_shards shards
+  void SetShard(int shard_id, int num_shards);
+
+  // Set the size of one data block. The block must be
+  // larger than the longest line of the data.
+  void SetBlockSize(uint64 block_size);
+
+  // Set the size and the number of outstanding asynchronous reads
+  void SetReadAhead(uint64 chunk_size, int queue_depth);
+
+  // Set the number of threads to decompress a gzip file
+  void SetGzipThreads(int num_threads);
+
+  // Only parse the given feature columns, e.g., the features
+  // used by a trained model (DTree::GetSplitFeatures()).
+  // See Parser::SetProjection().
+  void SetProjection(const std::vector<index_t>& cols);
+
+  // Initialize Reader with one file
+  void Initialize(const std::string& filename,
+                  const std::string& format);
+
+  // Initialize Reader with a list of files
+  void Initialize(const std::vector<std::string>& file_list,
+                  const std::string& format);
+
+  // Read a block of samples to matrix.
+  // Return the number of rows and 0 for the end of data.
+  index_t Samples(DMatrix** matrix);
+
+  // Return to the beginning of data
+  void Reset();
+
+  // Total bytes of data read by current shard
+  uint64 ShardSize() const;
+
+ protected:
+  // Byte range [begin, end) of a file
+  struct Span {
+    std::string filename;
+    uint64 begin = 0;
+    uint64 end = 0;
+    bool gzip = false;
+  };
+
+  // Find the first record start position >= offset
+  uint64 FindRecordStart(FILE* file, uint64 offset, uint64 file_size);
+
+  // Build the spans of the current shard
+  void BuildSpans(const std::vector<std::string>& file_list);
+
+  // Read next piece of data of current span to buf.
+  // Return the read size and set span_end if the span is finished.
+  uint64 ReadSpan(char* buf, uint64 len, bool* span_end);
+
+  int shard_id_ = 0;                  // id of current shard
+  int num_shards_ = 1;                // total number of shards
+  uint64 block_size_ = kDefaultBlockSize;  // size of data block
+  uint64 chunk_size_ = kDefaultChunkSize;  // size of asynchronous read
+  int queue_depth_ = kDefaultQueueDepth;   // outstanding reads
+  int gzip_threads_ = kDefaultGzipThreads; // decompression threads
+
+  // Asynchronous read of a span
+  struct Chunk {
+    int id = -1;          // request id of AsyncFile
+    char* buf = nullptr;  // data buffer
+    uint64 len = 0;       // size of data
+    uint64 pos = 0;       // consumed bytes
+    bool ready = false;   // the read is finished
+  };
+
+  std::vector<Span> spans_;           // data ranges of current shard
+  size_t span_idx_ = 0;               // current span
+  uint64 span_pos_ = 0;               // consumed position in current span
+  uint64 submit_pos_ = 0;             // submitted position in current span
+  scoped_ptr<AsyncFile> file_;        // file of current span
+  scoped_ptr<GzipFile> gzip_;         // gzip file of current span
+  std::deque<Chunk> chunks_;          // outstanding reads
+  std::vector<char*> free_bufs_;      // free chunk buffers
+  std::vector<char> chunk_mem_;       // memory of chunk buffers
+
+  scoped_array<char> block_;          // data buffer
+  uint64 remain_ = 0;                 // unparsed bytes in buffer
+
+  scoped_ptr<Parser> parser_;         // parse data
+  std::vector<index_t> projection_;   // feature columns to parse
+  DMatrix matrix_;                    // data matrix
+
+ private:
+  // Open the file of current span
+  void OpenSpan();
+
+  // Submit reads until the queue is full
+  void SubmitChunks();
+
+  // Close the file of current span
+  void CloseSpan();
+
+  DISALLOW_COPY_AND_ASSIGN(Reader);
+};
+
+}  // namespace xforest
+
+#endif  // XFOREST_READER_READER_H_
@@ -0,0 +1,122 @@
+//------------------------------------------------------------------------------
+// Copyright (c) 2018 by contributors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//------------------------------------------------------------------------------
+
+/*
+This file tests the Reader class.
+*/
+
+#include "src/reader/reader.h"
+
+#include <string>
+#include <vector>
+
+#include "src/base/common.h"
+#include "src/base/file_util.h"
+#include "src/base/stringprintf.h"
+#include "gtest/gtest.h"
+
+using xforest::DMatrix;
+using xforest::Reader;
+
+const int kNumLines = 1000;
+
+// Write kNumLines lines to file. The label of
+// line i is i, so that we can check the lines.
+static void WriteData(const std::string& filename, int start) {
+  FILE* file = OpenFileOrDie(filename.c_str(), "w");
+  for (int i = start; i < start + kNumLines; ++i) {
+    std::string line = StringPrintf("%d,%d.5,1,%d\n", i, i % 7, i % 3);
+    WriteDataToDisk(file, line.c_str(), line.size());
+  }
+  Close(file);
+}
+
+// Read all data and check each line appears only once
+static void ReadData(Reader* reader, std::vector<int>* count) {
+  DMatrix* matrix = nullptr;
+  while (reader->Samples(&matrix) > 0) {
+    EXPECT_EQ(matrix->num_feat, 3);
+    for (index_t i = 0; i < matrix->row_length; ++i) {
+      int label = static_cast<int>(matrix->Y[i]);
+      ASSERT_LT(label, count->size());
+      (*count)[label]++;
+      EXPECT_FLOAT_EQ(matrix->Row(i)[0], (label % 7) + 0.5);
+      EXPECT_FLOAT_EQ(matrix->Row(i)[2], label % 3);
+    }
+  }
+}
+
+TEST(Reader, ReadAll) {
+  std::string filename = "/tmp/reader_test.csv";
+  WriteData(filename, 0);
+  Reader reader;
+  reader.SetBlockSize(100);
+  reader.SetReadAhead(33, 3);
+  reader.Initialize(filename, "csv");
+  for (int n = 0; n < 2; ++n) {
+    std::vector<int> count(kNumLines, 0);
+    ReadData(&reader, &count);
+    for (int i = 0; i < kNumLines; ++i) {
+      EXPECT_EQ(count[i], 1);
+    }
+    reader.Reset();
+  }
+  RemoveFile(filename.c_str());
+}
+
+TEST(Reader, ByteRangeShard) {
+  std::string filename = "/tmp/reader_test.csv";
+  WriteData(filename, 0);
+  for (int num_shards = 1; num_shards <= 7; ++num_shards) {
+    std::vector<int> count(kNumLines, 0);
+    for (int shard = 0; shard < num_shards; ++shard) {
+      Reader reader;
+      reader.SetBlockSize(257);
+      reader.SetReadAhead(64 + shard, 2);
+      reader.SetShard(shard, num_shards);
+      reader.Initialize(filename, "csv");
+      ReadData(&reader, &count);
+    }
+    for (int i = 0; i < kNumLines; ++i) {
+      EXPECT_EQ(count[i], 1);
+    }
+  }
+  RemoveFile(filename.c_str());
+}
+
+TEST(Reader, FileListShard) {
+  std::vector<std::string> file_list;
+  for (int i = 0; i < 4; ++i) {
+    file_list.push_back(StringPrintf("/tmp/reader_test_%d.csv", i));
+    WriteData(file_list.back(), i * kNumLines);
+  }
+  // 2 shards: whole files; 6 shards: byte ranges
+  for (int num_shards = 2; num_shards <= 6; num_shards += 4) {
+    std::vector<int> count(4 * kNumLines, 0);
+    for (int shard = 0; shard < num_shards; ++shard) {
+      Reader reader;
+      reader.SetShard(shard, num_shards);
+      reader.Initialize(file_list, "csv");
+      ReadData(&reader, &count);
+    }
+    for (int i = 0; i < count.size(); ++i) {
+      EXPECT_EQ(count[i], 1);
+    }
+  }
+  for (int i = 0; i < file_list.size(); ++i) {
+    RemoveFile(file_list[i].c_str());
+  }
+}
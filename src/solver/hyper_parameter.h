@@ -85,6 +85,16 @@ struct HyperParam {
   // boolean, optional (default=True)
   // Whether bootstrap samples are used when building trees.
   bool bootstrap = true;
+  // boolean, optional (default=False)
+  // Whether the identical rows of binned data are collapsed into
+  // weighted rows before training. Bootstrap samples are drawn 
+  // from the original rows, so the trees see the same data.
+  bool dedup_rows = false;
+  // boolean, optional (default=False)
+  // Whether the INFO and WARNING messages of training are written
+  // by a background thread, so that the training threads do not
+  // wait for the log file. The messages are flushed at the end.
+  bool async_log = false;
   // int or None, optional (default=None, -1)
   // The number of jobs to run in parallel for both fit and predict.
   // -1 means using all processors.
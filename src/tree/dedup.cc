@@ -0,0 +1,198 @@
+//------------------------------------------------------------------------------
+// Copyright (c) 2018 by contributors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//------------------------------------------------------------------------------
+
+/*
+This file is the implementation of DedupRows.
+*/
+
+#include "src/tree/dedup.h"
+
+#include <string.h>
+#include <algorithm>
+#include <unordered_map>
+#include <utility>
+
+#include "src/base/thread_pool.h"
+
+namespace xforest {
+
+// End of a collision chain
+static const size_t kNoRow = static_cast<size_t>(-1);
+
+// FNV-1a hash of the bins and label of a row
+static inline uint64 HashRow(const uint8* row, index_t num_feat, real_t y) {
+  uint64 h = 14695981039346656037ULL;
+  for (index_t j = 0; j < num_feat; ++j) {
+    h = (h ^ row[j]) * 1099511628211ULL;
+  }
+  uint32 bits = 0;
+  memcpy(&bits, &y, sizeof(bits));
+  for (int i = 0; i < 4; ++i) {
+    h = (h ^ ((bits >> (8 * i)) & 0xff)) * 1099511628211ULL;
+  }
+  return h;
+}
+
+// Hash rows in [start, end), and count the rows
+// of each bucket (hash % num_buckets)
+static void HashRows(const uint8* X, const real_t* Y, index_t num_feat,
+                     size_t start, size_t end, size_t num_buckets,
+                     uint64* hash, size_t* count) {
+  for (size_t i = start; i < end; ++i) {
+    hash[i] = HashRow(X + i * num_feat, num_feat, Y[i]);
+    count[hash[i] % num_buckets]++;
+  }
+}
+
+// Put the rows in [start, end) to their buckets, where
+// offset is the next position of each bucket in ids
+static void ScatterRows(const uint64* hash, size_t start, size_t end,
+                        size_t num_buckets, size_t* offset,
+                        index_t* ids) {
+  for (size_t i = start; i < end; ++i) {
+    ids[offset[hash[i] % num_buckets]++] = i;
+  }
+}
+
+// Collapse the rows ids[begin, end) of a bucket, which are in
+// increasing order. Each distinct row is returned as
+// (first row id, weight).
+static std::vector<std::pair<index_t, index_t>> CollapseBucket(
+    const uint8* X, const real_t* Y, index_t num_feat,
+    const uint64* hash, const index_t* ids,
+    size_t begin, size_t end) {
+  std::vector<std::pair<index_t, index_t>> rows;
+  // hash -> index of the first distinct row in rows
+  std::unordered_map<uint64, size_t> first;
+  // The next distinct row with the same hash (collision chain)
+  std::vector<size_t> next;
+  for (size_t n = begin; n < end; ++n) {
+    index_t i = ids[n];
+    auto it = first.find(hash[i]);
+    if (it == first.end()) {
+      first[hash[i]] = rows.size();
+      rows.push_back(std::make_pair(i, 1));
+      next.push_back(kNoRow);
+      continue;
+    }
+    // Compare bytes to handle hash collision
+    const uint8* row = X + (uint64)i * num_feat;
+    size_t k = it->second;
+    for (;;) {
+      index_t id = rows[k].first;
+      if (Y[id] == Y[i] &&
+          memcmp(X + (uint64)id * num_feat, row, num_feat) == 0) {
+        rows[k].second++;
+        break;
+      }
+      if (next[k] == kNoRow) {
+        next[k] = rows.size();
+        rows.push_back(std::make_pair(i, 1));
+        next.push_back(kNoRow);
+        break;
+      }
+      k = next[k];
+    }
+  }
+  return rows;
+}
+
+// Collapse the identical rows into weighted rows
+void DedupRows(const uint8* X, const real_t* Y,
+               index_t num_feat, index_t data_size,
+               int num_threads,
+               std::vector<uint8>* X_out,
+               std::vector<real_t>* Y_out,
+               std::vector<index_t>* weight) {
+  CHECK_NOTNULL(X);
+  CHECK_NOTNULL(Y);
+  CHECK_NOTNULL(X_out);
+  CHECK_NOTNULL(Y_out);
+  CHECK_NOTNULL(weight);
+  CHECK_GT(num_feat, 0);
+  CHECK_GT(num_threads, 0);
+  ThreadPool pool(num_threads);
+  size_t num_buckets = num_threads;
+  // Hash rows in parallel, and count[t * num_buckets + b]
+  // is the number of rows of bucket b in the range of task t
+  std::vector<uint64> hash(data_size);
+  std::vector<size_t> count(num_threads * num_buckets, 0);
+  std::vector<std::future<void>> hash_tasks;
+  for (int t = 0; t < num_threads; ++t) {
+    size_t start = getStart(data_size, num_threads, t);
+    size_t end = getEnd(data_size, num_threads, t);
+    hash_tasks.push_back(pool.enqueue(HashRows, X, Y, num_feat,
+                                      start, end, num_buckets,
+                                      hash.data(),
+                                      count.data() + t * num_buckets));
+  }
+  for (size_t t = 0; t < hash_tasks.size(); ++t) {
+    hash_tasks[t].get();
+  }
+  // Counting sort of the row ids by bucket. The rows of a bucket
+  // are in [bucket_start[b], bucket_start[b + 1]) of ids, and keep
+  // their order, since the ranges of tasks are in order.
+  std::vector<size_t> bucket_start(num_buckets + 1, 0);
+  std::vector<size_t> offset(count.size());
+  size_t pos = 0;
+  for (size_t b = 0; b < num_buckets; ++b) {
+    bucket_start[b] = pos;
+    for (int t = 0; t < num_threads; ++t) {
+      offset[t * num_buckets + b] = pos;
+      pos += count[t * num_buckets + b];
+    }
+  }
+  bucket_start[num_buckets] = pos;
+  std::vector<index_t> ids(data_size);
+  std::vector<std::future<void>> scatter_tasks;
+  for (int t = 0; t < num_threads; ++t) {
+    size_t start = getStart(data_size, num_threads, t);
+    size_t end = getEnd(data_size, num_threads, t);
+    scatter_tasks.push_back(pool.enqueue(ScatterRows, hash.data(),
+                                         start, end, num_buckets,
+                                         offset.data() + t * num_buckets,
+                                         ids.data()));
+  }
+  for (size_t t = 0; t < scatter_tasks.size(); ++t) {
+    scatter_tasks[t].get();
+  }
+  // Collapse the rows of each hash bucket in parallel
+  std::vector<std::future<std::vector<std::pair<index_t, index_t>>>> tasks;
+  for (size_t b = 0; b < num_buckets; ++b) {
+    tasks.push_back(pool.enqueue(CollapseBucket, X, Y, num_feat, 
+                                 hash.data(), ids.data(),
+                                 bucket_start[b], bucket_start[b + 1]));
+  }
+  std::vector<std::pair<index_t, index_t>> rows;
+  for (size_t t = 0; t < tasks.size(); ++t) {
+    std::vector<std::pair<index_t, index_t>> part = tasks[t].get();
+    rows.insert(rows.end(), part.begin(), part.end());
+  }
+  // Keep the order of first occurrence
+  std::sort(rows.begin(), rows.end());
+  X_out->resize((uint64)rows.size() * num_feat);
+  Y_out->resize(rows.size());
+  weight->resize(rows.size());
+  for (size_t i = 0; i < rows.size(); ++i) {
+    index_t id = rows[i].first;
+    memcpy(X_out->data() + i * num_feat,
+           X + (uint64)id * num_feat, num_feat);
+    (*Y_out)[i] = Y[id];
+    (*weight)[i] = rows[i].second;
+  }
+}
+
+}  // namespace xforest
@@ -0,0 +1,58 @@
+//------------------------------------------------------------------------------
+// Copyright (c) 2018 by contributors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//------------------------------------------------------------------------------
+
+/*
+This file defines the DedupRows function, which collapses the
+identical rows of binned data into weighted rows.
+*/
+
+#ifndef XFOREST_TREE_DEDUP_H_
+#define XFOREST_TREE_DEDUP_H_
+
+#include <vector>
+
+#include "src/base/common.h"
+
+namespace xforest {
+
+//------------------------------------------------------------------------------
+// After binning, many rows (feature bins and label) are identical.
+// DedupRows keeps one copy of each distinct row and records the
+// number of its copies as the row weight, e.g.,
+//
+//   std::vector<uint8> X_dedup;
+//   std::vector<real_t> Y_dedup;
+//   std::vector<index_t> weight;
+//   DedupRows(X, Y, num_feat, data_size, 4, &X_dedup, &Y_dedup, &weight);
+//   tree->Init(X_dedup.data(), Y_dedup.data(), num_class, 
+//              num_feat, Y_dedup.size(), hyper_param);
+//   tree->SetRowWeight(weight);
+//
+// The rows are hashed in parallel by num_threads threads, and then
+// each thread collapses the rows of its own hash buckets. The output
+// rows keep the order of their first occurrence in the input.
+// Forest runs it in Init() if HyperParam::dedup_rows is set.
+//------------------------------------------------------------------------------
+void DedupRows(const uint8* X, const real_t* Y,
+               index_t num_feat, index_t data_size,
+               int num_threads,
+               std::vector<uint8>* X_out,
+               std::vector<real_t>* Y_out,
+               std::vector<index_t>* weight);
+
+}  // namespace xforest
+
+#endif  // XFOREST_TREE_DEDUP_H_
@@ -0,0 +1,86 @@
+//------------------------------------------------------------------------------
+// Copyright (c) 2018 by contributors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//------------------------------------------------------------------------------
+
+/*
+This file tests the DedupRows function.
+*/
+
+#include "src/tree/dedup.h"
+
+#include <vector>
+
+#include "src/base/common.h"
+#include "gtest/gtest.h"
+
+using xforest::DedupRows;
+
+const index_t kNumFeat = 5;
+const index_t kDataSize = 10000;
+
+// Row i is a copy of row (i % 37), and the label
+// of row i is (i % 37) % 2.
+static void GenData(std::vector<uint8>* X, std::vector<real_t>* Y) {
+  X->resize(kDataSize * kNumFeat);
+  Y->resize(kDataSize);
+  for (index_t i = 0; i < kDataSize; ++i) {
+    index_t r = i % 37;
+    for (index_t j = 0; j < kNumFeat; ++j) {
+      (*X)[i * kNumFeat + j] = (r + j) % 37;
+    }
+    (*Y)[i] = r % 2;
+  }
+}
+
+TEST(DedupRows, Collapse) {
+  std::vector<uint8> X;
+  std::vector<real_t> Y;
+  GenData(&X, &Y);
+  for (int num_threads = 1; num_threads <= 4; ++num_threads) {
+    std::vector<uint8> X_out;
+    std::vector<real_t> Y_out;
+    std::vector<index_t> weight;
+    DedupRows(X.data(), Y.data(), kNumFeat, kDataSize,
+              num_threads, &X_out, &Y_out, &weight);
+    ASSERT_EQ(Y_out.size(), 37);
+    ASSERT_EQ(weight.size(), 37);
+    ASSERT_EQ(X_out.size(), 37 * kNumFeat);
+    index_t sum = 0;
+    for (index_t r = 0; r < 37; ++r) {
+      // Keep the order of first occurrence
+      EXPECT_EQ(Y_out[r], Y[r]);
+      for (index_t j = 0; j < kNumFeat; ++j) {
+        EXPECT_EQ(X_out[r * kNumFeat + j], X[r * kNumFeat + j]);
+      }
+      EXPECT_EQ(weight[r], kDataSize / 37 + (r < kDataSize % 37 ? 1 : 0));
+      sum += weight[r];
+    }
+    EXPECT_EQ(sum, kDataSize);
+  }
+}
+
+TEST(DedupRows, LabelDiffers) {
+  std::vector<uint8> X(4 * kNumFeat, 7);
+  std::vector<real_t> Y = {0, 1, 0, 1};
+  std::vector<uint8> X_out;
+  std::vector<real_t> Y_out;
+  std::vector<index_t> weight;
+  DedupRows(X.data(), Y.data(), kNumFeat, 4, 2, &X_out, &Y_out, &weight);
+  ASSERT_EQ(Y_out.size(), 2);
+  EXPECT_EQ(Y_out[0], 0);
+  EXPECT_EQ(Y_out[1], 1);
+  EXPECT_EQ(weight[0], 2);
+  EXPECT_EQ(weight[1], 2);
+}
@@ -20,9 +20,16 @@ This file is the implementation of DTree class.
 
 #include "src/tree/dtree.h"
 
+#include <string.h>
+#include <algorithm>
+#include <future>
 #include <queue>
 #include <numeric>
 
+#include "src/base/profiler.h"
+#include "src/base/serialize_util.h"
+#include "src/network/communicator.h"
+
 namespace xforest {
 
 //------------------------------------------------------------------------------
@@ -37,65 +44,117 @@ REGISTER_DTREE("rtree", RTree);
 // DTree class
 //------------------------------------------------------------------------------
 
+// dctor
+DTree::~DTree() {
+  DeleteNode(root_);
+}
+
+// Delete a sub-tree
+void DTree::DeleteNode(DTNode* node) {
+  if (node == nullptr) {
+    return;
+  }
+  DeleteNode(node->LeftChild());
+  DeleteNode(node->RightChild());
+  delete node;
+}
+
 // Build decision tree
 void DTree::BuildTree() {
+  PROFILE_ZONE("dtree");
+  // The row shard of a node can be empty in distributed training,
+  // and it still joins the collectives with zero histograms
+  CHECK(comm_ != nullptr || !rowIdx_.empty());
+  CHECK(!colIdx_.empty());
+  DeleteNode(root_);
+  leaf_size_ = 1;
+  tree_depth_ = 1;
   root_ = new DTNode();
   // Make root as left node
   root_->SetLeftOrRight('l');
   root_->SetLevel(1);
   root_->SetStartPos(0);
-  root_->SetEndPos(data_size_);
+  root_->SetEndPos(rowIdx_.size());
+  index_t num_samples = 0;
+  for (size_t i = 0; i < rowIdx_.size(); ++i) {
+    num_samples += RowWeight(rowIdx_[i]);
+  }
+  Allreduce(&num_samples, 1);
+  root_->SetNumSamples(num_samples);
+  // One thread syncs the histograms of all nodes
+  if (comm_ != nullptr &&
+      (mode_ == kDataParallel || mode_ == kReduceScatter)) {
+    comm_thread_.reset(new ThreadPool(1));
+  }
   // Queue for tree growing
-  std::queue<DTNode*> queue;
-  queue.push(root_);
-  while (!queue.empty()) {
-    DTNode* node = queue.front();
-    if (IsLeaf(node) == false) {
-      FindPosition(node);
-      SplitData(node);
-      // New left child
-      DTNode* l_node = new DTNode();
-      l_node->SetLeftOrRight('l');
-      l_node->SetStartPos(node->StartPos());
-      l_node->SetEndPos(node->MidPos());
-      l_node->SetLevel(node->Level() + 1);
-      // New right child
-      DTNode* r_node = new DTNode();
-      r_node->SetLeftOrRight('r');
-      r_node->SetStartPos(node->MidPos() + 1);
-      r_node->SetEndPos(node->EndPos());
-      r_node->SetLevel(node->Level() + 1);
-      // Right node can use parent and
-      // brother to calculate histogram bin value
-      r_node->SetParent(node);
-      r_node->SetBrother(node);
-      // Push new node
-      node->SetLeftChild(l_node);
-      node->SetRightChild(r_node);
-      queue.push(l_node);
-      queue.push(r_node);
-      if (r_node->Level() > tree_depth_) {
-        tree_depth_ = r_node->Level();
-      }
-      leaf_size_++;
+  queue_.clear();
+  queue_.push_back(root_);
+  while (!queue_.empty()) {
+    TRACE_ZONE("node");
+    DTNode* node = queue_.front();
+    queue_.pop_front();
+    if (IsLeaf(node)) {
+      continue;
     }
-    queue.pop();
+    FindPosition(node);
+    if (node->LeftSamples() == 0) {
+      // Cannot find a valid split
+      SetLeafNode(node);
+      continue;
+    }
+    SplitData(node);
+    // New left child
+    DTNode* l_node = new DTNode();
+    l_node->SetLeftOrRight('l');
+    l_node->SetStartPos(node->StartPos());
+    l_node->SetEndPos(node->MidPos());
+    l_node->SetLevel(node->Level() + 1);
+    l_node->SetNumSamples(node->LeftSamples());
+    // New right child
+    DTNode* r_node = new DTNode();
+    r_node->SetLeftOrRight('r');
+    r_node->SetStartPos(node->MidPos());
+    r_node->SetEndPos(node->EndPos());
+    r_node->SetLevel(node->Level() + 1);
+    r_node->SetNumSamples(node->NumSamples() - node->LeftSamples());
+    // Right node can use parent and
+    // brother to calculate histogram bin value
+    r_node->SetParent(node);
+    r_node->SetBrother(l_node);
+    // Push new node
+    node->SetLeftChild(l_node);
+    node->SetRightChild(r_node);
+    queue_.push_back(l_node);
+    queue_.push_back(r_node);
+    if (r_node->Level() > tree_depth_) {
+      tree_depth_ = r_node->Level();
+    }
+    leaf_size_++;
   }
+  comm_thread_.reset();
 }
 
 // If current node is a leaf node?
 bool DTree::IsLeaf(DTNode* node) {
-  if (node->Level() == max_depth_ ||
-      node->DataSize() < min_samples_split_) {
-    node->SetLeaf();
-    node->SetLeafVal(LeafVal(node));
-    // Clear tmp info
-    node->Clear();
+  if (ReachLimit(node)) {
+    SetLeafNode(node);
     return true;
   }
   return false;
 }
 
+// Make current node a leaf node
+void DTree::SetLeafNode(DTNode* node) {
+  PROFILE_ZONE("leaf");
+  node->SetLeaf();
+  node->SetLeafVal(LeafVal(node));
+  // Clear tmp info
+  if (node->LeftOrRight() == 'r') {
+    node->ClearParent();
+  }
+  node->Clear();
+}
+
 // Get a leaf node by given the data x
 DTNode* DTree::GetLeaf(DTNode* node, const uint8* x) {
   if (node->IsLeaf()) {
@@ -116,14 +175,76 @@ real_t DTree::Predict(const uint8* x) {
   return leaf_node->LeafVal();
 }
 
+// Get the ids of the features used by split nodes
+void DTree::GetSplitFeatures(std::vector<index_t>* feat_ids) {
+  CHECK_NOTNULL(feat_ids);
+  feat_ids->clear();
+  if (root_ == nullptr) {
+    return;
+  }
+  std::queue<DTNode*> queue;
+  queue.push(root_);
+  while (!queue.empty()) {
+    DTNode* node = queue.front();
+    queue.pop();
+    if (!node->IsLeaf()) {
+      feat_ids->push_back(node->BestFeatID());
+      queue.push(node->LeftChild());
+      queue.push(node->RightChild());
+    }
+  }
+  std::sort(feat_ids->begin(), feat_ids->end());
+  feat_ids->erase(std::unique(feat_ids->begin(), feat_ids->end()),
+                  feat_ids->end());
+}
+
+// Serilize the sub-tree in pre-order
+static void SerilizeNode(const DTNode* node, std::string* str) {
+  WriteValue<uint8>(node->IsLeaf() ? 1 : 0, str);
+  if (node->IsLeaf()) {
+    WriteValue<real_t>(node->LeafVal(), str);
+    return;
+  }
+  WriteValue<index_t>(node->BestFeatID(), str);
+  WriteValue<uint8>(node->BestBinVal(), str);
+  SerilizeNode(node->LeftChild(), str);
+  SerilizeNode(node->RightChild(), str);
+}
+
+// Deserilize the sub-tree from str[*pos]
+static DTNode* DeserilizeNode(const std::string& str, size_t* pos) {
+  DTNode* node = new DTNode();
+  node->Clear();
+  if (ReadValue<uint8>(str, pos) == 1) {
+    node->SetLeaf();
+    node->SetLeafVal(ReadValue<real_t>(str, pos));
+    return node;
+  }
+  node->SetBestFeatID(ReadValue<index_t>(str, pos));
+  node->SetBestBinVal(ReadValue<uint8>(str, pos));
+  node->SetLeftChild(DeserilizeNode(str, pos));
+  node->SetRightChild(DeserilizeNode(str, pos));
+  return node;
+}
+
 // Serilize tree to string
 void DTree::Serilize(std::string* str) {
-  return;
+  CHECK_NOTNULL(str);
+  CHECK_NOTNULL(root_);
+  str->clear();
+  WriteValue<uint8>(tree_depth_, str);
+  WriteValue<index_t>(leaf_size_, str);
+  SerilizeNode(root_, str);
 }
 
 // Deserilize tree from string
 void DTree::Deserilize(const std::string& str) {
-  return;
+  DeleteNode(root_);
+  size_t pos = 0;
+  tree_depth_ = ReadValue<uint8>(str, &pos);
+  leaf_size_ = ReadValue<index_t>(str, &pos);
+  root_ = DeserilizeNode(str, &pos);
+  CHECK_EQ(pos, str.size());
 }
 
 // Print decision to human-readable txt format
@@ -131,26 +252,315 @@ void DTree::PrintToTXT(std::string* str) {
   return;
 }
 
+// Column of X of a global feature id
+index_t DTree::FeatColumn(index_t feat_id) const {
+  if (feat_map_.empty()) {
+    return feat_id;
+  }
+  std::vector<index_t>::const_iterator it = 
+    std::find(feat_map_.begin(), feat_map_.end(), feat_id);
+  CHECK(it != feat_map_.end());
+  return it - feat_map_.begin();
+}
+
+// Sum data over the row shards of the cluster
+void DTree::Allreduce(index_t* data, size_t len) {
+  if (comm_ != nullptr && mode_ != kFeatureParallel) {
+    comm_->Allreduce(data, len);
+  }
+}
+
+// Features [begin, end) of colIdx_ held by local node
+void DTree::HistoRange(index_t* begin, index_t* end) {
+  index_t col_size = colIdx_.size();
+  if (comm_ == nullptr || mode_ != kReduceScatter) {
+    *begin = 0;
+    *end = col_size;
+    return;
+  }
+  *begin = ChunkStart(col_size, comm_->Size(), comm_->Rank());
+  *end = ChunkStart(col_size, comm_->Size(), comm_->Rank() + 1);
+}
+
+// Sum the local histogram over the cluster
+void DTree::SyncHisto(index_t* count, index_t feat_len) {
+  if (comm_ == nullptr) {
+    return;
+  }
+  if (mode_ == kDataParallel) {
+    comm_->Allreduce(count, (size_t)colIdx_.size() * feat_len);
+    return;
+  }
+  if (mode_ == kVoting || mode_ == kFeatureParallel) {
+    // Keep local histogram
+    return;
+  }
+  // Block r has the features of node r
+  int size = comm_->Size();
+  std::vector<size_t> starts(size + 1);
+  for (int r = 0; r <= size; ++r) {
+    starts[r] = ChunkStart(colIdx_.size(), size, r) * feat_len;
+  }
+  comm_->ReduceScatter(count, starts);
+}
+
+// Sum the histogram of node over the cluster, and build
+// the local histogram of the next node meanwhile
+void DTree::SyncAndPrefetch(DTNode* node) {
+  Histogram* histo = node->Histo();
+  // Only the histogram of the next left node can be built 
+  // before the current node is split, since a right node 
+  // may need the histogram of its brother
+  DTNode* next = nullptr;
+  for (size_t i = 0; i < queue_.size() && i < 2; ++i) {
+    if (queue_[i]->LeftOrRight() == 'l') {
+      next = queue_[i];
+      break;
+    }
+  }
+  if (comm_ == nullptr ||
+      (mode_ != kDataParallel && mode_ != kReduceScatter) ||
+      next == nullptr || ReachLimit(next) || 
+      next->Histo() != nullptr) {
+    PROFILE_ZONE("sync");
+    SyncHisto(histo->Data(), histo->FeatLen());
+    return;
+  }
+  // The main thread does not communicate until sync is done.
+  // The sync is not profiled in comm_thread_, whose zones are
+  // not in the stats of the tree. The part of it which is not
+  // hidden by the next histogram is "sync_wait" of the main
+  // thread.
+  std::future<void> sync = comm_thread_->enqueue(
+    [this, histo]() {
+      SyncHisto(histo->Data(), histo->FeatLen());
+    });
+  Histogram* next_histo = NewHisto();
+  {
+    PROFILE_ZONE("histogram");
+    BuildHisto(next, next_histo);
+  }
+  next->SetHisto(next_histo);
+  PROFILE_ZONE("sync_wait");
+  sync.get();
+}
+
+// Find best split position for current node
+void DTree::FindPosition(DTNode* node) {
+  // Features searched by local node
+  index_t feat_begin = 0;
+  index_t feat_end = 0;
+  HistoRange(&feat_begin, &feat_end);
+  Histogram* histo = node->Histo();
+  if (NeedBuild(node)) {
+    // The local histogram may have been built by prefetching
+    if (histo == nullptr) {
+      PROFILE_ZONE("histogram");
+      histo = NewHisto();
+      BuildHisto(node, histo);
+      node->SetHisto(histo);
+    }
+    SyncAndPrefetch(node);
+  } else {  // histo = parent_histo - brother_histo
+    PROFILE_ZONE("subtract");
+    histo = NewHisto();
+    node->SetHisto(histo);
+    index_t* count = histo->Data();
+    index_t* count_parent = node->Parent()->Histo()->Data();
+    index_t* count_brother = node->Brother()->Histo()->Data();
+    index_t feat_len = histo->FeatLen();
+    index_t end = feat_end * feat_len;
+    for (index_t i = feat_begin * feat_len; i < end; ++i) {
+      count[i] = count_parent[i] - count_brother[i];
+    }
+  }
+  if (node->LeftOrRight() == 'r') {
+    node->ClearParent();
+  }
+  FindBestSplit(node, histo->Data(), histo->FeatLen(), 
+                feat_begin, feat_end);
+}
+
+// Index of the first best valid split, -1 if none
+static int FirstBest(const SplitInfo* splits, size_t len) {
+  int best = -1;
+  for (size_t i = 0; i < len; ++i) {
+    if (splits[i].left_samples > 0 &&
+        (best < 0 || splits[i].gini < splits[best].gini)) {
+      best = i;
+    }
+  }
+  return best;
+}
+
+// Set the best split of node, or mark no valid split
+static void SetSplit(DTNode* node, const SplitInfo* splits, int best) {
+  if (best < 0) {
+    node->SetLeftSamples(0);
+    return;
+  }
+  node->SetBestGini(splits[best].gini);
+  node->SetBestFeatID(splits[best].feat_id);
+  node->SetBestBinVal(splits[best].bin_val);
+  node->SetLeftSamples(splits[best].left_samples);
+}
+
+// Agree on the best split of node over the cluster
+void DTree::SyncSplit(DTNode* node) {
+  if (comm_ == nullptr || mode_ == kDataParallel) {
+    return;
+  }
+  SplitInfo local;
+  local.gini = node->BestGini();
+  local.feat_id = node->BestFeatID();
+  local.bin_val = node->BestBinVal();
+  local.left_samples = node->LeftSamples();
+  std::vector<SplitInfo> splits(comm_->Size());
+  comm_->AllGather(&local, 1, splits.data());
+  // The blocks are in feature order, so taking the first best 
+  // split gives the same tree as the local training
+  int best = FirstBest(splits.data(), splits.size());
+  SetSplit(node, splits.data(), best);
+  node->SetSplitRank(best);
+}
+
+// Find the best split of node and agree on it over the cluster
+void DTree::FindBestSplit(DTNode* node, const index_t* count, 
+                          index_t feat_len, index_t feat_begin, 
+                          index_t feat_end) {
+  PROFILE_ZONE("split_scan");
+  if (comm_ != nullptr && mode_ == kVoting) {
+    VoteSplit(node, count, feat_len);
+    return;
+  }
+  index_t num = feat_end - feat_begin;
+  std::vector<SplitInfo> best(num);
+  if (num > 0) {
+    FindSplit(count + feat_begin * feat_len, num, best.data());
+  }
+  for (index_t i = 0; i < num; ++i) {
+    best[i].feat_id = FeatID(colIdx_[feat_begin + i]);
+  }
+  SetSplit(node, best.data(), FirstBest(best.data(), num));
+  SyncSplit(node);
+}
+
+// Find the best split of node in kVoting mode
+void DTree::VoteSplit(DTNode* node, const index_t* count, 
+                      index_t feat_len) {
+  index_t col_size = colIdx_.size();
+  index_t k = std::min(top_k_, col_size);
+  // Local top-k features by the local best split
+  std::vector<SplitInfo> local(col_size);
+  FindSplit(count, col_size, local.data());
+  std::vector<index_t> order;
+  for (index_t j = 0; j < col_size; ++j) {
+    if (local[j].left_samples > 0) {
+      order.push_back(j);
+    }
+  }
+  std::stable_sort(order.begin(), order.end(), 
+    [&local](index_t a, index_t b) {
+      return local[a].gini < local[b].gini;
+    });
+  std::vector<index_t> votes(k, col_size);  // col_size means no vote
+  for (index_t i = 0; i < k && i < order.size(); ++i) {
+    votes[i] = order[i];
+  }
+  // Global voting
+  std::vector<index_t> all_votes(k * comm_->Size());
+  comm_->AllGather(votes.data(), k, all_votes.data());
+  std::vector<index_t> num_votes(col_size, 0);
+  for (size_t i = 0; i < all_votes.size(); ++i) {
+    if (all_votes[i] < col_size) {
+      num_votes[all_votes[i]]++;
+    }
+  }
+  std::vector<index_t> cand;
+  for (index_t j = 0; j < col_size; ++j) {
+    if (num_votes[j] > 0) {
+      cand.push_back(j);
+    }
+  }
+  std::stable_sort(cand.begin(), cand.end(),
+    [&num_votes](index_t a, index_t b) {
+      return num_votes[a] > num_votes[b];
+    });
+  if (cand.size() > 2 * k) {
+    cand.resize(2 * k);
+  }
+  std::sort(cand.begin(), cand.end());
+  // Aggregate the histograms of the candidates
+  TrackedVector<index_t, kMemNetwork> buf(cand.size() * feat_len);
+  for (size_t i = 0; i < cand.size(); ++i) {
+    memcpy(buf.data() + i * feat_len, count + cand[i] * feat_len,
+           feat_len * sizeof(index_t));
+  }
+  comm_->Allreduce(buf.data(), buf.size());
+  std::vector<SplitInfo> best(cand.size());
+  if (!cand.empty()) {
+    FindSplit(buf.data(), cand.size(), best.data());
+  }
+  for (size_t i = 0; i < cand.size(); ++i) {
+    best[i].feat_id = FeatID(colIdx_[cand[i]]);
+  }
+  SetSplit(node, best.data(), FirstBest(best.data(), best.size()));
+}
+
 // Split current node
 void DTree::SplitData(DTNode* node) {
-  index_t ptr_head = node->StartPos();
-  index_t ptr_tail = node->EndPos();
+  PROFILE_ZONE("partition");
+  if (comm_ != nullptr && mode_ == kFeatureParallel) {
+    SplitByBitmap(node);
+    return;
+  }
+  index_t start_pos = node->StartPos();
+  index_t end_pos = node->EndPos();
   index_t best_feat_id = node->BestFeatID();
   uint8 best_bin_val = node->BestBinVal();
-  uint8* ptr = X_ + best_feat_id;
-  while (ptr_head < ptr_tail) {
-    uint8 bin = *(ptr + rowIdx_[ptr_head] * num_feat_);
-    if (bin <= best_bin_val) {
-      ptr_head++;
+  uint8* ptr = X_ + FeatColumn(best_feat_id);
+  index_t num_feat = num_feat_;
+  auto mid = 
+    std::partition(rowIdx_.begin() + start_pos,
+                   rowIdx_.begin() + end_pos,
+                   [ptr, num_feat, best_bin_val](index_t row) {
+                     return ptr[(uint64)row * num_feat] <= best_bin_val;
+                   });
+  // Local part of a child can be empty in distributed training
+  node->SetMidPos(mid - rowIdx_.begin());
+}
+
+// Split current node by the row bitmap
+void DTree::SplitByBitmap(DTNode* node) {
+  index_t start_pos = node->StartPos();
+  index_t data_size = node->DataSize();
+  int split_rank = node->SplitRank();
+  // Bit i is set if row rowIdx_[start_pos + i] goes left
+  TrackedVector<uint8, kMemNetwork> bitmap((data_size + 7) / 8, 0);
+  if (split_rank == comm_->Rank()) {
+    uint8* ptr = X_ + FeatColumn(node->BestFeatID());
+    uint8 best_bin_val = node->BestBinVal();
+    for (index_t i = 0; i < data_size; ++i) {
+      uint64 row = rowIdx_[start_pos + i];
+      if (ptr[row * num_feat_] <= best_bin_val) {
+        bitmap[i >> 3] |= 1 << (i & 7);
+      }
+    }
+  }
+  comm_->Broadcast(bitmap.data(), bitmap.size(), split_rank);
+  // Stable partition, so that all nodes keep the same row order
+  std::vector<index_t> right;
+  index_t mid = start_pos;
+  for (index_t i = 0; i < data_size; ++i) {
+    index_t row = rowIdx_[start_pos + i];
+    if (bitmap[i >> 3] & (1 << (i & 7))) {
+      rowIdx_[mid++] = row;
     } else {
-      // swap head and tail
-      rowIdx_[ptr_head] ^= rowIdx_[ptr_tail];
-      rowIdx_[ptr_tail] ^= rowIdx_[ptr_head];
-      rowIdx_[ptr_head] ^= rowIdx_[ptr_tail];
-      ptr_tail--;
+      right.push_back(row);
     }
   }
-  node->SetMidPos(ptr_head-1);
+  std::copy(right.begin(), right.end(), rowIdx_.begin() + mid);
+  node->SetMidPos(mid);
 }
 
 //------------------------------------------------------------------------------
@@ -163,103 +573,114 @@ real_t BTree::LeafVal(const DTNode* node) {
   index_t count_1 = 0;
   index_t start_pos = node->StartPos();
   index_t end_pos = node->EndPos();
-  index_t len = node->DataSize();
-  for (index_t i = start_pos; i <= end_pos; ++i) {
-    if (Y_[rowIdx_[i]] == 0) {
-      count_0++;
+  for (index_t i = start_pos; i < end_pos; ++i) {
+    index_t row_idx = rowIdx_[i];
+    if (Y_[row_idx] == 0) {
+      count_0 += RowWeight(row_idx);
+    } else {
+      count_1 += RowWeight(row_idx);
     }
-    count_1 = len - count_0;
   }
-  return count_0 > count_1 ? 0.0 : 1.0;
+  index_t count[2] = {count_0, count_1};
+  Allreduce(count, 2);
+  return count[0] > count[1] ? 0.0 : 1.0;
 }
 
-// Calculate gini value
+// Calculate gini value of a split
 real_t BTree::Gini(const real_t left_0, 
                    const real_t left_1,
                    const real_t right_0,
                    const real_t right_1) {
-  index_t all_left = left_0 + left_1;
-  index_t all_right = right_0 + right_1;
-  index_t all = all_right + all_left;
-  real_t gini_left = 1.0 - 
-    ((real_t)((left_0*left_0) + (left_1*left_1)) / 
-      (real_t)(all_left*all_left));
-  real_t gini_right = 1.0 - 
-    ((real_t)((right_0*right_0) + (right_1*right_1)) / 
-      (real_t)(all_right*all_right));
-  return ((real_t)all_left / all) * gini_left +
-         ((real_t)all_right / all) * gini_right;
+  real_t all_left = left_0 + left_1;
+  real_t all_right = right_0 + right_1;
+  real_t all = all_right + all_left;
+  return (all_left / all) * Gini(left_0, left_1) +
+         (all_right / all) * Gini(right_0, right_1);
 }
 
-// Find best split position for current node
-void BTree::FindPosition(DTNode* node) {
-  BHistogram* histo = (BHistogram*)node->Histo();
-  histo = new BHistogram(num_feat_, max_bin_);
-  // Collect histogram
-  index_t total_0 = 0;
-  index_t total_1 = 0;
-  index_t len = node->DataSize();
+// Calculate gini value of a node
+real_t BTree::Gini(const real_t count_0, const real_t count_1) {
+  real_t all = count_0 + count_1;
+  return 1.0 - (count_0*count_0 + count_1*count_1) / (all*all);
+}
+
+// Create an empty histogram of colIdx_
+Histogram* BTree::NewHisto() {
+  return new BHistogram(colIdx_.size(), max_bin_ + 1);
+}
+
+// Add the local rows of node to histo
+void BTree::BuildHisto(const DTNode* node, Histogram* histo) {
+  BHistogram* b_histo = static_cast<BHistogram*>(histo);
+  index_t col_size = colIdx_.size();
   index_t start_pos = node->StartPos();
   index_t end_pos = node->EndPos();
-  index_t col_size = colIdx_.size();
-  // If node is left node or
-  // node is right but brother is leaf
-  if (node->LeftOrRight() == 'l' || 
-      node->Brother()->IsLeaf()) {
-    for (index_t i = start_pos; i <= end_pos; ++i) {
-      index_t row_idx = rowIdx_[i];
-      uint8* ptr = X_ + row_idx * num_feat_;
-      if (Y_[row_idx] == 0) {
-        total_0++;
-        for (index_t j = 0; j < col_size; ++j) {
-          uint8 bin = *(ptr + colIdx_[j]);
-          histo->count[j][bin].count_0++;
-        }
-      } else {
-        for (index_t j = 0; j < col_size; ++j) {
-          uint8 bin = *(ptr + colIdx_[j]);
-          histo->count[j][bin].count_1++;
-        }
+  for (index_t i = start_pos; i < end_pos; ++i) {
+    index_t row_idx = rowIdx_[i];
+    index_t w = RowWeight(row_idx);
+    uint8* ptr = X_ + (uint64)row_idx * num_feat_;
+    if (Y_[row_idx] == 0) {
+      for (index_t j = 0; j < col_size; ++j) {
+        uint8 bin = *(ptr + colIdx_[j]);
+        b_histo->Feat(j)[bin].count_0 += w;
       }
-    }
-    total_1 = len - total_0;
-  } else {  // histo = parent_histo - brother_histo
-    BHistogram* parent = (BHistogram*)node->Parent()->Histo();
-    BHistogram* brother = (BHistogram*)node->Brother()->Histo();
-    total_0 = parent->total_0 - brother->total_0;
-    total_1 = parent->total_1 - brother->total_1;
-    for (index_t i = 0; i < col_size; ++i) {
-      for (index_t j = 0; j <= max_bin_; ++j) {
-        histo->count[i][j].count_0 = 
-          parent->count[i][j].count_0 - brother->count[i][j].count_0;
-       	histo->count[i][j].count_1 = 
-          parent->count[i][j].count_1 - brother->count[i][j].count_1;
+    } else {
+      for (index_t j = 0; j < col_size; ++j) {
+        uint8 bin = *(ptr + colIdx_[j]);
+        b_histo->Feat(j)[bin].count_1 += w;
       }
     }
   }
-  histo->total_0 = total_0;
-  histo->total_1 = total_1;
-  // Find best split position
-  for (index_t i = 0; i < col_size; ++i) {
-    Count* count = histo->count[i];
+}
+
+// Find the best split of each feature in histogram
+void BTree::FindSplit(const index_t* count, index_t num_hist_feat,
+                      SplitInfo* best) {
+  index_t num_bin = max_bin_ + 1;
+  const Count* hist = reinterpret_cast<const Count*>(count);
+  for (index_t i = 0; i < num_hist_feat; ++i) {
+    best[i].gini = 1.0;
+    best[i].left_samples = 0;
+  }
+  // Every sample falls in one bin of a feature
+  index_t total_0 = 0;
+  index_t total_1 = 0;
+  for (index_t b = 0; b < num_bin; ++b) {
+    total_0 += hist[b].count_0;
+    total_1 += hist[b].count_1;
+  }
+  index_t total = total_0 + total_1;
+  if (total == 0) {
+    return;
+  }
+  real_t node_gini = Gini(total_0, total_1);
+  if (node_gini <= min_impurity_) {
+    return;
+  }
+  for (index_t i = 0; i < num_hist_feat; ++i) {
+    const Count* bins = hist + i * num_bin;
     index_t left_0 = 0;
     index_t left_1 = 0;
-    for (index_t j = 0; j <= max_bin_; ++j) {
-      left_0 += count[j].count_0;
-      left_1 += count[j].count_1;
-      index_t right_0 = total_0 - left_0;
-      index_t right_1 = total_1 - left_1;
-      real_t gini = Gini(left_0, left_1, right_0, right_1);
-      if (gini < node->BestGini()) {
-        node->SetBestGini(gini);
-        node->SetBestFeatID(colIdx_[j]);
-        node->SetBestBinVal(i);
+    // The last bin makes an empty right child
+    for (index_t j = 0; j < max_bin_; ++j) {
+      left_0 += bins[j].count_0;
+      left_1 += bins[j].count_1;
+      index_t left = left_0 + left_1;
+      if (left < min_samples_leaf_ ||
+          total - left < min_samples_leaf_) {
+        continue;
+      }
+      real_t gini = Gini(left_0, left_1, 
+                         total_0 - left_0, 
+                         total_1 - left_1);
+      if (gini < best[i].gini &&
+          node_gini - gini >= min_impurity_dec_) {
+        best[i].gini = gini;
+        best[i].bin_val = j;
+        best[i].left_samples = left;
       }
     }
   }
-  if (node->LeftOrRight() == 'r') {
-    node->ClearParent();
-  }
 }
 
 //------------------------------------------------------------------------------
@@ -272,92 +693,109 @@ real_t MCTree::LeafVal(const DTNode* node) {
   std::vector<index_t>::iterator result;
   index_t start_pos = node->StartPos();
   index_t end_pos = node->EndPos();
-  for (index_t i = start_pos; i <= end_pos; ++i) {
-    count[Y_[rowIdx_[i]]]++;
+  for (index_t i = start_pos; i < end_pos; ++i) {
+    index_t row_idx = rowIdx_[i];
+    count[Y_[row_idx]] += RowWeight(row_idx);
   }
+  Allreduce(count.data(), count.size());
   result = std::max_element(count.begin(), count.end());
   return (real_t)std::distance(count.begin(), result);
 }
 
-// Find best split position for current node
-void MCTree::FindPosition(DTNode* node) {
-  MCHistogram* histo = (MCHistogram*)node->Histo();
-  histo = new MCHistogram(num_feat_, max_bin_, num_class_);
-  index_t len = node->DataSize();
+// Calculate gini value by given class count
+static real_t MCGini(const index_t* count, index_t sum, uint8 num_class) {
+  real_t square_sum = 0.0;
+  for (uint8 c = 0; c < num_class; ++c) {
+    real_t tmp = (real_t)count[c] / sum;
+    square_sum += tmp*tmp;
+  }
+  return 1.0 - square_sum;
+}
+
+// Create an empty histogram of colIdx_
+Histogram* MCTree::NewHisto() {
+  return new MCHistogram(colIdx_.size(), max_bin_ + 1, num_class_);
+}
+
+// Add the local rows of node to histo
+void MCTree::BuildHisto(const DTNode* node, Histogram* histo) {
+  index_t col_size = colIdx_.size();
+  index_t num_bin = max_bin_ + 1;
   index_t start_pos = node->StartPos();
   index_t end_pos = node->EndPos();
-  index_t* count = histo->count;
-  index_t col_size = colIdx_.size();
-  index_t cc = num_class_ * col_size;
-  // Collect histogram
-  if (node->LeftOrRight() == 'l' ||
-      node->Brother()->IsLeaf()) {
-    for (index_t i = start_pos; i <= end_pos; ++i) {
-      index_t row_idx = rowIdx_[i];
-      int y = Y_[row_idx];
-      uint8* ptr = X_ + row_idx * num_feat_;
-      for (index_t j = 0; j < col_size; ++j) {
-        count[num_class_*(*(ptr+colIdx_[j])*col_size+j)+y]++;
-      }
-    }
-  } else {
-    MCHistogram* histo_parent = (MCHistogram*)node->Parent()->Histo();
-    index_t* count_parent = histo_parent->count;
-    MCHistogram* histo_brother = (MCHistogram*)node->Brother()->Histo();
-    index_t* count_brother = histo_brother->count;
-    index_t count_len = histo->count_len;
-    for (index_t i = 0; i < count_len; ++i) {
-      count[i] = count_parent[i] - count_brother[i];
+  index_t* count = histo->Data();
+  for (index_t i = start_pos; i < end_pos; ++i) {
+    index_t row_idx = rowIdx_[i];
+    index_t w = RowWeight(row_idx);
+    int y = Y_[row_idx];
+    uint8* ptr = X_ + (uint64)row_idx * num_feat_;
+    for (index_t j = 0; j < col_size; ++j) {
+      count[(j*num_bin+*(ptr+colIdx_[j]))*num_class_+y] += w;
     }
   }
-  // Sum total count
+}
+
+// Find the best split of each feature in histogram
+void MCTree::FindSplit(const index_t* count, index_t num_hist_feat,
+                       SplitInfo* best) {
+  index_t num_bin = max_bin_ + 1;
+  for (index_t j = 0; j < num_hist_feat; ++j) {
+    best[j].gini = 1.0;
+    best[j].left_samples = 0;
+  }
+  // Every sample falls in one bin of a feature
   std::vector<index_t> total_count(num_class_, 0);
-  for (index_t i = 0; i <= max_bin_; ++i) {
-    index_t* ptr = count + i*cc;
+  for (index_t i = 0; i < num_bin; ++i) {
+    const index_t* ptr = count + i*num_class_;
     for (uint8 c = 0; c < num_class_; ++c) {
-      total_count[c] += *ptr;
-      ptr++;
+      total_count[c] += ptr[c];
     }
   }
+  index_t total = 
+    std::accumulate(total_count.begin(), total_count.end(), 0);
+  if (total == 0) {
+    return;
+  }
+  real_t node_gini = MCGini(total_count.data(), total, num_class_);
+  if (node_gini <= min_impurity_) {
+    return;
+  }
   // Find best split position
-  for (index_t j = 0; j < col_size; ++j) {
-    std::vector<index_t> left_count(num_class_, 0);
-    std::vector<index_t> right_count(total_count);
-    index_t* base_ptr = count + j*num_class_;
-    for (index_t i = 0; i <= max_bin_; ++i) {
-      index_t* ptr = base_ptr + cc*i;
+  std::vector<index_t> left_count(num_class_);
+  std::vector<index_t> right_count(num_class_);
+  for (index_t j = 0; j < num_hist_feat; ++j) {
+    std::fill(left_count.begin(), left_count.end(), 0);
+    index_t left_sum = 0;
+    const index_t* base_ptr = count + j*num_bin*num_class_;
+    // The last bin makes an empty right child
+    for (index_t i = 0; i < max_bin_; ++i) {
+      const index_t* ptr = base_ptr + i*num_class_;
       for (uint8 c = 0; c < num_class_; ++c) {
-        left_count[c] += *ptr;
-        right_count[c] -= *ptr;
-        ptr++;
+        left_count[c] += ptr[c];
+        left_sum += ptr[c];
+      }
+      index_t right_sum = total - left_sum;
+      if (left_sum < min_samples_leaf_ ||
+          right_sum < min_samples_leaf_) {
+        continue;
       }
-      index_t left_sum = 
-        std::accumulate(left_count.begin(), left_count.end(), 0);
-      index_t right_sum = 
-        std::accumulate(right_count.begin(), right_count.end(), 0);
-      real_t real_left_sum = 0.0;
-      real_t real_right_sum = 0.0;
       for (uint8 c = 0; c < num_class_; ++c) {
-        real_t tmp = (real_t)left_count[c] / left_sum;
-        real_left_sum += tmp*tmp;
-        tmp = (real_t)right_count[c] / right_sum;
-        real_right_sum += tmp*tmp;
+        right_count[c] = total_count[c] - left_count[c];
       }
-      real_t left_gini = 1.0 - real_left_sum;
-      left_gini *= (real_t)left_sum / len;
-      real_t right_gini = 1.0 - real_right_sum;
-      right_gini *= (real_t)right_sum / len;
-      real_t gini = left_gini + right_gini;
-      if (gini < node->BestGini()) {
-        node->SetBestGini(gini);
-        node->SetBestFeatID(colIdx_[j]);
-        node->SetBestBinVal(i);
+      real_t left_gini = 
+        MCGini(left_count.data(), left_sum, num_class_);
+      real_t right_gini = 
+        MCGini(right_count.data(), right_sum, num_class_);
+      real_t gini = left_gini * ((real_t)left_sum / total) +
+                    right_gini * ((real_t)right_sum / total);
+      if (gini < best[j].gini &&
+          node_gini - gini >= min_impurity_dec_) {
+        best[j].gini = gini;
+        best[j].bin_val = i;
+        best[j].left_samples = left_sum;
       }
     }
   }
-  if (node->LeftOrRight() == 'r') {
-    node->ClearParent();
-  }
 }
 
 //------------------------------------------------------------------------------
@@ -369,9 +807,25 @@ real_t RTree::LeafVal(const DTNode* node) {
   return 0;	
 }
 
+// Create an empty histogram of colIdx_
+Histogram* RTree::NewHisto() {
+  return new RHistogram(colIdx_.size(), max_bin_ + 1);
+}
+
+// Add the local rows of node to histo
+void RTree::BuildHisto(const DTNode* node, Histogram* histo) {
+
+}
+
 // Find best split position for current node
 void RTree::FindPosition(DTNode* node) {
   
 }
 
+// Find the best split of each feature in histogram
+void RTree::FindSplit(const index_t* count, index_t num_hist_feat,
+                      SplitInfo* best) {
+
+}
+
 }  // namespace xforest
\ No newline at end of file
@@ -23,8 +23,13 @@ This file defines the DTree class.
 
 #include "src/base/common.h"
 #include "src/base/class_register.h"
+#include "src/base/memory_tracker.h"
+#include "src/base/scoped_ptr.h"
+#include "src/base/thread_pool.h"
 #include "src/solver/hyper_parameter.h"
 
+#include <deque>
+#include <string>
 #include <vector>
 
 namespace xforest {
@@ -39,12 +44,65 @@ struct MaxMin {
 };
 
 class DTNode;
+class Communicator;
+
+/*!
+ * \brief How the nodes of a cluster aggregate histograms
+ */
+enum ParallelMode {
+  // Allreduce the full histograms
+  kDataParallel,
+  // Reduce-scatter the histograms by feature block, so
+  // each node searches its own features, and then
+  // allgather the best split of each node
+  kReduceScatter,
+  // Voting-parallel (PV-tree): each node votes its local
+  // top-k features, and only the histograms of the 2k
+  // most voted features are allreduced
+  kVoting,
+  // Feature-parallel: each node holds all rows of its own
+  // columns, and the winner of each split broadcasts the
+  // row partition as a bitmap
+  kFeatureParallel
+};
+
+/*!
+ * \brief Best split of a feature or a node
+ */
+struct SplitInfo {
+  real_t gini;
+  index_t feat_id;
+  index_t bin_val;
+  index_t left_samples;
+};
+
+/*!
+ * \brief Base class of histogram
+ */
+class Histogram {
+ public:
+  Histogram() {}
+  virtual ~Histogram() {}
+  // Counters of the histogram, which are feature-major
+  virtual index_t* Data() { return nullptr; }
+  // Number of counters of each feature
+  virtual index_t FeatLen() const { return 0; }
+ private:
+  DISALLOW_COPY_AND_ASSIGN(Histogram);
+};
 
 /*!
  * \brief temp information during training
  */
 class TInfo {
  public:
+  TInfo() {
+    MemoryTracker::Alloc(kMemTreeNode, sizeof(TInfo));
+  }
+  ~TInfo() {
+    delete histo;
+    MemoryTracker::Free(kMemTreeNode, sizeof(TInfo));
+  }
   /*!
    * \brief left node or right node
    */
@@ -58,17 +116,26 @@ class TInfo {
    */
   index_t start_pos = 0;
   /*!
-   * \brief end position
+   * \brief end position (exclusive)
    */
   index_t end_pos = 0;
   /*!
-   * \brief mid split position
+   * \brief mid split position (start of right child)
    */
   index_t mid_pos = 0;
   /*!
    * \brief best gini value
    */
   real_t best_gini = 1.0;
+  /*!
+   * \brief number of samples (sum of row weights)
+   */
+  index_t num_samples = 0;
+  /*!
+   * \brief number of samples of the best left child,
+   * 0 means no valid split is found
+   */
+  index_t left_samples = 0;
   /*!
    * \brief parent node
    */
@@ -80,7 +147,11 @@ class TInfo {
   /*!
    * \brief histogram bin
    */
-  void* histo = nullptr;
+  Histogram* histo = nullptr;
+  /*!
+   * \brief rank holding the split feature (kFeatureParallel)
+   */
+  int split_rank = 0;
  private:
   DISALLOW_COPY_AND_ASSIGN(TInfo);
 };
@@ -91,8 +162,13 @@ class TInfo {
 class DTNode {
  public:
   // ctor and dctor
-  DTNode() {}
-  ~DTNode() {}
+  DTNode() : info(new TInfo()) {
+    MemoryTracker::Alloc(kMemTreeNode, sizeof(DTNode));
+  }
+  ~DTNode() {
+    delete info;
+    MemoryTracker::Free(kMemTreeNode, sizeof(DTNode));
+  }
   // If current node is a leaf node?
   bool is_leaf = false;
   // leaf node value
@@ -110,10 +186,13 @@ class DTNode {
   // Clear TInfo
   inline void Clear() { 
     delete info;
+    info = nullptr;
   }
   // Clear parent info
   inline void ClearParent() {
-    delete info->parent->info;
+    if (info->parent != nullptr) {
+      info->parent->Clear();
+    }
   }
   // Is a leaf node?
   inline bool IsLeaf() const {
@@ -199,6 +278,20 @@ class DTNode {
   inline void SetBestGini(real_t gini) {
     info->best_gini = gini;
   }
+  // Number of samples
+  inline index_t NumSamples() const {
+    return info->num_samples;
+  }
+  inline void SetNumSamples(index_t num) {
+    info->num_samples = num;
+  }
+  // Number of samples of the best left child
+  inline index_t LeftSamples() const {
+    return info->left_samples;
+  }
+  inline void SetLeftSamples(index_t num) {
+    info->left_samples = num;
+  }
   // Parent node
   inline DTNode* Parent() const {
     return info->parent;
@@ -213,16 +306,23 @@ class DTNode {
   inline void SetBrother(DTNode* node) {
     info->brother = node;
   }
+  // Rank holding the split feature
+  inline int SplitRank() const {
+    return info->split_rank;
+  }
+  inline void SetSplitRank(int rank) {
+    info->split_rank = rank;
+  }
   // Histogram bin
-  inline void* Histo() const {
+  inline Histogram* Histo() const {
     return info->histo;
   }
-  inline void SetHisto(void* histo) {
+  inline void SetHisto(Histogram* histo) {
     info->histo = histo;
   }
   // Data size
   inline index_t DataSize() const {
-    return info->end_pos-info->start_pos+1;
+    return info->end_pos-info->start_pos;
   }
 };
 
@@ -235,7 +335,7 @@ class DTree {
  public:
   // ctor and dctor
   DTree() {}
-  ~DTree() { }
+  virtual ~DTree();
 
   // Initialize
   void Init(uint8* X, real_t* Y,
@@ -270,9 +370,9 @@ class DTree {
     min_impurity_ = hyper_param.min_impurity_split;
   }
 
-  // Sample for training data
+  // Sample for training data. It can be empty for a node
+  // of distributed training, see BuildTree().
   void SetRowIdx(const std::vector<index_t>& idx) {
-    CHECK_EQ(idx.empty(), false);
     rowIdx_.assign(idx.begin(), idx.end());
   }
 
@@ -282,12 +382,49 @@ class DTree {
     colIdx_.assign(idx.begin(), idx.end());
   }
 
+  // Weight of each row (e.g., the number of duplicates
+  // collapsed by DedupRows). Empty means all weights are 1.
+  void SetRowWeight(const std::vector<index_t>& weight) {
+    CHECK_EQ(weight.size(), data_size_);
+    weight_.assign(weight.begin(), weight.end());
+  }
+
+  // Train with the other nodes of the cluster. Each node holds
+  // a row shard (SetRowIdx) of the same features and bins, and
+  // the node histograms are summed over the cluster as the mode
+  // says, so every node grows the same tree. All nodes must 
+  // call BuildTree().
+  void SetCommunicator(Communicator* comm, 
+                       ParallelMode mode = kDataParallel) {
+    comm_ = comm;
+    mode_ = mode;
+  }
+
+  // Global feature id of each column of X. In kFeatureParallel
+  // mode, each node holds a column subset of the data, and the
+  // tree is trained and predicts with the global feature ids.
+  // Empty means the column ids are the feature ids.
+  void SetFeatureMap(const std::vector<index_t>& feat_ids) {
+    CHECK_EQ(feat_ids.size(), num_feat_);
+    feat_map_.assign(feat_ids.begin(), feat_ids.end());
+  }
+
+  // Number of features voted by each node in kVoting mode
+  void SetVotingTopK(index_t k) {
+    CHECK_GT(k, 0);
+    top_k_ = k;
+  }
+
   // Build decision tree
   void BuildTree();
 
   // Given data x, predict y 
   real_t Predict(const uint8* x);
 
+  // Get the ids of the features used by split nodes.
+  // Other features are not needed for prediction.
+  void GetSplitFeatures(std::vector<index_t>* feat_ids);
+
   // Serilize tree to string
   void Serilize(std::string* str);
 
@@ -306,8 +443,10 @@ class DTree {
   real_t min_impurity_dec_;     // Minimal impurity decrease to split a node
   real_t min_impurity_;         // Minimal impurity to split a node
 
-  std::vector<index_t> rowIdx_;   // data sample
-  std::vector<index_t> colIdx_;   // feature sample
+  TrackedVector<index_t, kMemRowIndex> rowIdx_;   // data sample
+  TrackedVector<index_t, kMemRowIndex> colIdx_;   // feature sample
+  TrackedVector<index_t, kMemRowIndex> weight_;   // row weight
+  std::vector<index_t> feat_map_; // global id of each column
 
   DTNode* root_ = nullptr;   // root node
   index_t leaf_size_ = 1;    // number of leaf nodes
@@ -320,21 +459,109 @@ class DTree {
   uint8* X_ = nullptr;    // Training data X
   real_t* Y_ = nullptr;   // Label y 
 
+  Communicator* comm_ = nullptr;       // Distributed training
+  ParallelMode mode_ = kDataParallel;  // How to aggregate histograms
+  index_t top_k_ = 20;                 // Votes of each node
+
+  std::deque<DTNode*> queue_;  // Nodes to grow in BFS order
+
+  // Thread syncing histograms while the next one is built,
+  // which lives during BuildTree()
+  scoped_ptr<ThreadPool> comm_thread_;
+
+  // Global feature id of a column of X
+  inline index_t FeatID(index_t col) const {
+    return feat_map_.empty() ? col : feat_map_[col];
+  }
+
+  // Column of X of a global feature id
+  index_t FeatColumn(index_t feat_id) const;
+
+  // Sum data over the row shards of the cluster
+  // (no-op for local and feature-parallel training)
+  void Allreduce(index_t* data, size_t len);
+
+  // Features [begin, end) of colIdx_, whose global histogram
+  // is held by local node after SyncHisto()
+  void HistoRange(index_t* begin, index_t* end);
+
+  // Sum the local histogram over the cluster. The histogram is
+  // feature-major, and each feature has feat_len counters.
+  void SyncHisto(index_t* count, index_t feat_len);
+
+  // Agree on the best split of node over the cluster
+  void SyncSplit(DTNode* node);
+
+  // Find the best split of node from the histogram of the
+  // features [feat_begin, feat_end) of colIdx_, and agree on
+  // it over the cluster. The histogram is feature-major, and
+  // each feature has feat_len counters.
+  void FindBestSplit(DTNode* node, const index_t* count, index_t feat_len,
+                     index_t feat_begin, index_t feat_end);
+
+  // Find the best split of node in kVoting mode. count is
+  // the local histogram of all features.
+  void VoteSplit(DTNode* node, const index_t* count, index_t feat_len);
+
+  // Find the best split of each feature in histogram count,
+  // which has num_hist_feat features. The split with
+  // left_samples = 0 is invalid. feat_id is not set.
+  virtual void FindSplit(const index_t* count, index_t num_hist_feat,
+                         SplitInfo* best) = 0;
+
+  // Weight of a row
+  inline index_t RowWeight(index_t row) const {
+    return weight_.empty() ? 1 : weight_[row];
+  }
+
   // Get leaf value
   virtual real_t LeafVal(const DTNode* node) = 0;
 
-  // Find best split position for current node
-  virtual void FindPosition(DTNode* node) = 0;
+  // Create an empty histogram of colIdx_
+  virtual Histogram* NewHisto() = 0;
+
+  // Add the local rows of node to histo
+  virtual void BuildHisto(const DTNode* node, Histogram* histo) = 0;
+
+  // Find best split position for current node.
+  // Set LeftSamples() to 0 if no valid split is found.
+  virtual void FindPosition(DTNode* node);
+
+  // Histogram of node is built from its rows, otherwise
+  // it is the histogram of parent minus brother
+  bool NeedBuild(const DTNode* node) const {
+    return node->LeftOrRight() == 'l' || node->Brother()->IsLeaf();
+  }
+
+  // Node reaches the depth or size limit, and will be a leaf
+  bool ReachLimit(const DTNode* node) const {
+    return node->Level() == max_depth_ ||
+           node->NumSamples() < min_samples_split_;
+  }
+
+  // Sum the histogram of node over the cluster. Meanwhile,
+  // the local histogram of the next node in queue_ is built.
+  void SyncAndPrefetch(DTNode* node);
 
   // If current node is a leaf node
   bool IsLeaf(DTNode* node);
 
+  // Make current node a leaf node
+  void SetLeafNode(DTNode* node);
+
+  // Delete a sub-tree
+  void DeleteNode(DTNode* node);
+
   // Get a leaf node by given the data x
   DTNode* GetLeaf(DTNode* node, const uint8* x);
 
   // Split current node
   void SplitData(DTNode* node);
 
+  // Split current node by the row bitmap from the
+  // node holding the split feature (kFeatureParallel)
+  void SplitByBitmap(DTNode* node);
+
  private:
   DISALLOW_COPY_AND_ASSIGN(DTree);
 };
@@ -345,21 +572,24 @@ struct Count {
   index_t count_1 = 0;
 };
 
-class BHistogram {
+class BHistogram : public Histogram {
  public:
   BHistogram(const index_t num_feat,
-             const uint8 num_bin) {
-    index_t len = num_feat * num_bin;
-    count.resize(len);
+             const index_t num_bin) 
+    : num_bin(num_bin) {
+    count.resize(num_feat * num_bin);
   }
-  ~BHistogram() {
-    for (index_t i = 0; i < count.size(); ++i) {
-      delete [] count[i];
-    }
+  ~BHistogram() {}
+  // Bins of the j-th feature
+  inline Count* Feat(index_t j) {
+    return count.data() + j * num_bin;
+  }
+  index_t* Data() {
+    return reinterpret_cast<index_t*>(count.data());
   }
-  index_t total_0 = 0;
-  index_t total_1 = 0;
-  std::vector<Count*> count;
+  index_t FeatLen() const { return 2 * num_bin; }
+  index_t num_bin = 0;
+  TrackedVector<Count, kMemHistogram> count;
 
  private:
   DISALLOW_COPY_AND_ASSIGN(BHistogram);
@@ -378,31 +608,49 @@ class BTree : public DTree {
   // Get leaf value
   real_t LeafVal(const DTNode* node);
 
-  // Calculate gini value
+  // Calculate gini value of a split
   real_t Gini(const real_t left_0, const real_t left_1,
               const real_t right_0, const real_t right_1);
 
-  // Find best split position for current node
-  void FindPosition(DTNode* node);  
+  // Calculate gini value of a node
+  real_t Gini(const real_t count_0, const real_t count_1);
+
+  // Create an empty histogram of colIdx_
+  Histogram* NewHisto();
+
+  // Add the local rows of node to histo
+  void BuildHisto(const DTNode* node, Histogram* histo);
+
+  // Find the best split of each feature in histogram
+  void FindSplit(const index_t* count, index_t num_hist_feat,
+                 SplitInfo* best);
 
   DISALLOW_COPY_AND_ASSIGN(BTree);
 };
 
-// Histogram for multi-classification
-class MCHistogram {
+// Histogram for multi-classification.
+// The count of (feature j, bin b, class c) is
+// count[(j * num_bin + b) * num_class + c].
+class MCHistogram : public Histogram {
  public:
   MCHistogram(const index_t num_feat,
               const index_t num_bin,
               const uint8 num_class) {
-    count_len = num_feat * num_bin * num_class;
+    feat_len = num_bin * num_class;
+    count_len = num_feat * feat_len;
     count = new index_t[count_len];
     for (index_t i = 0; i < count_len; ++i) {
       count[i] = 0;
     }
+    MemoryTracker::Alloc(kMemHistogram, count_len * sizeof(index_t));
   }
   ~MCHistogram() {
     delete [] count;
+    MemoryTracker::Free(kMemHistogram, count_len * sizeof(index_t));
   }
+  index_t* Data() { return count; }
+  index_t FeatLen() const { return feat_len; }
+  index_t feat_len = 0;
   index_t count_len = 0;
   index_t* count = nullptr;
 
@@ -421,14 +669,21 @@ class MCTree : public DTree {
   // Get leaf value
   real_t LeafVal(const DTNode* node);
 
-  // Find best split position for current node
-  void FindPosition(DTNode* node);  
+  // Create an empty histogram of colIdx_
+  Histogram* NewHisto();
+
+  // Add the local rows of node to histo
+  void BuildHisto(const DTNode* node, Histogram* histo);
+
+  // Find the best split of each feature in histogram
+  void FindSplit(const index_t* count, index_t num_hist_feat,
+                 SplitInfo* best);
 
   DISALLOW_COPY_AND_ASSIGN(MCTree);
 };
 
 // Histogram for regression
-class RHistogram {
+class RHistogram : public Histogram {
  public:
   RHistogram(const index_t num_feat,
              const index_t num_bin) {
@@ -450,9 +705,19 @@ class RTree : public DTree {
   // Get leaf value
   real_t LeafVal(const DTNode* node);
 
+  // Create an empty histogram of colIdx_
+  Histogram* NewHisto();
+
+  // Add the local rows of node to histo
+  void BuildHisto(const DTNode* node, Histogram* histo);
+
   // Find best split position for current node
   void FindPosition(DTNode* node);  
 
+  // Find the best split of each feature in histogram
+  void FindSplit(const index_t* count, index_t num_hist_feat,
+                 SplitInfo* best);
+
   DISALLOW_COPY_AND_ASSIGN(RTree);
 };
 
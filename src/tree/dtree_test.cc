@@ -0,0 +1,359 @@
+//------------------------------------------------------------------------------
+// Copyright (c) 2018 by contributors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//------------------------------------------------------------------------------
+
+/*
+This file tests the DTree class.
+*/
+
+#include "src/tree/dtree.h"
+
+#include <unistd.h>
+#include <thread>
+#include <vector>
+
+#include "src/base/common.h"
+#include "src/base/scoped_ptr.h"
+#include "src/network/communicator.h"
+#include "src/network/socket_communicator.h"
+#include "src/tree/dedup.h"
+#include "gtest/gtest.h"
+
+namespace xforest {
+
+const index_t kNumFeat = 4;
+const index_t kDataSize = 3000;
+
+// Label is decided by the bins of feature 1 and feature 3
+static void GenData(uint8 num_class,
+                    std::vector<uint8>* X,
+                    std::vector<real_t>* Y) {
+  X->resize(kDataSize * kNumFeat);
+  Y->resize(kDataSize);
+  for (index_t i = 0; i < kDataSize; ++i) {
+    uint8* row = X->data() + i * kNumFeat;
+    row[0] = (i * 7) % 50;
+    row[1] = i % 100;
+    row[2] = (i / 3) % 20;
+    row[3] = (i / 100) % 30;
+    (*Y)[i] = (row[1] / 50 + row[3] / 15 * 2) % num_class;
+  }
+}
+
+static HyperParam TestParam() {
+  HyperParam param;
+  param.max_bin = 100;
+  param.max_depth = 10;
+  param.max_leaf_nodes = 100;
+  return param;
+}
+
+static void CheckTree(const char* name, uint8 num_class,
+                      const std::vector<index_t>& expect) {
+  std::vector<uint8> X;
+  std::vector<real_t> Y;
+  GenData(num_class, &X, &Y);
+  HyperParam param = TestParam();
+  DTree* tree = CREATE_DTREE(name);
+  tree->Init(X.data(), Y.data(), num_class, kNumFeat, kDataSize, param);
+  std::vector<index_t> rows(kDataSize);
+  for (index_t i = 0; i < kDataSize; ++i) {
+    rows[i] = i;
+  }
+  std::vector<index_t> cols = {0, 1, 2, 3};
+  tree->SetRowIdx(rows);
+  tree->SetColIdx(cols);
+  tree->BuildTree();
+  for (index_t i = 0; i < kDataSize; ++i) {
+    EXPECT_EQ(tree->Predict(X.data() + i * kNumFeat), Y[i]);
+  }
+  std::vector<index_t> feats;
+  tree->GetSplitFeatures(&feats);
+  EXPECT_EQ(feats, expect);
+  // Serilize and deserilize
+  std::string str;
+  tree->Serilize(&str);
+  DTree* copy = CREATE_DTREE(name);
+  copy->Deserilize(str);
+  for (index_t i = 0; i < kDataSize; ++i) {
+    EXPECT_EQ(copy->Predict(X.data() + i * kNumFeat), Y[i]);
+  }
+  delete copy;
+  delete tree;
+}
+
+TEST(DTree, BTree) {
+  CheckTree("btree", 2, {1});
+}
+
+TEST(DTree, MCTree) {
+  CheckTree("mctree", 4, {1, 3});
+}
+
+// Training on deduped rows with weights gives the same tree
+TEST(DTree, RowWeight) {
+  std::vector<uint8> X;
+  std::vector<real_t> Y;
+  GenData(3, &X, &Y);
+  // Drop feature 0 and 2 and merge the bins of feature 1
+  // (keeping the labels), so that there are many duplicates
+  for (index_t i = 0; i < kDataSize; ++i) {
+    X[i * kNumFeat] = 0;
+    X[i * kNumFeat + 1] = X[i * kNumFeat + 1] / 10 * 10;
+    X[i * kNumFeat + 2] = 0;
+  }
+  // Flip some labels to make the leaves impure
+  for (index_t i = 0; i < kDataSize; i += 17) {
+    Y[i] = ((int)Y[i] + 1) % 3;
+  }
+  std::vector<uint8> X_dedup;
+  std::vector<real_t> Y_dedup;
+  std::vector<index_t> weight;
+  DedupRows(X.data(), Y.data(), kNumFeat, kDataSize, 3,
+            &X_dedup, &Y_dedup, &weight);
+  EXPECT_LT(Y_dedup.size(), kDataSize);
+  HyperParam param = TestParam();
+  param.max_depth = 4;
+  param.min_samples_leaf = 20;
+  std::vector<index_t> cols = {0, 1, 2, 3};
+  // Full data
+  DTree* full = CREATE_DTREE("mctree");
+  full->Init(X.data(), Y.data(), 3, kNumFeat, kDataSize, param);
+  std::vector<index_t> rows(kDataSize);
+  for (index_t i = 0; i < kDataSize; ++i) {
+    rows[i] = i;
+  }
+  full->SetRowIdx(rows);
+  full->SetColIdx(cols);
+  full->BuildTree();
+  // Deduped data
+  index_t dedup_size = Y_dedup.size();
+  DTree* dedup = CREATE_DTREE("mctree");
+  dedup->Init(X_dedup.data(), Y_dedup.data(), 3,
+              kNumFeat, dedup_size, param);
+  rows.resize(dedup_size);
+  dedup->SetRowIdx(rows);
+  dedup->SetColIdx(cols);
+  dedup->SetRowWeight(weight);
+  dedup->BuildTree();
+  for (index_t i = 0; i < kDataSize; ++i) {
+    EXPECT_EQ(full->Predict(X.data() + i * kNumFeat),
+              dedup->Predict(X.data() + i * kNumFeat));
+  }
+  delete full;
+  delete dedup;
+}
+
+// Train on the row shards of 3 nodes, which must grow
+// the same tree as training on the full data. With empty_shard,
+// rank 0 holds no rows.
+static void CheckDistributed(const char* name, uint8 num_class,
+                             ParallelMode mode, const std::string& addr,
+                             index_t top_k = 20, 
+                             const char* comm_name = "socket",
+                             bool empty_shard = false) {
+  const int kNumWorker = 2;
+  std::vector<uint8> X;
+  std::vector<real_t> Y;
+  GenData(num_class, &X, &Y);
+  HyperParam param = TestParam();
+  param.max_depth = 5;
+  param.min_samples_leaf = 10;
+  std::vector<index_t> cols = {0, 1, 2, 3};
+  DTree* full = CREATE_DTREE(name);
+  full->Init(X.data(), Y.data(), num_class, kNumFeat, kDataSize, param);
+  std::vector<index_t> rows(kDataSize);
+  for (index_t i = 0; i < kDataSize; ++i) {
+    rows[i] = i;
+  }
+  full->SetRowIdx(rows);
+  full->SetColIdx(cols);
+  full->BuildTree();
+  std::vector<DTree*> trees(kNumWorker + 1);
+  std::vector<std::thread> threads;
+  for (int rank = 0; rank <= kNumWorker; ++rank) {
+    trees[rank] = CREATE_DTREE(name);
+    threads.push_back(std::thread([&, rank]() {
+      if (rank > 0) {
+        sleep(1);  // wait master node
+      }
+      scoped_ptr<Communicator> comm(CREATE_COMMUNICATOR(comm_name));
+      comm->Initialize(rank, kNumWorker, addr);
+      // Row shard of current node
+      std::vector<index_t> shard;
+      for (index_t i = rank; i < kDataSize; i += kNumWorker + 1) {
+        shard.push_back(i);
+      }
+      if (empty_shard && rank == 0) {
+        shard.clear();
+      } else if (empty_shard) {
+        for (index_t i = rank - 1; i < kDataSize; i += kNumWorker + 1) {
+          shard.push_back(i);
+        }
+      }
+      DTree* tree = trees[rank];
+      tree->Init(X.data(), Y.data(), num_class, kNumFeat, kDataSize, param);
+      tree->SetRowIdx(shard);
+      tree->SetColIdx(cols);
+      tree->SetCommunicator(comm.get(), mode);
+      tree->SetVotingTopK(top_k);
+      tree->BuildTree();
+      tree->SetCommunicator(nullptr);
+    }));
+  }
+  for (size_t i = 0; i < threads.size(); ++i) {
+    threads[i].join();
+  }
+  for (int rank = 0; rank <= kNumWorker; ++rank) {
+    for (index_t i = 0; i < kDataSize; ++i) {
+      EXPECT_EQ(trees[rank]->Predict(X.data() + i * kNumFeat),
+                full->Predict(X.data() + i * kNumFeat));
+    }
+    delete trees[rank];
+  }
+  delete full;
+}
+
+TEST(DTree, DistributedBTree) {
+  CheckDistributed("btree", 2, kDataParallel, "127.0.0.1:12350");
+}
+
+TEST(DTree, DistributedMCTree) {
+  CheckDistributed("mctree", 4, kDataParallel, "127.0.0.1:12351");
+}
+
+// Histogram sync overlaps with building the next histogram
+TEST(DTree, EpollMCTree) {
+  CheckDistributed("mctree", 4, kDataParallel, "127.0.0.1:12358", 20, 
+                   "epoll");
+}
+
+TEST(DTree, EpollReduceScatterBTree) {
+  CheckDistributed("btree", 2, kReduceScatter, "127.0.0.1:12359", 20, 
+                   "epoll");
+}
+
+TEST(DTree, ShmMCTree) {
+  CheckDistributed("mctree", 4, kDataParallel, "dtree_test", 20, "shm");
+}
+
+// A node without rows still joins the histogram sync
+TEST(DTree, EmptyShardMCTree) {
+  CheckDistributed("mctree", 4, kDataParallel, "127.0.0.1:12364", 20,
+                   "socket", true);
+}
+
+TEST(DTree, EmptyShardReduceScatterBTree) {
+  CheckDistributed("btree", 2, kReduceScatter, "127.0.0.1:12365", 20,
+                   "socket", true);
+}
+
+TEST(DTree, ReduceScatterBTree) {
+  CheckDistributed("btree", 2, kReduceScatter, "127.0.0.1:12352");
+}
+
+TEST(DTree, ReduceScatterMCTree) {
+  CheckDistributed("mctree", 4, kReduceScatter, "127.0.0.1:12353");
+}
+
+// The informative features always win the votes
+TEST(DTree, VotingBTree) {
+  CheckDistributed("btree", 2, kVoting, "127.0.0.1:12354", 1);
+}
+
+TEST(DTree, VotingMCTree) {
+  CheckDistributed("mctree", 4, kVoting, "127.0.0.1:12355", 1);
+}
+
+// Each of 3 nodes holds a column subset of all rows
+static void CheckFeatureParallel(const char* name, uint8 num_class,
+                                 const std::string& addr) {
+  const int kNumWorker = 2;
+  std::vector<uint8> X;
+  std::vector<real_t> Y;
+  GenData(num_class, &X, &Y);
+  HyperParam param = TestParam();
+  param.max_depth = 5;
+  param.min_samples_leaf = 10;
+  std::vector<index_t> rows(kDataSize);
+  for (index_t i = 0; i < kDataSize; ++i) {
+    rows[i] = i;
+  }
+  std::vector<index_t> cols = {0, 1, 2, 3};
+  DTree* full = CREATE_DTREE(name);
+  full->Init(X.data(), Y.data(), num_class, kNumFeat, kDataSize, param);
+  full->SetRowIdx(rows);
+  full->SetColIdx(cols);
+  full->BuildTree();
+  // Features of each node
+  std::vector<std::vector<index_t>> feats = {{0, 1}, {2}, {3}};
+  std::vector<DTree*> trees(kNumWorker + 1);
+  std::vector<std::vector<uint8>> local_X(kNumWorker + 1);
+  std::vector<std::thread> threads;
+  for (int rank = 0; rank <= kNumWorker; ++rank) {
+    trees[rank] = CREATE_DTREE(name);
+    threads.push_back(std::thread([&, rank]() {
+      if (rank > 0) {
+        sleep(1);  // wait master node
+      }
+      SocketCommunicator comm;
+      comm.Initialize(rank, kNumWorker, addr);
+      // Column subset of current node
+      const std::vector<index_t>& feat = feats[rank];
+      index_t num_col = feat.size();
+      std::vector<uint8>& data = local_X[rank];
+      data.resize(kDataSize * num_col);
+      for (index_t i = 0; i < kDataSize; ++i) {
+        for (index_t j = 0; j < num_col; ++j) {
+          data[i * num_col + j] = X[i * kNumFeat + feat[j]];
+        }
+      }
+      std::vector<index_t> local_cols;
+      for (index_t j = 0; j < num_col; ++j) {
+        local_cols.push_back(j);
+      }
+      DTree* tree = trees[rank];
+      tree->Init(data.data(), Y.data(), num_class, num_col, kDataSize, param);
+      tree->SetFeatureMap(feat);
+      tree->SetRowIdx(rows);
+      tree->SetColIdx(local_cols);
+      tree->SetCommunicator(&comm, kFeatureParallel);
+      tree->BuildTree();
+      tree->SetCommunicator(nullptr);
+    }));
+  }
+  for (size_t i = 0; i < threads.size(); ++i) {
+    threads[i].join();
+  }
+  // Predict with the full rows
+  for (int rank = 0; rank <= kNumWorker; ++rank) {
+    for (index_t i = 0; i < kDataSize; ++i) {
+      EXPECT_EQ(trees[rank]->Predict(X.data() + i * kNumFeat),
+                full->Predict(X.data() + i * kNumFeat));
+    }
+    delete trees[rank];
+  }
+  delete full;
+}
+
+TEST(DTree, FeatureParallelBTree) {
+  CheckFeatureParallel("btree", 2, "127.0.0.1:12356");
+}
+
+TEST(DTree, FeatureParallelMCTree) {
+  CheckFeatureParallel("mctree", 4, "127.0.0.1:12357");
+}
+
+}  // namespace xforest
@@ -0,0 +1,662 @@
+//------------------------------------------------------------------------------
+// Copyright (c) 2018 by contributors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//------------------------------------------------------------------------------
+
+/*
+This file is the implementation of Forest class.
+*/
+
+#include "src/tree/forest.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <algorithm>
+#include <random>
+#include <thread>
+
+#include "src/base/file_util.h"
+#include "src/base/memory_tracker.h"
+#include "src/base/profiler.h"
+#include "src/base/serialize_util.h"
+#include "src/network/communicator.h"
+#include "src/tree/dedup.h"
+#include "src/tree/quantile_sketch.h"
+
+namespace xforest {
+
+// Tree id sent to worker when all trees are assigned
+static const int32 kNoTree = -1;
+
+// First bytes of checkpoint file
+static const uint32 kCheckpointMagic = 0x50434658;  // "XFCP"
+
+// Types of the records which follow the checkpoint header
+static const uint8 kRecordTree = 1;      // id, size and a tree
+static const uint8 kRecordInFlight = 2;  // ids of trees in flight
+
+// Messages buffered by each thread with async_log
+static const size_t kLogQueueSize = 4096;
+
+// dctor
+Forest::~Forest() {
+  Clear();
+  MemoryTracker::Free(kMemDataset, dataset_bytes_);
+}
+
+// Delete all trees
+void Forest::Clear() {
+  for (size_t i = 0; i < trees_.size(); ++i) {
+    delete trees_[i];
+  }
+  trees_.clear();
+}
+
+// Initialize
+void Forest::Init(uint8* X, real_t* Y,
+                  const uint8 num_class,
+                  const index_t num_feat,
+                  const index_t data_size,
+                  const HyperParam& hyper_param,
+                  const std::string& tree_type) {
+  CHECK_GT(hyper_param.n_estimators, 0);
+  // The data is owned by the caller, and accounted while
+  // it is used by the forest
+  MemoryTracker::Free(kMemDataset, dataset_bytes_);
+  dataset_bytes_ = X == nullptr ? 0 :
+    (uint64)data_size * num_feat + (uint64)data_size * sizeof(real_t);
+  MemoryTracker::Alloc(kMemDataset, dataset_bytes_);
+  X_ = X;
+  Y_ = Y;
+  num_class_ = num_class;
+  num_feat_ = num_feat;
+  data_size_ = data_size;
+  param_ = hyper_param;
+  tree_type_ = tree_type;
+  // -1 means no limit
+  if (param_.max_depth <= 0) {
+    param_.max_depth = 255;
+  }
+  if (param_.max_leaf_nodes <= 0) {
+    param_.max_leaf_nodes = kInt32Max;
+  }
+  dedup_X_.clear();
+  dedup_Y_.clear();
+  row_end_.clear();
+  if (param_.dedup_rows && X_ != nullptr) {
+    DedupData();
+  }
+}
+
+// Bin the raw values of X, and then Init() with the bins
+void Forest::InitRaw(const real_t* X, real_t* Y,
+                     const uint8 num_class,
+                     const index_t num_feat,
+                     const index_t data_size,
+                     const HyperParam& hyper_param,
+                     const std::string& tree_type,
+                     Communicator* comm) {
+  index_t row_len = X == nullptr ? 0 : data_size;
+  {
+    PROFILE_ZONE("binning");
+    ComputeCuts(X, row_len, num_feat, hyper_param.max_bin, comm, &cuts_);
+    raw_bins_.resize((uint64)row_len * num_feat);
+    if (row_len > 0) {
+      ApplyCuts(X, row_len, num_feat, cuts_, raw_bins_.data());
+    }
+  }
+  Init(X == nullptr ? nullptr : raw_bins_.data(), Y, num_class,
+       num_feat, data_size, hyper_param, tree_type);
+}
+
+// Collapse the identical rows of X_ and Y_
+void Forest::DedupData() {
+  PROFILE_ZONE("dedup");
+  int num_threads = param_.n_jobs > 0 ? param_.n_jobs :
+    std::max(1u, std::thread::hardware_concurrency());
+  std::vector<index_t> weight;
+  DedupRows(X_, Y_, num_feat_, data_size_, num_threads,
+            &dedup_X_, &dedup_Y_, &weight);
+  row_end_.resize(weight.size());
+  index_t total = 0;
+  for (size_t i = 0; i < weight.size(); ++i) {
+    total += weight[i];
+    row_end_[i] = total;
+  }
+  CHECK_EQ(total, data_size_);
+  X_ = dedup_X_.data();
+  Y_ = dedup_Y_.data();
+  uint64 bytes = dedup_X_.size() + dedup_Y_.size() * sizeof(real_t) +
+                 row_end_.size() * sizeof(index_t);
+  dataset_bytes_ += bytes;
+  MemoryTracker::Alloc(kMemDataset, bytes);
+  LOG(INFO) << "Collapse " << data_size_ << " rows to "
+            << row_end_.size() << " distinct rows";
+}
+
+// Train the tree of tree_id, and print the memory usage
+// and its profile if the profiler is enabled
+DTree* Forest::TrainTree(int tree_id) {
+  if (!Profiler::Enabled()) {
+    DTree* tree = BuildTree(tree_id);
+    LOG(INFO) << "Memory after tree " << tree_id << ": "
+              << MemoryTracker::Report();
+    return tree;
+  }
+  Profiler::FlushThread();
+  DTree* tree = nullptr;
+  {
+    PROFILE_ZONE("tree");
+    tree = BuildTree(tree_id);
+  }
+  LOG(INFO) << "Memory after tree " << tree_id << ": "
+            << MemoryTracker::Report();
+  std::vector<ProfileStat> stats;
+  Profiler::ThreadStats(&stats);
+  LOG(INFO) << "Profile of tree " << tree_id << ":\n"
+            << Profiler::Report(stats);
+  return tree;
+}
+
+// Print the memory usage, and the profile of all trees
+// trained by this node if the profiler is enabled
+void Forest::ReportProfile() {
+  LOG(INFO) << "Memory of forest: " << MemoryTracker::Report();
+  if (!Profiler::Enabled()) {
+    return;
+  }
+  Profiler::FlushThread();
+  std::vector<ProfileStat> stats;
+  Profiler::Stats(&stats);
+  LOG(INFO) << "Profile of forest:\n" << Profiler::Report(stats);
+}
+
+// Sample the rows and features of tree_id
+void Forest::Sample(int tree_id, std::vector<index_t>* rows,
+                    std::vector<index_t>* cols,
+                    std::vector<index_t>* weight) {
+  PROFILE_ZONE("sample");
+  std::mt19937 rng(param_.random_state + tree_id);
+  // Sample rows
+  weight->clear();
+  if (!row_end_.empty()) {
+    // Draw the original rows, and count the draws of the
+    // collapsed row which each of them belongs to
+    index_t num_rows = row_end_.size();
+    if (param_.bootstrap) {
+      weight->assign(num_rows, 0);
+      std::uniform_int_distribution<index_t> dist(0, data_size_ - 1);
+      for (index_t i = 0; i < data_size_; ++i) {
+        index_t r = std::upper_bound(row_end_.begin(), row_end_.end(),
+                                     dist(rng)) - row_end_.begin();
+        (*weight)[r]++;
+      }
+    } else {
+      weight->resize(num_rows);
+      index_t start = 0;
+      for (index_t i = 0; i < num_rows; ++i) {
+        (*weight)[i] = row_end_[i] - start;
+        start = row_end_[i];
+      }
+    }
+    rows->clear();
+    for (index_t i = 0; i < num_rows; ++i) {
+      if ((*weight)[i] > 0) {
+        rows->push_back(i);
+      }
+    }
+  } else if (param_.bootstrap) {
+    rows->resize(data_size_);
+    std::uniform_int_distribution<index_t> dist(0, data_size_ - 1);
+    for (index_t i = 0; i < data_size_; ++i) {
+      (*rows)[i] = dist(rng);
+    }
+  } else {
+    rows->resize(data_size_);
+    for (index_t i = 0; i < data_size_; ++i) {
+      (*rows)[i] = i;
+    }
+  }
+  // Sample features
+  index_t num_cols = num_feat_;
+  if (param_.max_features > 0) {
+    num_cols = std::min((index_t)param_.max_features, num_feat_);
+  } else if (param_.max_string_features == "sqrt") {
+    num_cols = sqrt(num_feat_);
+  } else if (param_.max_string_features == "log2") {
+    num_cols = log2(num_feat_);
+  } else {
+    num_cols = param_.max_fraction_features * num_feat_;
+  }
+  num_cols = std::max(num_cols, (index_t)1);
+  cols->resize(num_feat_);
+  for (index_t j = 0; j < num_feat_; ++j) {
+    (*cols)[j] = j;
+  }
+  std::shuffle(cols->begin(), cols->end(), rng);
+  cols->resize(num_cols);
+  std::sort(cols->begin(), cols->end());
+}
+
+// Sample rows and features, and build the tree of tree_id
+DTree* Forest::BuildTree(int tree_id) {
+  std::vector<index_t> rows;
+  std::vector<index_t> cols;
+  std::vector<index_t> weight;
+  Sample(tree_id, &rows, &cols, &weight);
+  DTree* tree = CREATE_DTREE(tree_type_);
+  CHECK_NOTNULL(tree);
+  if (weight.empty()) {
+    tree->Init(X_, Y_, num_class_, num_feat_, data_size_, param_);
+  } else {
+    tree->Init(X_, Y_, num_class_, num_feat_, weight.size(), param_);
+    tree->SetRowWeight(weight);
+  }
+  tree->SetRowIdx(rows);
+  tree->SetColIdx(cols);
+  tree->BuildTree();
+  return tree;
+}
+
+// Save checkpoint every interval trees
+void Forest::SetCheckpoint(const std::string& filename, int interval) {
+  CHECK(!filename.empty());
+  CHECK_GT(interval, 0);
+  checkpoint_file_ = filename;
+  checkpoint_interval_ = interval;
+}
+
+// Load the finished trees from checkpoint, and set pending_
+// to the ids of the other trees
+void Forest::StartTraining() {
+  Clear();
+  trees_.assign(param_.n_estimators, nullptr);
+  checkpoint_log_.clear();
+  if (!checkpoint_file_.empty()) {
+    if (LoadCheckpoint()) {
+      LOG(INFO) << "Resume from checkpoint " << checkpoint_file_;
+    } else {
+      CreateCheckpoint();
+    }
+  }
+  pending_.clear();
+  for (int i = 0; i < param_.n_estimators; ++i) {
+    if (trees_[i] == nullptr) {
+      pending_.push_back(i);
+    }
+  }
+  next_id_ = 0;
+  in_flight_.clear();
+  num_finished_ = 0;
+}
+
+// Store the finished tree, and save checkpoint if needed
+void Forest::FinishTree(int tree_id, DTree* tree,
+                        const std::string* str) {
+  // Serialize the tree once, and out of the lock
+  std::string record;
+  if (!checkpoint_file_.empty()) {
+    std::string tree_str;
+    if (str == nullptr) {
+      tree->Serilize(&tree_str);
+      str = &tree_str;
+    }
+    WriteValue<uint8>(kRecordTree, &record);
+    WriteValue<int32>(tree_id, &record);
+    WriteValue<uint64>(str->size(), &record);
+    record.append(*str);
+  }
+  std::string records;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    CHECK(trees_[tree_id] == nullptr);
+    trees_[tree_id] = tree;
+    in_flight_.erase(tree_id);
+    num_finished_++;
+    if (checkpoint_file_.empty()) {
+      return;
+    }
+    checkpoint_log_.append(record);
+    if (num_finished_ % checkpoint_interval_ != 0 &&
+        num_finished_ != pending_.size()) {
+      return;
+    }
+    // The trees in flight when the checkpoint is taken
+    WriteValue<uint8>(kRecordInFlight, &records);
+    WriteValue<uint32>(in_flight_.size(), &records);
+    for (int32 id : in_flight_) {
+      WriteValue<int32>(id, &records);
+    }
+    records.append(checkpoint_log_);
+    checkpoint_log_.clear();
+  }
+  AppendCheckpoint(records);
+}
+
+// Create the checkpoint file. The file is written to a temporary
+// file and then renamed, so a crash never leaves a broken header.
+void Forest::CreateCheckpoint() {
+  std::string str;
+  WriteValue<uint32>(kCheckpointMagic, &str);
+  // Parameters which decide the trees
+  WriteValue<uint8>(num_class_, &str);
+  WriteValue<index_t>(num_feat_, &str);
+  WriteValue<index_t>(data_size_, &str);
+  WriteValue<int32>(param_.n_estimators, &str);
+  WriteValue<int32>(param_.random_state, &str);
+  WriteValue<uint32>(tree_type_.size(), &str);
+  str.append(tree_type_);
+  std::string tmp_file = checkpoint_file_ + ".tmp";
+  FILE* file = OpenFileOrDie(tmp_file.c_str(), "w");
+  WriteDataToDisk(file, str.data(), str.size());
+  CHECK_EQ(0, fflush(file));
+  CHECK_EQ(0, fsync(fileno(file)));
+  Close(file);
+  if (rename(tmp_file.c_str(), checkpoint_file_.c_str()) != 0) {
+    LOG(FATAL) << "Cannot rename " << tmp_file << " to "
+               << checkpoint_file_;
+  }
+}
+
+// Append records to the checkpoint file and sync it. A crash
+// may leave a partial record at the end, which is dropped by
+// LoadCheckpoint().
+void Forest::AppendCheckpoint(const std::string& records) {
+  PROFILE_ZONE("checkpoint");
+  std::lock_guard<std::mutex> lock(checkpoint_mutex_);
+  FILE* file = OpenFileOrDie(checkpoint_file_.c_str(), "a");
+  WriteDataToDisk(file, records.data(), records.size());
+  CHECK_EQ(0, fflush(file));
+  CHECK_EQ(0, fsync(fileno(file)));
+  Close(file);
+  LOG(INFO) << "Append " << records.size() << " bytes to checkpoint "
+            << checkpoint_file_;
+}
+
+// Load the trees of checkpoint to trees_
+bool Forest::LoadCheckpoint() {
+  if (access(checkpoint_file_.c_str(), F_OK) != 0) {
+    return false;
+  }
+  char* buf = nullptr;
+  uint64 size = ReadFileToMemory(checkpoint_file_, &buf);
+  std::string str(buf, size);
+  delete [] buf;
+  size_t pos = 0;
+  if (ReadValue<uint32>(str, &pos) != kCheckpointMagic) {
+    LOG(FATAL) << "Broken checkpoint file: " << checkpoint_file_;
+  }
+  bool match = ReadValue<uint8>(str, &pos) == num_class_;
+  match &= ReadValue<index_t>(str, &pos) == num_feat_;
+  match &= ReadValue<index_t>(str, &pos) == data_size_;
+  match &= ReadValue<int32>(str, &pos) == param_.n_estimators;
+  match &= ReadValue<int32>(str, &pos) == param_.random_state;
+  uint32 type_len = ReadValue<uint32>(str, &pos);
+  CHECK_LE(pos + type_len, str.size());
+  match &= str.compare(pos, type_len, tree_type_) == 0;
+  pos += type_len;
+  if (!match) {
+    LOG(FATAL) << "Checkpoint " << checkpoint_file_
+               << " is written by a job of other parameters.";
+  }
+  // Records until the end, or a partial record of a crash
+  std::vector<int32> in_flight;
+  uint32 num_trees = 0;
+  for (;;) {
+    size_t start = pos;
+    if (pos + sizeof(uint8) > str.size()) {
+      break;
+    }
+    uint8 type = ReadValue<uint8>(str, &pos);
+    if (type == kRecordInFlight) {
+      if (pos + sizeof(uint32) > str.size()) {
+        pos = start;
+        break;
+      }
+      uint32 num = ReadValue<uint32>(str, &pos);
+      if (pos + num * sizeof(int32) > str.size()) {
+        pos = start;
+        break;
+      }
+      in_flight.resize(num);
+      for (uint32 i = 0; i < num; ++i) {
+        in_flight[i] = ReadValue<int32>(str, &pos);
+      }
+    } else if (type == kRecordTree) {
+      if (pos + sizeof(int32) + sizeof(uint64) > str.size()) {
+        pos = start;
+        break;
+      }
+      int32 tree_id = ReadValue<int32>(str, &pos);
+      uint64 len = ReadValue<uint64>(str, &pos);
+      if (pos + len > str.size()) {
+        pos = start;
+        break;
+      }
+      CHECK_GE(tree_id, 0);
+      CHECK_LT(tree_id, param_.n_estimators);
+      DTree* tree = CREATE_DTREE(tree_type_);
+      CHECK_NOTNULL(tree);
+      tree->Deserilize(str.substr(pos, len));
+      pos += len;
+      delete trees_[tree_id];
+      trees_[tree_id] = tree;
+      num_trees++;
+    } else {
+      LOG(FATAL) << "Broken checkpoint file: " << checkpoint_file_;
+    }
+  }
+  if (pos < str.size()) {
+    LOG(WARNING) << "Drop " << str.size() - pos << " bytes of a partial "
+                 << "record at the end of checkpoint " << checkpoint_file_;
+    CHECK_EQ(0, truncate(checkpoint_file_.c_str(), pos));
+  }
+  for (size_t i = 0; i < in_flight.size(); ++i) {
+    if (trees_[in_flight[i]] == nullptr) {
+      LOG(INFO) << "Retrain tree " << in_flight[i]
+                << " which was in flight";
+    }
+  }
+  LOG(INFO) << "Load " << num_trees << " trees from checkpoint "
+            << checkpoint_file_;
+  return true;
+}
+
+// Train n_estimators trees locally
+void Forest::Train() {
+  if (param_.async_log) {
+    StartAsyncLogger(kLogQueueSize, kLogBlock);
+  }
+  StartTraining();
+  for (size_t i = 0; i < pending_.size(); ++i) {
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      in_flight_.insert(pending_[i]);
+    }
+    FinishTree(pending_[i], TrainTree(pending_[i]));
+  }
+  ReportProfile();
+  if (param_.async_log) {
+    StopAsyncLogger();
+  }
+}
+
+// Master: hand out tree ids to a worker
+void Forest::ServeWorker(Communicator* comm, int rank) {
+  Profiler::SetThreadName("serve worker " + std::to_string(rank));
+  for (;;) {
+    int32 tree_id = kNoTree;
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      if (next_id_ < pending_.size()) {
+        tree_id = pending_[next_id_++];
+        in_flight_.insert(tree_id);
+      }
+    }
+    comm->Send(rank, reinterpret_cast<const char*>(&tree_id), 
+               sizeof(tree_id));
+    if (tree_id == kNoTree) {
+      break;
+    }
+    uint64 len = 0;
+    comm->Recv(rank, reinterpret_cast<char*>(&len), sizeof(len));
+    std::string str(len, 0);
+    comm->Recv(rank, &str[0], len);
+    DTree* tree = CREATE_DTREE(tree_type_);
+    CHECK_NOTNULL(tree);
+    tree->Deserilize(str);
+    FinishTree(tree_id, tree, &str);
+  }
+}
+
+// Worker: train the assigned trees
+void Forest::RunWorker(Communicator* comm) {
+  Profiler::SetThreadName("worker " + std::to_string(comm->Rank()));
+  for (;;) {
+    int32 tree_id = kNoTree;
+    comm->Recv(0, reinterpret_cast<char*>(&tree_id), sizeof(tree_id));
+    if (tree_id == kNoTree) {
+      break;
+    }
+    DTree* tree = TrainTree(tree_id);
+    std::string str;
+    tree->Serilize(&str);
+    delete tree;
+    uint64 len = str.size();
+    comm->Send(0, reinterpret_cast<const char*>(&len), sizeof(len));
+    comm->Send(0, str.data(), len);
+    comm->WaitSends();
+  }
+}
+
+// Train trees on the workers of comm
+void Forest::TrainDistributed(Communicator* comm) {
+  CHECK_NOTNULL(comm);
+  if (comm->Size() == 1) {
+    Train();
+    return;
+  }
+  if (param_.async_log) {
+    StartAsyncLogger(kLogQueueSize, kLogBlock);
+  }
+  Clear();
+  if (comm->Rank() == 0) {
+    StartTraining();
+    // One thread for each worker, so that a slow worker
+    // does not block the others
+    std::vector<std::thread> threads;
+    for (int rank = 1; rank < comm->Size(); ++rank) {
+      threads.push_back(std::thread(&Forest::ServeWorker, this, comm, rank));
+    }
+    for (size_t i = 0; i < threads.size(); ++i) {
+      threads[i].join();
+    }
+  } else {
+    RunWorker(comm);
+  }
+  // Send the whole forest to all workers
+  std::string str;
+  uint64 len = 0;
+  if (comm->Rank() == 0) {
+    Serilize(&str);
+    len = str.size();
+  }
+  comm->Broadcast(&len, 1, 0);
+  str.resize(len);
+  comm->Broadcast(&str[0], len, 0);
+  if (comm->Rank() != 0) {
+    Deserilize(str);
+  }
+  ReportProfile();
+  if (param_.async_log) {
+    StopAsyncLogger();
+  }
+}
+
+// Given data x, predict y by the majority vote of trees
+real_t Forest::Predict(const uint8* x) {
+  PROFILE_ZONE("predict");
+  CHECK(!trees_.empty());
+  std::vector<index_t> votes(num_class_, 0);
+  for (size_t i = 0; i < trees_.size(); ++i) {
+    index_t y = trees_[i]->Predict(x);
+    CHECK_LT(y, num_class_);
+    votes[y]++;
+  }
+  return std::max_element(votes.begin(), votes.end()) - votes.begin();
+}
+
+// Given raw data x, bin it by the cuts and predict y
+real_t Forest::PredictRaw(const real_t* x) {
+  CHECK_EQ(cuts_.size(), num_feat_);
+  std::vector<uint8> bins(num_feat_);
+  ApplyCuts(x, 1, num_feat_, cuts_, bins.data());
+  return Predict(bins.data());
+}
+
+// Serilize forest to string
+void Forest::Serilize(std::string* str) {
+  CHECK_NOTNULL(str);
+  str->clear();
+  WriteValue<uint8>(num_class_, str);
+  WriteValue<uint32>(tree_type_.size(), str);
+  str->append(tree_type_);
+  WriteValue<uint32>(trees_.size(), str);
+  std::string tree_str;
+  for (size_t i = 0; i < trees_.size(); ++i) {
+    trees_[i]->Serilize(&tree_str);
+    WriteValue<uint64>(tree_str.size(), str);
+    str->append(tree_str);
+  }
+  // Cuts of raw data, if any
+  WriteValue<index_t>(num_feat_, str);
+  WriteValue<uint32>(cuts_.size(), str);
+  for (size_t j = 0; j < cuts_.size(); ++j) {
+    WriteValue<uint32>(cuts_[j].size(), str);
+    str->append(reinterpret_cast<const char*>(cuts_[j].data()),
+                cuts_[j].size() * sizeof(real_t));
+  }
+}
+
+// Deserilize forest from string
+void Forest::Deserilize(const std::string& str) {
+  Clear();
+  size_t pos = 0;
+  num_class_ = ReadValue<uint8>(str, &pos);
+  uint32 type_len = ReadValue<uint32>(str, &pos);
+  tree_type_.resize(type_len);
+  ReadBytes(str, &pos, &tree_type_[0], type_len);
+  uint32 num_trees = ReadValue<uint32>(str, &pos);
+  for (uint32 i = 0; i < num_trees; ++i) {
+    uint64 len = ReadValue<uint64>(str, &pos);
+    CHECK_LE(pos + len, str.size());
+    DTree* tree = CREATE_DTREE(tree_type_);
+    CHECK_NOTNULL(tree);
+    tree->Deserilize(str.substr(pos, len));
+    pos += len;
+    trees_.push_back(tree);
+  }
+  num_feat_ = ReadValue<index_t>(str, &pos);
+  cuts_.resize(ReadValue<uint32>(str, &pos));
+  for (size_t j = 0; j < cuts_.size(); ++j) {
+    cuts_[j].resize(ReadValue<uint32>(str, &pos));
+    ReadBytes(str, &pos, reinterpret_cast<char*>(cuts_[j].data()),
+              cuts_[j].size() * sizeof(real_t));
+  }
+  CHECK_EQ(pos, str.size());
+}
+
+}  // namespace xforest
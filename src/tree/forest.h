@@ -0,0 +1,222 @@
+//------------------------------------------------------------------------------
+// Copyright (c) 2018 by contributors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//------------------------------------------------------------------------------
+
+/*
+This file defines the Forest class.
+*/
+
+#ifndef XFOREST_TREE_FOREST_H_
+#define XFOREST_TREE_FOREST_H_
+
+#include <mutex>
+#include <set>
+#include <string>
+#include <vector>
+
+#include "src/base/common.h"
+#include "src/solver/hyper_parameter.h"
+#include "src/tree/dtree.h"
+
+namespace xforest {
+
+class Communicator;
+
+//------------------------------------------------------------------------------
+// Forest is a random forest of DTree. Each tree is trained on
+// a bootstrap sample of rows and a random subset of features,
+// which are decided by the seed (random_state + tree id), so a
+// tree is the same wherever it is trained.
+//
+//   Forest forest;
+//   forest.Init(X, Y, num_class, num_feat, data_size, param, "mctree");
+//   forest.Train();                  // or TrainDistributed(comm)
+//   real_t y = forest.Predict(x);
+//
+// In TrainDistributed(), every worker holds a replica of the
+// binned data, and rank 0 hands out tree ids on demand, so that
+// fast workers train more trees than slow ones.
+//
+// InitRaw() takes raw feature values instead of bins. The bin
+// boundaries are computed by ComputeCuts() over the data of all
+// nodes of comm (the one of TrainDistributed), and kept in the
+// forest for PredictRaw() and serialization.
+//
+// With dedup_rows, the identical rows are collapsed by DedupRows()
+// in Init(), and each tree is trained on the collapsed rows with
+// the number of times each of them is sampled as its weight.
+//
+// With async_log, Train() and TrainDistributed() write the log
+// messages by the writer thread of StartAsyncLogger(), and stop
+// it at the end, which writes all of the queued messages.
+//
+// With SetCheckpoint(), the finished trees are saved to a local
+// file periodically, and a restarted job only trains the trees
+// missing from the file. Since a tree only depends on its seed,
+// the trees in flight are simply trained again. The file is a
+// log: each tree is serialized once when it finishes, and each
+// checkpoint appends the trees since the last one, so the I/O
+// is linear in the number of trees and runs outside mutex_.
+//
+// If Profiler is enabled, the time of training phases is printed
+// for each tree and for all trees of this node.
+//------------------------------------------------------------------------------
+class Forest {
+ public:
+  // ctor and dctor
+  Forest() {}
+  ~Forest();
+
+  // Initialize. tree_type is the name of the registered DTree.
+  // X and Y are not used by rank 0 of TrainDistributed().
+  void Init(uint8* X, real_t* Y,
+            const uint8 num_class,
+            const index_t num_feat,
+            const index_t data_size,
+            const HyperParam& hyper_param,
+            const std::string& tree_type);
+
+  // Bin the raw values of X by the quantiles of the data of all
+  // nodes of comm (nullptr for local training), and Init() with
+  // the bins. All nodes of comm must call it, and rank 0 of
+  // TrainDistributed() can pass nullptr X and 0 data_size.
+  void InitRaw(const real_t* X, real_t* Y,
+               const uint8 num_class,
+               const index_t num_feat,
+               const index_t data_size,
+               const HyperParam& hyper_param,
+               const std::string& tree_type,
+               Communicator* comm);
+
+  // Save the finished trees to filename every interval trees
+  // and at the end of training, and resume from filename if it
+  // exists. For TrainDistributed(), only rank 0 writes it.
+  void SetCheckpoint(const std::string& filename, int interval);
+
+  // Train n_estimators trees locally
+  void Train();
+
+  // Train trees on the workers of comm. All nodes must call it,
+  // and every node gets the whole forest.
+  void TrainDistributed(Communicator* comm);
+
+  // Given data x, predict y by the majority vote of trees
+  real_t Predict(const uint8* x);
+
+  // Given raw data x, bin it by the cuts of InitRaw() and predict y
+  real_t PredictRaw(const real_t* x);
+
+  // Serilize forest to string
+  void Serilize(std::string* str);
+
+  // Deserilize forest from string
+  void Deserilize(const std::string& str);
+
+  // Number of trees
+  index_t NumTrees() const { return trees_.size(); }
+
+ protected:
+  uint8* X_ = nullptr;     // Training data X
+  real_t* Y_ = nullptr;    // Label y
+  uint8 num_class_ = 0;    // Number of classification
+  index_t num_feat_ = 0;   // Number of feature
+  index_t data_size_ = 0;  // Total data size for training data
+  HyperParam param_;       // Hyper parameters
+  std::string tree_type_;  // Name of DTree
+  uint64 dataset_bytes_ = 0;  // Memory of X and Y
+
+  // Bins of InitRaw(), and the cuts of each feature
+  std::vector<uint8> raw_bins_;
+  std::vector<std::vector<real_t>> cuts_;
+
+  // Collapsed rows if dedup_rows is set, and then X_ and Y_
+  // point to them. row_end_[i] is the number of original rows
+  // up to collapsed row i, i.e., the prefix sum of weights.
+  std::vector<uint8> dedup_X_;
+  std::vector<real_t> dedup_Y_;
+  std::vector<index_t> row_end_;
+
+  std::vector<DTree*> trees_;  // trees indexed by tree id
+  std::mutex mutex_;           // protect the states below
+  std::vector<int32> pending_; // tree ids to train
+  size_t next_id_ = 0;         // next of pending_ to hand out
+  std::set<int32> in_flight_;  // tree ids being trained
+  int num_finished_ = 0;       // trees finished in this run
+
+  std::string checkpoint_file_;  // empty for no checkpoint
+  int checkpoint_interval_ = 0;  // trees between checkpoints
+  std::string checkpoint_log_;   // records since the last checkpoint
+  std::mutex checkpoint_mutex_;  // serialize the appends to file
+
+  // Train the tree of tree_id, and print the memory usage
+  // and its profile if the profiler is enabled
+  DTree* TrainTree(int tree_id);
+
+  // Collapse the identical rows of X_ and Y_
+  void DedupData();
+
+  // Sample the rows and features of tree_id. If the rows are
+  // collapsed, rows are the distinct sampled rows and weight
+  // is the number of times each of them is sampled, otherwise
+  // weight is empty.
+  void Sample(int tree_id, std::vector<index_t>* rows,
+              std::vector<index_t>* cols,
+              std::vector<index_t>* weight);
+
+  // Sample rows and features, and build the tree of tree_id
+  DTree* BuildTree(int tree_id);
+
+  // Print the memory usage, and the profile of all trees
+  // trained by this node if the profiler is enabled
+  void ReportProfile();
+
+  // Load the finished trees from checkpoint, and set pending_
+  // to the ids of the other trees
+  void StartTraining();
+
+  // Store the finished tree, and save checkpoint if needed.
+  // str is the serialized tree if the caller has it.
+  void FinishTree(int tree_id, DTree* tree,
+                  const std::string* str = nullptr);
+
+  // Create the checkpoint file with the parameters which
+  // decide the trees, and no tree
+  void CreateCheckpoint();
+
+  // Append records to the checkpoint file and sync it.
+  // It is called without mutex_ held.
+  void AppendCheckpoint(const std::string& records);
+
+  // Load the trees of checkpoint to trees_. Return false
+  // if the checkpoint file does not exist.
+  bool LoadCheckpoint();
+
+  // Master: hand out tree ids to a worker until all trees
+  // are assigned, and receive the trained trees
+  void ServeWorker(Communicator* comm, int rank);
+
+  // Worker: train the assigned trees
+  void RunWorker(Communicator* comm);
+
+  // Delete all trees
+  void Clear();
+
+ private:
+  DISALLOW_COPY_AND_ASSIGN(Forest);
+};
+
+}  // namespace xforest
+
+#endif  // XFOREST_TREE_FOREST_H_
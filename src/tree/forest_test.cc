@@ -0,0 +1,394 @@
+//------------------------------------------------------------------------------
+// Copyright (c) 2018 by contributors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//------------------------------------------------------------------------------
+
+/*
+This file tests the Forest class.
+*/
+
+#include "src/tree/forest.h"
+
+#include <unistd.h>
+#include <algorithm>
+#include <fstream>
+#include <iterator>
+#include <thread>
+#include <vector>
+
+#include "src/base/common.h"
+#include "src/base/file_util.h"
+#include "src/base/memory_tracker.h"
+#include "src/base/profiler.h"
+#include "src/network/socket_communicator.h"
+#include "gtest/gtest.h"
+
+namespace xforest {
+
+const index_t kNumFeat = 6;
+const index_t kDataSize = 2000;
+const uint8 kNumClass = 3;
+
+// Label is decided by feature 0 and feature 2
+static void GenData(std::vector<uint8>* X, std::vector<real_t>* Y) {
+  X->resize(kDataSize * kNumFeat);
+  Y->resize(kDataSize);
+  for (index_t i = 0; i < kDataSize; ++i) {
+    uint8* row = X->data() + i * kNumFeat;
+    for (index_t j = 0; j < kNumFeat; ++j) {
+      row[j] = (i * (j + 3) + i / (j + 1)) % 64;
+    }
+    (*Y)[i] = (row[0] / 32 + row[2] / 32) % kNumClass;
+  }
+}
+
+static HyperParam TestParam() {
+  HyperParam param;
+  param.max_bin = 64;
+  param.n_estimators = 9;
+  param.max_depth = 8;
+  param.max_features = 4;
+  return param;
+}
+
+TEST(Forest, Train) {
+  std::vector<uint8> X;
+  std::vector<real_t> Y;
+  GenData(&X, &Y);
+  Forest forest;
+  forest.Init(X.data(), Y.data(), kNumClass, kNumFeat, kDataSize,
+              TestParam(), "mctree");
+  forest.Train();
+  EXPECT_EQ(forest.NumTrees(), 9);
+  index_t correct = 0;
+  for (index_t i = 0; i < kDataSize; ++i) {
+    if (forest.Predict(X.data() + i * kNumFeat) == Y[i]) {
+      correct++;
+    }
+  }
+  EXPECT_GT(correct, kDataSize * 0.9);
+  // Serilize and deserilize
+  std::string str;
+  forest.Serilize(&str);
+  Forest copy;
+  copy.Deserilize(str);
+  EXPECT_EQ(copy.NumTrees(), 9);
+  for (index_t i = 0; i < kDataSize; ++i) {
+    EXPECT_EQ(copy.Predict(X.data() + i * kNumFeat),
+              forest.Predict(X.data() + i * kNumFeat));
+  }
+}
+
+// Trees of collapsed rows are the same as the trees of the
+// original rows without bootstrap, and as accurate with it
+TEST(Forest, Dedup) {
+  std::vector<uint8> X;
+  std::vector<real_t> Y;
+  GenData(&X, &Y);
+  // Each of the first 200 rows has 10 copies
+  for (index_t i = 200; i < kDataSize; ++i) {
+    std::copy(X.begin() + (i % 200) * kNumFeat,
+              X.begin() + (i % 200 + 1) * kNumFeat,
+              X.begin() + i * kNumFeat);
+    Y[i] = Y[i % 200];
+  }
+  HyperParam param = TestParam();
+  for (int bootstrap = 0; bootstrap < 2; ++bootstrap) {
+    param.bootstrap = bootstrap == 1;
+    param.dedup_rows = false;
+    Forest forest;
+    forest.Init(X.data(), Y.data(), kNumClass, kNumFeat, kDataSize,
+                param, "mctree");
+    forest.Train();
+    param.dedup_rows = true;
+    Forest dedup;
+    dedup.Init(X.data(), Y.data(), kNumClass, kNumFeat, kDataSize,
+               param, "mctree");
+    dedup.Train();
+    index_t correct = 0;
+    for (index_t i = 0; i < kDataSize; ++i) {
+      real_t y = dedup.Predict(X.data() + i * kNumFeat);
+      correct += y == Y[i];
+      if (!param.bootstrap) {
+        EXPECT_EQ(y, forest.Predict(X.data() + i * kNumFeat));
+      }
+    }
+    EXPECT_GT(correct, kDataSize * 0.9);
+    if (!param.bootstrap) {
+      std::string str;
+      std::string dedup_str;
+      forest.Serilize(&str);
+      dedup.Serilize(&dedup_str);
+      EXPECT_EQ(str, dedup_str);
+    }
+  }
+}
+
+TEST(Forest, Profile) {
+  std::vector<uint8> X;
+  std::vector<real_t> Y;
+  GenData(&X, &Y);
+  Profiler::SetEnabled(true);
+  bool counters = Profiler::SetCounters(true);
+  Profiler::Reset();
+  Forest forest;
+  forest.Init(X.data(), Y.data(), kNumClass, kNumFeat, kDataSize,
+              TestParam(), "mctree");
+  forest.Train();
+  forest.Predict(X.data());
+  Profiler::FlushThread();
+  Profiler::SetCounters(false);
+  Profiler::SetEnabled(false);
+  std::vector<ProfileStat> stats;
+  Profiler::Stats(&stats);
+  std::vector<std::string> paths;
+  for (size_t i = 0; i < stats.size(); ++i) {
+    paths.push_back(stats[i].path);
+  }
+  auto tree = std::find(paths.begin(), paths.end(), "tree");
+  ASSERT_NE(tree, paths.end());
+  EXPECT_EQ(stats[tree - paths.begin()].count, 9);
+  const char* phases[] = {"tree/sample", "tree/dtree/histogram",
+                          "tree/dtree/subtract", "tree/dtree/split_scan",
+                          "tree/dtree/partition", "tree/dtree/leaf",
+                          "predict"};
+  for (int i = 0; i < 7; ++i) {
+    auto it = std::find(paths.begin(), paths.end(), phases[i]);
+    ASSERT_NE(it, paths.end()) << phases[i];
+    // Hardware counters are recorded if the kernel allows
+    EXPECT_EQ(stats[it - paths.begin()].counted > 0, counters) << phases[i];
+  }
+}
+
+// The messages of training are written by the async logger,
+// which is stopped and flushed at the end
+TEST(Forest, AsyncLog) {
+  const char* kInfoLog = "/tmp/forest_test_info.log";
+  InitializeLogger(kInfoLog, "/tmp/forest_test_warn.log",
+                   "/tmp/forest_test_erro.log");
+  std::vector<uint8> X;
+  std::vector<real_t> Y;
+  GenData(&X, &Y);
+  HyperParam param = TestParam();
+  param.async_log = true;
+  Forest forest;
+  forest.Init(X.data(), Y.data(), kNumClass, kNumFeat, kDataSize,
+              param, "mctree");
+  forest.Train();
+  EXPECT_EQ(forest.NumTrees(), 9);
+  EXPECT_EQ(NumDroppedLogs(), 0);
+  std::ifstream file(kInfoLog);
+  std::string log((std::istreambuf_iterator<char>(file)),
+                  std::istreambuf_iterator<char>());
+  EXPECT_NE(log.find("Memory of forest"), std::string::npos);
+}
+
+TEST(Forest, Memory) {
+  std::vector<uint8> X;
+  std::vector<real_t> Y;
+  GenData(&X, &Y);
+  int64 current[kNumMemoryCategories];
+  for (int i = 0; i < kNumMemoryCategories; ++i) {
+    current[i] = MemoryTracker::Current(static_cast<MemoryCategory>(i));
+  }
+  MemoryTracker::ResetPeak();
+  {
+    Forest forest;
+    forest.Init(X.data(), Y.data(), kNumClass, kNumFeat, kDataSize,
+                TestParam(), "mctree");
+    EXPECT_EQ(MemoryTracker::Current(kMemDataset) - current[kMemDataset],
+              X.size() + Y.size() * sizeof(real_t));
+    forest.Train();
+    EXPECT_GT(MemoryTracker::Current(kMemTreeNode), current[kMemTreeNode]);
+    EXPECT_GT(MemoryTracker::Peak(kMemHistogram), current[kMemHistogram]);
+    EXPECT_GT(MemoryTracker::Peak(kMemRowIndex), current[kMemRowIndex]);
+  }
+  // Everything is released with the forest
+  for (int i = 0; i < kNumMemoryCategories; ++i) {
+    MemoryCategory category = static_cast<MemoryCategory>(i);
+    EXPECT_EQ(MemoryTracker::Current(category), current[i])
+      << MemoryTracker::Name(category);
+  }
+}
+
+// Trees trained by the workers are the same as the local ones
+TEST(Forest, TrainDistributed) {
+  const int kNumWorker = 3;
+  std::vector<uint8> X;
+  std::vector<real_t> Y;
+  GenData(&X, &Y);
+  Forest local;
+  local.Init(X.data(), Y.data(), kNumClass, kNumFeat, kDataSize,
+             TestParam(), "mctree");
+  local.Train();
+  Profiler::StartTrace();
+  std::vector<Forest> forests(kNumWorker + 1);
+  std::vector<std::thread> threads;
+  for (int rank = 0; rank <= kNumWorker; ++rank) {
+    threads.push_back(std::thread([&, rank]() {
+      if (rank > 0) {
+        sleep(1);  // wait master node
+      }
+      SocketCommunicator comm;
+      comm.Initialize(rank, kNumWorker, "127.0.0.1:12360");
+      // Master does not need the data
+      if (rank == 0) {
+        forests[rank].Init(nullptr, nullptr, kNumClass, kNumFeat, 
+                           kDataSize, TestParam(), "mctree");
+      } else {
+        forests[rank].Init(X.data(), Y.data(), kNumClass, kNumFeat, 
+                           kDataSize, TestParam(), "mctree");
+      }
+      forests[rank].TrainDistributed(&comm);
+    }));
+  }
+  for (size_t i = 0; i < threads.size(); ++i) {
+    threads[i].join();
+  }
+  // Timeline of the master threads, trees and messages
+  Profiler::StopTrace();
+  const char* kTraceFile = "/tmp/forest_test_trace.json";
+  EXPECT_GT(Profiler::WriteTrace(kTraceFile), 0);
+  std::ifstream file(kTraceFile);
+  std::string json((std::istreambuf_iterator<char>(file)),
+                   std::istreambuf_iterator<char>());
+  EXPECT_NE(json.find("serve worker 3"), std::string::npos);
+  EXPECT_NE(json.find("\"name\": \"node\""), std::string::npos);
+  EXPECT_NE(json.find("\"name\": \"recv\""), std::string::npos);
+  RemoveFile(kTraceFile);
+  for (int rank = 0; rank <= kNumWorker; ++rank) {
+    EXPECT_EQ(forests[rank].NumTrees(), 9);
+    for (index_t i = 0; i < kDataSize; ++i) {
+      EXPECT_EQ(forests[rank].Predict(X.data() + i * kNumFeat),
+                local.Predict(X.data() + i * kNumFeat));
+    }
+  }
+}
+
+// Raw features are binned by the cuts of all workers, and the
+// cuts are kept for PredictRaw() of every rank
+TEST(Forest, TrainRaw) {
+  const int kNumWorker = 2;
+  std::vector<uint8> X;
+  std::vector<real_t> Y;
+  GenData(&X, &Y);
+  std::vector<real_t> raw(X.size());
+  for (size_t i = 0; i < X.size(); ++i) {
+    raw[i] = X[i] * 0.25f - 3.0f;
+  }
+  std::vector<Forest> forests(kNumWorker + 1);
+  std::vector<std::thread> threads;
+  for (int rank = 0; rank <= kNumWorker; ++rank) {
+    threads.push_back(std::thread([&, rank]() {
+      if (rank > 0) {
+        sleep(1);  // wait master node
+      }
+      SocketCommunicator comm;
+      comm.Initialize(rank, kNumWorker, "127.0.0.1:12363");
+      if (rank == 0) {
+        forests[rank].InitRaw(nullptr, nullptr, kNumClass, kNumFeat,
+                              kDataSize, TestParam(), "mctree", &comm);
+      } else {
+        forests[rank].InitRaw(raw.data(), Y.data(), kNumClass, kNumFeat,
+                              kDataSize, TestParam(), "mctree", &comm);
+      }
+      forests[rank].TrainDistributed(&comm);
+    }));
+  }
+  for (size_t i = 0; i < threads.size(); ++i) {
+    threads[i].join();
+  }
+  index_t correct = 0;
+  for (index_t i = 0; i < kDataSize; ++i) {
+    const real_t* row = raw.data() + i * kNumFeat;
+    if (forests[0].PredictRaw(row) == Y[i]) {
+      correct++;
+    }
+    for (int rank = 1; rank <= kNumWorker; ++rank) {
+      EXPECT_EQ(forests[rank].PredictRaw(row), forests[0].PredictRaw(row));
+    }
+  }
+  EXPECT_GT(correct, kDataSize * 0.9);
+  // Cuts are serilized with the trees
+  std::string str;
+  forests[0].Serilize(&str);
+  Forest copy;
+  copy.Deserilize(str);
+  for (index_t i = 0; i < kDataSize; ++i) {
+    const real_t* row = raw.data() + i * kNumFeat;
+    EXPECT_EQ(copy.PredictRaw(row), forests[0].PredictRaw(row));
+  }
+}
+
+// Forest which is preempted after training some trees
+class PreemptedForest : public Forest {
+ public:
+  void TrainSome(int num_trees) {
+    StartTraining();
+    for (int i = 0; i < num_trees; ++i) {
+      in_flight_.insert(pending_[i]);
+      FinishTree(pending_[i], TrainTree(pending_[i]));
+    }
+    // The next tree is in flight when preempted
+    in_flight_.insert(pending_[num_trees]);
+  }
+  size_t NumPending() {
+    StartTraining();
+    return pending_.size();
+  }
+};
+
+TEST(Forest, Checkpoint) {
+  const char* kFile = "/tmp/forest_test.ckpt";
+  std::vector<uint8> X;
+  std::vector<real_t> Y;
+  GenData(&X, &Y);
+  Forest local;
+  local.Init(X.data(), Y.data(), kNumClass, kNumFeat, kDataSize,
+             TestParam(), "mctree");
+  local.Train();
+  // Preempted after 6 trees, and the checkpoint has 4 trees
+  PreemptedForest preempted;
+  preempted.Init(X.data(), Y.data(), kNumClass, kNumFeat, kDataSize,
+                 TestParam(), "mctree");
+  preempted.SetCheckpoint(kFile, 4);
+  preempted.TrainSome(6);
+  PreemptedForest check;
+  check.Init(X.data(), Y.data(), kNumClass, kNumFeat, kDataSize,
+             TestParam(), "mctree");
+  check.SetCheckpoint(kFile, 4);
+  EXPECT_EQ(check.NumPending(), 5);
+  // A partial tree record of a crash while appending is dropped
+  FILE* file = OpenFileOrDie(kFile, "a");
+  const char partial[] = {1, 5, 0, 0, 0, 100};
+  WriteDataToDisk(file, partial, sizeof(partial));
+  Close(file);
+  EXPECT_EQ(check.NumPending(), 5);
+  // Resume the other trees
+  Forest resumed;
+  resumed.Init(X.data(), Y.data(), kNumClass, kNumFeat, kDataSize,
+               TestParam(), "mctree");
+  resumed.SetCheckpoint(kFile, 4);
+  resumed.Train();
+  EXPECT_EQ(resumed.NumTrees(), 9);
+  for (index_t i = 0; i < kDataSize; ++i) {
+    EXPECT_EQ(resumed.Predict(X.data() + i * kNumFeat),
+              local.Predict(X.data() + i * kNumFeat));
+  }
+  // All trees are in the final checkpoint
+  EXPECT_EQ(check.NumPending(), 0);
+  RemoveFile(kFile);
+}
+
+}  // namespace xforest
@@ -0,0 +1,330 @@
+//------------------------------------------------------------------------------
+// Copyright (c) 2018 by contributors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//------------------------------------------------------------------------------
+
+
+/*
+This file is the implementation of QuantileSketch class
+and the distributed binning functions.
+*/
+
+#include "src/tree/quantile_sketch.h"
+
+#include <algorithm>
+
+#include "src/base/serialize_util.h"
+
+namespace xforest {
+
+// Sketch size per bin, so that the rank error
+// of pruning is small compared to a bin
+static const index_t kSketchFactor = 8;
+
+//------------------------------------------------------------------------------
+// QuantileSketch class
+//------------------------------------------------------------------------------
+
+// ctor
+QuantileSketch::QuantileSketch(index_t max_size)
+  : max_size_(max_size) {
+  CHECK_GE(max_size_, 2);
+}
+
+// Add a value
+void QuantileSketch::Push(real_t value, real_t weight) {
+  buffer_.push_back(Entry{value, weight});
+  if (buffer_.size() >= max_size_) {
+    Flush();
+  }
+}
+
+// Merge the sketch of other data
+void QuantileSketch::Merge(const QuantileSketch& other) {
+  Flush();
+  MergeEntries(other.summary_);
+  std::vector<Entry> buffer(other.buffer_);
+  buffer_.swap(buffer);
+  Flush();
+}
+
+// Merge the buffer into the summary
+void QuantileSketch::Flush() {
+  if (buffer_.empty()) {
+    return;
+  }
+  std::sort(buffer_.begin(), buffer_.end(),
+            [](const Entry& a, const Entry& b) {
+              return a.value < b.value;
+            });
+  // Combine the same values
+  size_t n = 0;
+  for (size_t i = 0; i < buffer_.size(); ++i) {
+    if (n > 0 && buffer_[n-1].value == buffer_[i].value) {
+      buffer_[n-1].weight += buffer_[i].weight;
+    } else {
+      buffer_[n++] = buffer_[i];
+    }
+  }
+  buffer_.resize(n);
+  MergeEntries(buffer_);
+  buffer_.clear();
+}
+
+// Merge two sorted summaries, and prune to max_size_
+void QuantileSketch::MergeEntries(const std::vector<Entry>& other) {
+  std::vector<Entry> merged;
+  merged.reserve(summary_.size() + other.size());
+  size_t i = 0, j = 0;
+  while (i < summary_.size() || j < other.size()) {
+    Entry e;
+    if (j == other.size() ||
+        (i < summary_.size() && summary_[i].value < other[j].value)) {
+      e = summary_[i++];
+    } else if (i == summary_.size() || other[j].value < summary_[i].value) {
+      e = other[j++];
+    } else {
+      e = summary_[i++];
+      e.weight += other[j++].weight;
+    }
+    merged.push_back(e);
+  }
+  summary_.swap(merged);
+  Prune();
+}
+
+// Keep at most max_size_ entries evenly spaced by rank. The
+// first and last entries (min and max) are always kept, and
+// the weight of a dropped entry goes to the next kept entry.
+void QuantileSketch::Prune() {
+  if (summary_.size() <= max_size_) {
+    return;
+  }
+  real_t total = 0;
+  for (size_t i = 0; i < summary_.size(); ++i) {
+    total += summary_[i].weight;
+  }
+  std::vector<Entry> pruned;
+  pruned.reserve(max_size_);
+  real_t step = total / (max_size_ - 1);
+  real_t rank = 0;       // weight up to summary_[i]
+  real_t kept_rank = 0;  // weight up to the last kept entry
+  index_t k = 1;
+  for (size_t i = 0; i < summary_.size(); ++i) {
+    rank += summary_[i].weight;
+    bool keep = i == 0 || i + 1 == summary_.size();
+    if (!keep && rank >= k * step && pruned.size() + 1 < max_size_) {
+      keep = true;
+    }
+    if (keep) {
+      pruned.push_back(Entry{summary_[i].value, rank - kept_rank});
+      kept_rank = rank;
+      while (k * step <= rank) {
+        k++;
+      }
+    }
+  }
+  summary_.swap(pruned);
+}
+
+// Get at most max_bin sorted and distinct boundaries
+void QuantileSketch::GetCuts(int max_bin, std::vector<real_t>* cuts) {
+  CHECK_GT(max_bin, 0);
+  CHECK_NOTNULL(cuts);
+  Flush();
+  cuts->clear();
+  if (summary_.empty()) {
+    return;
+  }
+  if (summary_.size() <= max_bin + 1) {
+    // Each distinct value has its own bin
+    for (size_t i = 0; i + 1 < summary_.size(); ++i) {
+      cuts->push_back(summary_[i].value);
+    }
+    return;
+  }
+  real_t total = TotalWeight();
+  real_t rank = 0;
+  size_t i = 0;
+  for (int b = 1; b <= max_bin; ++b) {
+    real_t target = total * b / (max_bin + 1);
+    while (i + 1 < summary_.size() && rank + summary_[i].weight < target) {
+      rank += summary_[i].weight;
+      i++;
+    }
+    if (i + 1 == summary_.size()) {
+      break;  // the max value needs no cut
+    }
+    if (cuts->empty() || cuts->back() < summary_[i].value) {
+      cuts->push_back(summary_[i].value);
+    }
+  }
+}
+
+// Serialize to (append)
+void QuantileSketch::Serialize(std::string* str) {
+  CHECK_NOTNULL(str);
+  Flush();
+  index_t size = summary_.size();
+  WriteValue<index_t>(size, str);
+  str->append(reinterpret_cast<const char*>(summary_.data()),
+              size * sizeof(Entry));
+}
+
+// Deserialize from str[*pos]
+void QuantileSketch::Deserialize(const std::string& str, size_t* pos) {
+  CHECK_NOTNULL(pos);
+  index_t size = ReadValue<index_t>(str, pos);
+  CHECK_LE(*pos + size * sizeof(Entry), str.size());
+  summary_.resize(size);
+  ReadBytes(str, pos, reinterpret_cast<char*>(summary_.data()),
+            size * sizeof(Entry));
+  buffer_.clear();
+}
+
+// Number of entries after flushing the buffer
+index_t QuantileSketch::Size() {
+  Flush();
+  return summary_.size();
+}
+
+// Total weight of values
+real_t QuantileSketch::TotalWeight() {
+  Flush();
+  real_t total = 0;
+  for (size_t i = 0; i < summary_.size(); ++i) {
+    total += summary_[i].weight;
+  }
+  return total;
+}
+
+//------------------------------------------------------------------------------
+// Distributed binning
+//------------------------------------------------------------------------------
+
+// Merge the sketches to rank 0 by binomial tree. Each message
+// is the size of serialized sketches and the data, which can be
+// larger than an int for wide data, so it is sent in chunks.
+static void ReduceSketches(Communicator* comm,
+                           std::vector<QuantileSketch*>* sketches) {
+  int rank = comm->Rank();
+  int size = comm->Size();
+  for (int mask = 1; mask < size; mask <<= 1) {
+    if (rank & mask) {
+      std::string msg;
+      for (size_t j = 0; j < sketches->size(); ++j) {
+        (*sketches)[j]->Serialize(&msg);
+      }
+      uint64 len = msg.size();
+      comm->Send(rank - mask, reinterpret_cast<const char*>(&len),
+                 sizeof(len));
+      comm->SendBytes(rank - mask, msg.data(), len);
+      comm->WaitSends();
+      break;
+    }
+    if (rank + mask < size) {
+      uint64 len = 0;
+      comm->Recv(rank + mask, reinterpret_cast<char*>(&len), sizeof(len));
+      std::string msg(len, 0);
+      comm->RecvBytes(rank + mask, &msg[0], len);
+      size_t pos = 0;
+      QuantileSketch other(2);
+      for (size_t j = 0; j < sketches->size(); ++j) {
+        other.Deserialize(msg, &pos);
+        (*sketches)[j]->Merge(other);
+      }
+      CHECK_EQ(pos, msg.size());
+    }
+  }
+}
+
+// Compute the bin boundaries of all features over all nodes
+void ComputeCuts(const real_t* X, index_t row_len, index_t num_feat,
+                 int max_bin, Communicator* comm,
+                 std::vector<std::vector<real_t>>* cuts) {
+  CHECK_GT(num_feat, 0);
+  CHECK_GT(max_bin, 0);
+  CHECK_LE(max_bin, 255);
+  CHECK_NOTNULL(cuts);
+  if (row_len > 0) {
+    CHECK_NOTNULL(X);
+  }
+  std::vector<QuantileSketch*> sketches(num_feat);
+  for (index_t j = 0; j < num_feat; ++j) {
+    sketches[j] = new QuantileSketch(kSketchFactor * max_bin);
+  }
+  for (index_t i = 0; i < row_len; ++i) {
+    const real_t* row = X + (uint64)i * num_feat;
+    for (index_t j = 0; j < num_feat; ++j) {
+      sketches[j]->Push(row[j]);
+    }
+  }
+  bool is_root = comm == nullptr || comm->Rank() == 0;
+  if (comm != nullptr) {
+    ReduceSketches(comm, &sketches);
+  }
+  cuts->assign(num_feat, std::vector<real_t>());
+  std::vector<index_t> sizes(num_feat, 0);
+  if (is_root) {
+    for (index_t j = 0; j < num_feat; ++j) {
+      sketches[j]->GetCuts(max_bin, &(*cuts)[j]);
+      sizes[j] = (*cuts)[j].size();
+    }
+  }
+  for (index_t j = 0; j < num_feat; ++j) {
+    delete sketches[j];
+  }
+  if (comm == nullptr) {
+    return;
+  }
+  // Broadcast the number of cuts and then the cuts
+  comm->Broadcast(sizes.data(), sizes.size(), 0);
+  std::vector<real_t> values;
+  for (index_t j = 0; j < num_feat; ++j) {
+    if (is_root) {
+      values.insert(values.end(), (*cuts)[j].begin(), (*cuts)[j].end());
+    } else {
+      values.resize(values.size() + sizes[j]);
+    }
+  }
+  if (!values.empty()) {
+    comm->Broadcast(values.data(), values.size(), 0);
+  }
+  if (!is_root) {
+    size_t pos = 0;
+    for (index_t j = 0; j < num_feat; ++j) {
+      (*cuts)[j].assign(values.begin() + pos,
+                        values.begin() + pos + sizes[j]);
+      pos += sizes[j];
+    }
+  }
+}
+
+// Map each feature value of X to its bin
+void ApplyCuts(const real_t* X, index_t row_len, index_t num_feat,
+               const std::vector<std::vector<real_t>>& cuts,
+               uint8* bins) {
+  CHECK_EQ(cuts.size(), num_feat);
+  CHECK_NOTNULL(bins);
+  for (index_t i = 0; i < row_len; ++i) {
+    uint64 offset = (uint64)i * num_feat;
+    for (index_t j = 0; j < num_feat; ++j) {
+      const std::vector<real_t>& c = cuts[j];
+      bins[offset + j] = std::lower_bound(c.begin(), c.end(),
+                                          X[offset + j]) - c.begin();
+    }
+  }
+}
+
+}  // namespace xforest
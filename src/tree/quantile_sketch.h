@@ -0,0 +1,122 @@
+//------------------------------------------------------------------------------
+// Copyright (c) 2018 by contributors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//------------------------------------------------------------------------------
+
+
+/*
+This file defines the QuantileSketch class and the distributed
+binning functions, which compute the bin boundaries of features.
+*/
+
+#ifndef XFOREST_TREE_QUANTILE_SKETCH_H_
+#define XFOREST_TREE_QUANTILE_SKETCH_H_
+
+#include <string>
+#include <vector>
+
+#include "src/base/common.h"
+#include "src/network/communicator.h"
+
+namespace xforest {
+
+//------------------------------------------------------------------------------
+// QuantileSketch is a mergeable summary of a stream of weighted
+// values. It keeps at most max_size sorted (value, weight) entries,
+// where an entry stands for the weight of the dropped values between
+// it and the previous entry. Each prune adds a rank error of at
+// most total_weight / max_size, e.g.,
+//
+//   QuantileSketch sketch(1024);
+//   for (...) sketch.Push(x);
+//   sketch.Merge(other);        // sketch of another shard
+//   sketch.GetCuts(255, &cuts);
+//
+//------------------------------------------------------------------------------
+class QuantileSketch {
+ public:
+  // ctor and dctor
+  explicit QuantileSketch(index_t max_size);
+  ~QuantileSketch() {}
+
+  // Add a value. The values are buffered and
+  // summarized when the buffer is full.
+  void Push(real_t value, real_t weight = 1);
+
+  // Merge the sketch of other data
+  void Merge(const QuantileSketch& other);
+
+  // Get at most max_bin sorted and distinct boundaries. A value x
+  // belongs to bin b if cuts[b-1] < x <= cuts[b], and the values
+  // larger than all cuts belong to bin cuts.size().
+  void GetCuts(int max_bin, std::vector<real_t>* cuts);
+
+  // Serialize to (append) / Deserialize from str[*pos]
+  void Serialize(std::string* str);
+  void Deserialize(const std::string& str, size_t* pos);
+
+  // Number of entries after flushing the buffer
+  index_t Size();
+
+  // Total weight of values
+  real_t TotalWeight();
+
+ private:
+  struct Entry {
+    real_t value;
+    real_t weight;
+  };
+
+  // Merge the buffer into the summary
+  void Flush();
+
+  // Merge two sorted summaries, and prune to max_size_
+  void MergeEntries(const std::vector<Entry>& other);
+
+  // Keep at most max_size_ entries evenly spaced by rank
+  void Prune();
+
+  index_t max_size_;            // Maximal size of summary
+  std::vector<Entry> summary_;  // Sorted entries
+  std::vector<Entry> buffer_;   // Unsorted values
+
+  DISALLOW_COPY_AND_ASSIGN(QuantileSketch);
+};
+
+//------------------------------------------------------------------------------
+// Distributed binning. Every node sketches the features of its own
+// shard, the sketches are merged to rank 0 by a binomial tree, and
+// the bin boundaries are broadcast, so that all of the nodes bin
+// their data in the same way:
+//
+//   std::vector<std::vector<real_t>> cuts;
+//   ComputeCuts(X, row_len, num_feat, max_bin, comm, &cuts);
+//   std::vector<uint8> bins(row_len * num_feat);
+//   ApplyCuts(X, row_len, num_feat, cuts, bins.data());
+//
+// X is a dense row-major matrix, and comm can be nullptr for
+// single-node training.
+//------------------------------------------------------------------------------
+void ComputeCuts(const real_t* X, index_t row_len, index_t num_feat,
+                 int max_bin, Communicator* comm,
+                 std::vector<std::vector<real_t>>* cuts);
+
+// Map each feature value of X to its bin
+void ApplyCuts(const real_t* X, index_t row_len, index_t num_feat,
+               const std::vector<std::vector<real_t>>& cuts,
+               uint8* bins);
+
+}  // namespace xforest
+
+#endif  // XFOREST_TREE_QUANTILE_SKETCH_H_
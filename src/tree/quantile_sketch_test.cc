@@ -0,0 +1,117 @@
+//------------------------------------------------------------------------------
+// Copyright (c) 2018 by contributors. All Rights Reserved.
+//
+// Licensed under the Apache License, Version 2.0 (the "License");
+// you may not use this file except in compliance with the License.
+// You may obtain a copy of the License at
+//
+//     http://www.apache.org/licenses/LICENSE-2.0
+//
+// Unless required by applicable law or agreed to in writing, software
+// distributed under the License is distributed on an "AS IS" BASIS,
+// WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+// See the License for the specific language governing permissions and
+// limitations under the License.
+//------------------------------------------------------------------------------
+
+
+/*
+This file tests the QuantileSketch class and distributed binning.
+*/
+
+#include "src/tree/quantile_sketch.h"
+
+#include <math.h>
+#include <thread>
+#include <vector>
+
+#include "src/base/common.h"
+#include "src/network/socket_communicator.h"
+#include "gtest/gtest.h"
+
+namespace xforest {
+
+TEST(QuantileSketch, DistinctValues) {
+  QuantileSketch sketch(64);
+  for (int i = 0; i < 1000; ++i) {
+    sketch.Push(i % 10);
+  }
+  std::vector<real_t> cuts;
+  sketch.GetCuts(255, &cuts);
+  ASSERT_EQ(cuts.size(), 9);
+  for (int i = 0; i < 9; ++i) {
+    EXPECT_FLOAT_EQ(cuts[i], i);
+  }
+}
+
+TEST(QuantileSketch, Merge) {
+  const int kNum = 100000;
+  const int kBin = 15;
+  // Shuffled 0 ... kNum-1 split to 4 sketches
+  std::vector<QuantileSketch*> sketches;
+  for (int s = 0; s < 4; ++s) {
+    sketches.push_back(new QuantileSketch(128));
+  }
+  for (int i = 0; i < kNum; ++i) {
+    int val = (i * 7919LL) % kNum;
+    sketches[i % 4]->Push(val);
+  }
+  for (int s = 1; s < 4; ++s) {
+    sketches[0]->Merge(*sketches[s]);
+  }
+  EXPECT_LE(sketches[0]->Size(), 128);
+  EXPECT_FLOAT_EQ(sketches[0]->TotalWeight(), kNum);
+  std::vector<real_t> cuts;
+  sketches[0]->GetCuts(kBin, &cuts);
+  ASSERT_EQ(cuts.size(), kBin);
+  for (int b = 0; b < kBin; ++b) {
+    real_t expect = (b + 1) * kNum / (kBin + 1.0);
+    EXPECT_LT(fabs(cuts[b] - expect), kNum / 50);
+  }
+  for (int s = 0; s < 4; ++s) {
+    delete sketches[s];
+  }
+}
+
+TEST(QuantileSketch, Distributed) {
+  const int kNumWorker = 3;
+  const index_t kRows = 5000;
+  const index_t kFeat = 3;
+  std::vector<std::vector<std::vector<real_t>>> cuts(kNumWorker + 1);
+  std::vector<std::thread> threads;
+  for (int rank = 0; rank <= kNumWorker; ++rank) {
+    threads.push_back(std::thread([rank, &cuts]() {
+      // Each shard has a different range of feature 0,
+      // feature 1 is uniform and feature 2 is constant
+      std::vector<real_t> X(kRows * kFeat);
+      for (index_t i = 0; i < kRows; ++i) {
+        X[i * kFeat] = rank * kRows + i;
+        X[i * kFeat + 1] = i % 100;
+        X[i * kFeat + 2] = 1.0;
+      }
+      SocketCommunicator comm;
+      comm.Initialize(rank, kNumWorker, "127.0.0.1:12362");
+      ComputeCuts(X.data(), kRows, kFeat, 63, &comm, &cuts[rank]);
+      std::vector<uint8> bins(X.size());
+      ApplyCuts(X.data(), kRows, kFeat, cuts[rank], bins.data());
+      for (size_t i = 0; i < bins.size(); ++i) {
+        EXPECT_LE(bins[i], 63);
+      }
+    }));
+  }
+  for (size_t i = 0; i < threads.size(); ++i) {
+    threads[i].join();
+  }
+  // All nodes have the same boundaries
+  for (int rank = 1; rank <= kNumWorker; ++rank) {
+    EXPECT_EQ(cuts[rank], cuts[0]);
+  }
+  ASSERT_EQ(cuts[0].size(), kFeat);
+  EXPECT_EQ(cuts[0][0].size(), 63);
+  real_t total = (kNumWorker + 1) * kRows;
+  EXPECT_LT(fabs(cuts[0][0][31] - total / 2), total / 50);
+  EXPECT_EQ(cuts[0][1].size(), 63);
+  EXPECT_EQ(cuts[0][2].size(), 0);
+}
+
+}  // namespace xforest